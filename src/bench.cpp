@@ -0,0 +1,571 @@
+/*
+#================================================================================
+# * Benchmark               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Times the physics step on its own, for every combination of body count,
+# thread count and integrator asked for, and writes the results as JSON so
+# that releases can be compared. Progress goes to stderr as it runs.
+#
+# Each case starts from the sun and planets plus enough belt bodies to make up
+# the count, takes one untimed step to warm up, then steps for about
+# --budget seconds. Forces are summed directly up to --direct-limit bodies
+# and with the tree above that; block steps are always direct, so they are
+# skipped past the limit.
+#
+# --precisions adds the templated float, double and double-float direct sums
+# (see precision.h) to the cases. Each of those also reports how far its
+# accelerations at the start are from the native double kernel's.
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "physics.h"
+#include "gravity.h"
+#include "precision.h"
+#include "octree.h"
+#include "thread_pool.h"
+#include "solar_system.h"
+#include "clock.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for strtol/strtod
+#include <string.h>       // Header File for strcmp
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define BENCH_LIST_MAX      16      // values a list option can hold
+#define BENCH_ENERGY_LIMIT  20000   // no O(N^2) energy checks above this many bodies
+#define BENCH_MAX_STEPS     4000000 // stop adding batches past this many steps
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagBenchOptions
+typedef struct
+{
+  long   bodies[BENCH_LIST_MAX];       // body counts to try
+  int    bodyCount;
+  long   threads[BENCH_LIST_MAX];      // thread counts to try (0 = all)
+  int    threadCount;
+  int    integrators[INTEGRATOR_COUNT];
+  int    integratorCount;
+  int    precisions[PRECISION_COUNT];
+  int    precisionCount;
+  int    kernel;       // GRAVITY_KERNEL_*
+  double dt;           // step size (s)
+  double budget;       // seconds to spend stepping each case
+  long   directLimit;  // largest body count summed directly
+  double theta;        // opening angle for the tree
+  const char* json;    // where the results go (NULL for stdout)
+}tagBenchOptions;
+
+// tagBenchResult - one case
+typedef struct
+{
+  long   bodies;
+  int    solver;
+  int    threads;
+  int    integrator;
+  int    precision;         // PRECISION_*
+  bool   fixed;             // a kernel compiled for exactly this many bodies was used
+  double forceError;        // largest |a - a_native| / |a_native| at the start (< 0 if not checked)
+  long   steps;             // timed steps
+  double seconds;           // wall time of the timed steps
+  long   forceEvaluations;  // during the timed steps
+  double pairs;             // one body pulled by one other, during the timed steps
+  double energyDrift;       // relative, over the whole case (< 0 if not checked)
+  double momentumDrift;     // relative change in angular momentum
+}tagBenchResult;
+
+//#==============================================================================
+//# * parseList
+//#------------------------------------------------------------------------------
+//# Reads a comma separated list of integers ("10,1e3" is fine too)
+//#==============================================================================
+static bool parseList(const char* option, const char* text, long* values, int* count)
+{
+  *count = 0;
+  while(*text != '\0')
+  {
+    char* end = NULL;
+    double value = strtod(text, &end);
+    if(end == text || (*end != ',' && *end != '\0') || value != floor(value) ||
+       value < 0 || value > 100000000 || *count == BENCH_LIST_MAX)
+    {
+      fprintf(stderr, "%s: expected up to %d whole numbers separated by commas\n",
+              option, BENCH_LIST_MAX);
+      return false;
+    }
+    values[(*count)++] = (long)value;
+    text = *end == ',' ? end + 1 : end;
+  }
+  return *count > 0;
+}
+
+//#==============================================================================
+//# * parseIntegrators
+//#------------------------------------------------------------------------------
+//# Reads a comma separated list of integrator names, or "all"
+//#==============================================================================
+static bool parseIntegrators(const char* text, tagBenchOptions* options)
+{
+  options->integratorCount = 0;
+  if(strcmp(text, "all") == 0)
+  {
+    for( int type = 0; type < INTEGRATOR_COUNT; type++)
+      options->integrators[options->integratorCount++] = type;
+    return true;
+  }
+  char name[32];
+  while(*text != '\0')
+  {
+    int length = 0;
+    while(text[length] != ',' && text[length] != '\0' && length < 31)
+    {
+      name[length] = text[length];
+      length++;
+    }
+    name[length] = '\0';
+    int type = integratorParse(name);
+    if(type < 0 || options->integratorCount == INTEGRATOR_COUNT)
+    {
+      fprintf(stderr, "--integrators: unknown integrator '%s'\n", name);
+      return false;
+    }
+    options->integrators[options->integratorCount++] = type;
+    text += length;
+    if(*text == ',') text++;
+  }
+  return options->integratorCount > 0;
+}
+
+//#==============================================================================
+//# * parsePrecisions
+//#------------------------------------------------------------------------------
+//# Reads a comma separated list of precision names, or "all"
+//#==============================================================================
+static bool parsePrecisions(const char* text, tagBenchOptions* options)
+{
+  options->precisionCount = 0;
+  if(strcmp(text, "all") == 0)
+  {
+    for( int precision = 0; precision < PRECISION_COUNT; precision++)
+      options->precisions[options->precisionCount++] = precision;
+    return true;
+  }
+  char name[32];
+  while(*text != '\0')
+  {
+    int length = 0;
+    while(text[length] != ',' && text[length] != '\0' && length < 31)
+    {
+      name[length] = text[length];
+      length++;
+    }
+    name[length] = '\0';
+    int precision = precisionParse(name);
+    if(precision < 0 || options->precisionCount == PRECISION_COUNT)
+    {
+      fprintf(stderr, "--precisions: unknown precision '%s'\n", name);
+      return false;
+    }
+    options->precisions[options->precisionCount++] = precision;
+    text += length;
+    if(*text == ',') text++;
+  }
+  return options->precisionCount > 0;
+}
+
+//#==============================================================================
+//# * parseOptions
+//#------------------------------------------------------------------------------
+//# Fills in the options from the command line. Returns false (after printing
+//# why) if something could not be understood.
+//#==============================================================================
+static bool parseOptions(tagBenchOptions* options, int argc, char** argv)
+{
+  const long bodies[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+  options->bodyCount = sizeof(bodies)/sizeof(bodies[0]);
+  memcpy(options->bodies, bodies, sizeof(bodies));
+  options->threads[0]  = 1;
+  options->threads[1]  = 0;
+  options->threadCount = threadPoolHardwareThreads() > 1 ? 2 : 1;
+  parseIntegrators("all", options);
+  parsePrecisions("native", options);
+  options->kernel      = GRAVITY_KERNEL_AUTO;
+  options->dt          = 86400;
+  options->budget      = 0.5;
+  options->directLimit = 20000;
+  options->theta       = 0.5;
+  options->json        = NULL;
+
+  for( int i = 1; i < argc; i++)
+  {
+    const char* arg   = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+    if(value == NULL)
+    {
+      fprintf(stderr, "%s: missing value\n", arg);
+      return false;
+    }
+    i++;
+
+    char* end = NULL;
+    if(strcmp(arg, "--bodies") == 0)
+    {
+      if(!parseList(arg, value, options->bodies, &options->bodyCount)) return false;
+    }
+    else if(strcmp(arg, "--threads") == 0)
+    {
+      if(!parseList(arg, value, options->threads, &options->threadCount)) return false;
+    }
+    else if(strcmp(arg, "--integrators") == 0)
+    {
+      if(!parseIntegrators(value, options)) return false;
+    }
+    else if(strcmp(arg, "--precisions") == 0)
+    {
+      if(!parsePrecisions(value, options)) return false;
+    }
+    else if(strcmp(arg, "--kernel") == 0)
+    {
+      options->kernel = gravityParseKernel(value);
+      if(options->kernel < 0)
+      {
+        fprintf(stderr, "--kernel: unknown kernel '%s'\n", value);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--dt") == 0)
+    {
+      options->dt = strtod(value, &end);
+      if(*end != '\0' || !(options->dt > 0))
+      {
+        fprintf(stderr, "--dt: must be greater than zero\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--budget") == 0)
+    {
+      options->budget = strtod(value, &end);
+      if(*end != '\0' || !(options->budget >= 0))
+      {
+        fprintf(stderr, "--budget: must not be negative\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--direct-limit") == 0)
+    {
+      options->directLimit = strtol(value, &end, 10);
+      if(*end != '\0' || options->directLimit < 0)
+      {
+        fprintf(stderr, "--direct-limit: must not be negative\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--theta") == 0)
+    {
+      options->theta = strtod(value, &end);
+      if(*end != '\0' || !(options->theta > 0 && options->theta <= 1))
+      {
+        fprintf(stderr, "--theta: must be greater than 0 and at most 1\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--json") == 0)
+    {
+      options->json = value;
+    }
+    else
+    {
+      fprintf(stderr, "unknown option '%s'\n", arg);
+      return false;
+    }
+  }
+  for( int b = 0; b < options->bodyCount; b++)
+  {
+    if(options->bodies[b] < 2)
+    {
+      fprintf(stderr, "--bodies: need at least 2 bodies\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * usage
+//#------------------------------------------------------------------------------
+//# Prints the list of options
+//#==============================================================================
+static void usage(const char* program)
+{
+  fprintf(stderr,
+    "usage: %s [--bodies N,N,...] [--threads N,N,...] [--integrators I,I,...|all]\n"
+    "          [--precisions P,P,...|all]\n"
+    "          [--kernel auto|scalar|avx2|avx512] [--dt S] [--budget S]\n"
+    "          [--direct-limit N] [--theta T] [--json FILE]\n"
+    "\n"
+    "  --bodies N,...     body counts (default 10,100,1000,10000,100000,1000000)\n"
+    "  --threads N,...    thread counts, 0 for one per hardware thread\n"
+    "                     (default 1,0)\n"
+    "  --integrators I,...\n"
+    "                     integrators to time (default all)\n"
+    "  --precisions P,... direct sums to time: native, double, float,\n"
+    "                     double-float or all (default native)\n"
+    "  --kernel K         gravity kernel (default: the fastest supported)\n"
+    "  --dt S             size of each step in seconds (default 86400)\n"
+    "  --budget S         seconds of stepping per case (default 0.5)\n"
+    "  --direct-limit N   sum forces directly up to N bodies, use the tree\n"
+    "                     above (default 20000)\n"
+    "  --theta T          tree opening angle (default 0.5)\n"
+    "  --json FILE        write the results to FILE instead of stdout\n",
+    program);
+}
+
+//#==============================================================================
+//# * angularMomentumDrift
+//#------------------------------------------------------------------------------
+//# |L - L0| / |L0|
+//#==============================================================================
+static double angularMomentumDrift(const double L0[3], const tagBodies* bodies)
+{
+  double L[3];
+  physicsAngularMomentum(bodies, L);
+  double dx = L[0] - L0[0], dy = L[1] - L0[1], dz = L[2] - L0[2];
+  return sqrt(dx*dx + dy*dy + dz*dz) / sqrt(L0[0]*L0[0] + L0[1]*L0[1] + L0[2]*L0[2]);
+}
+
+//#==============================================================================
+//# * forceError
+//#------------------------------------------------------------------------------
+//# Largest relative difference between the accelerations of "initial" from
+//# the templated sum in "precision" and from the native kernel
+//#==============================================================================
+static double forceError(const tagBodies* initial, tagBodies* bodies, int precision)
+{
+  const int count = initial->count;
+  double* reference = (double*)malloc(sizeof(double) * 3 * (unsigned long)count);
+  bodiesCopy(bodies, initial);
+  gravityAccelerations(bodies);
+  for( int i = 0; i < count; i++)
+  {
+    reference[3*i + 0] = bodies->ax[i];
+    reference[3*i + 1] = bodies->ay[i];
+    reference[3*i + 2] = bodies->az[i];
+  }
+  precisionAccelerations(bodies, precision);
+  double worst = 0;
+  for( int i = 0; i < count; i++)
+  {
+    double dx = bodies->ax[i] - reference[3*i + 0];
+    double dy = bodies->ay[i] - reference[3*i + 1];
+    double dz = bodies->az[i] - reference[3*i + 2];
+    double size = sqrt(reference[3*i]*reference[3*i] + reference[3*i + 1]*reference[3*i + 1] +
+                       reference[3*i + 2]*reference[3*i + 2]);
+    double error = sqrt(dx*dx + dy*dy + dz*dz) / size;
+    if(size > 0 && error > worst) worst = error;
+  }
+  free(reference);
+  return worst;
+}
+
+//#==============================================================================
+//# * runCase
+//#------------------------------------------------------------------------------
+//# Steps a fresh copy of "initial" with the solver and integrator already
+//# selected and fills in "result". Returns false if the integrator gave up.
+//#==============================================================================
+static bool runCase(const tagBenchOptions* options, const tagBodies* initial,
+                    tagBodies* bodies, tagBenchResult* result)
+{
+  bodiesCopy(bodies, initial);
+  tagIntegrator* integrator = physicsIntegrator();
+  integratorReset(integrator);
+
+  const long count = bodies->count;
+  bool   energy  = count <= BENCH_ENERGY_LIMIT;
+  double energy0 = energy ? physicsEnergy(bodies) : 0;
+  double L0[3];
+  physicsAngularMomentum(bodies, L0);
+
+  // one untimed step to warm up, then batches of doubling size until the
+  // budget is spent, so tiny systems aren't timed on a handful of steps
+  if(!physicsStep(bodies, options->dt)) return false;
+  long evaluations = integrator->forceEvaluations, forces = integrator->bodyForces;
+  long steps = 0, batch = 1;
+  double seconds = 0;
+  while(steps == 0 || (seconds < options->budget && steps < BENCH_MAX_STEPS))
+  {
+    double start = clockSeconds();
+    for( long s = 0; s < batch; s++)
+    {
+      if(!physicsStep(bodies, options->dt)) return false;
+    }
+    seconds += clockSeconds() - start;
+    steps   += batch;
+    batch   *= 2;
+  }
+  result->seconds          = seconds;
+  result->steps            = steps;
+  result->forceEvaluations = integrator->forceEvaluations - evaluations;
+  result->pairs            = (double)(integrator->bodyForces - forces) * (count - 1);
+  result->energyDrift      = energy && energy0 != 0 ?
+                             fabs((physicsEnergy(bodies) - energy0) / energy0) : -1;
+  result->momentumDrift    = angularMomentumDrift(L0, bodies);
+  return true;
+}
+
+//#==============================================================================
+//# * writeResult
+//#------------------------------------------------------------------------------
+//# One case as a JSON object
+//#==============================================================================
+static void writeResult(FILE* file, const tagBenchResult* result, bool last)
+{
+  fprintf(file, "    { \"bodies\": %ld, \"solver\": \"%s\", \"threads\": %d, "
+                "\"integrator\": \"%s\",\n", result->bodies,
+          physicsSolverName(result->solver), result->threads,
+          integratorName(result->integrator));
+  fprintf(file, "      \"precision\": \"%s\", \"fixed_count\": %s, ",
+          precisionName(result->precision), result->fixed ? "true" : "false");
+  if(isfinite(result->forceError) && result->forceError >= 0)
+    fprintf(file, "\"force_error\": %.6g,\n", result->forceError);
+  else
+    fprintf(file, "\"force_error\": null,\n");
+  fprintf(file, "      \"steps\": %ld, \"seconds\": %.6g, \"steps_per_second\": %.6g, "
+                "\"force_evaluations\": %ld,\n", result->steps, result->seconds,
+          result->seconds > 0 ? result->steps / result->seconds : 0.0,
+          result->forceEvaluations);
+  fprintf(file, "      \"ns_per_pair\": %.6g, ",
+          result->pairs > 0 ? result->seconds * 1e9 / result->pairs : 0.0);
+  if(isfinite(result->energyDrift) && result->energyDrift >= 0)
+    fprintf(file, "\"energy_drift\": %.6g, ", result->energyDrift);
+  else
+    fprintf(file, "\"energy_drift\": null, ");
+  if(isfinite(result->momentumDrift))
+    fprintf(file, "\"angular_momentum_drift\": %.6g }%s\n", result->momentumDrift,
+            last ? "" : ",");
+  else
+    fprintf(file, "\"angular_momentum_drift\": null }%s\n", last ? "" : ",");
+}
+
+//#==============================================================================
+//# * main
+//#------------------------------------------------------------------------------
+//# Runs every case, then writes them all out
+//#==============================================================================
+int main(int argc, char** argv)
+{
+  tagBenchOptions options;
+  if(!parseOptions(&options, argc, argv))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  if(!gravitySelectKernel(options.kernel))
+  {
+    fprintf(stderr, "this processor can't run the %s kernel\n",
+            gravityKernelName(options.kernel));
+    return 1;
+  }
+
+  // opened first, so a bad path doesn't throw away a whole run
+  FILE* file = options.json != NULL ? fopen(options.json, "w") : stdout;
+  if(file == NULL)
+  {
+    fprintf(stderr, "--json: can't write '%s'\n", options.json);
+    return 1;
+  }
+
+  const int cases = options.threadCount * options.bodyCount * options.integratorCount *
+                    options.precisionCount;
+  tagBenchResult* results = (tagBenchResult*)malloc(sizeof(tagBenchResult) * cases);
+  int done = 0;
+  bool failed = false;
+  for( int t = 0; t < options.threadCount; t++)
+  {
+    threadPoolStart((int)options.threads[t]);
+    for( int b = 0; b < options.bodyCount; b++)
+    {
+      const long count = options.bodies[b];
+      tagBodies initial, bodies;
+      const long capacity = count > (long)SOLAR_SYSTEM_BODIES ? count : (long)SOLAR_SYSTEM_BODIES;
+      bodiesCreate(&initial, (int)capacity);
+      bodiesCreate(&bodies, initial.capacity);
+      solarSystemInit(&initial);
+      if(count < initial.count) initial.count = (int)count;
+      solarSystemAddBelt(&initial, (int)(count - initial.count), 2011);
+
+      int solver = count <= options.directLimit ? SOLVER_DIRECT : SOLVER_TREE;
+      physicsSelectSolver(solver, options.theta, OCTREE_QUADRUPOLE);
+      for( int p = 0; p < options.precisionCount; p++)
+      {
+        int precision = options.precisions[p];
+        if(precision != PRECISION_NATIVE && solver != SOLVER_DIRECT)
+        {
+          fprintf(stderr, "%8ld bodies  skipping %s: the tree has no templated sums\n",
+                  count, precisionName(precision));
+          continue;
+        }
+        physicsSelectPrecision(precision);
+        double error = precision == PRECISION_NATIVE ? 0 : forceError(&initial, &bodies, precision);
+        for( int i = 0; i < options.integratorCount; i++)
+        {
+          int type = options.integrators[i];
+          if(type == INTEGRATOR_BLOCK && (solver != SOLVER_DIRECT || precision != PRECISION_NATIVE))
+          {
+            if(precision == PRECISION_NATIVE)
+              fprintf(stderr, "%8ld bodies  skipping block: it always sums directly\n", count);
+            continue;   // nor with the templated sums: it has its own
+          }
+          physicsSelectIntegrator(type, 1E-10, BLOCK_ETA);
+
+          tagBenchResult* result = &results[done++];
+          result->bodies     = count;
+          result->solver     = solver;
+          result->threads    = threadPoolSize();
+          result->integrator = type;
+          result->precision  = precision;
+          result->fixed      = precision != PRECISION_NATIVE && precisionFixed((int)count);
+          result->forceError = solver == SOLVER_DIRECT ? error : -1;
+          if(!runCase(&options, &initial, &bodies, result))
+          {
+            fprintf(stderr, "%8ld bodies  %-8s  gave up\n", count, integratorName(type));
+            done--;
+            failed = true;
+            continue;
+          }
+          fprintf(stderr, "%8ld bodies  %-6s  %3d threads  %-8s  %-12s  %12.1f steps/s  "
+                          "%9.3f ns/pair\n", count, physicsSolverName(solver), result->threads,
+                  integratorName(type), precisionName(precision),
+                  result->seconds > 0 ? result->steps / result->seconds : 0.0,
+                  result->pairs > 0 ? result->seconds * 1e9 / result->pairs : 0.0);
+        }
+      }
+      physicsSelectPrecision(PRECISION_NATIVE);
+      bodiesDestroy(&bodies);
+      bodiesDestroy(&initial);
+    }
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"benchmark\": \"SolarSystemBench\",\n");
+  fprintf(file, "  \"version\": 2,\n");
+  fprintf(file, "  \"kernel\": \"%s\",\n", gravityKernelName(gravityKernel()));
+  fprintf(file, "  \"hardware_threads\": %d,\n", threadPoolHardwareThreads());
+  fprintf(file, "  \"dt\": %.17g,\n", options.dt);
+  fprintf(file, "  \"budget\": %.17g,\n", options.budget);
+  fprintf(file, "  \"results\": [\n");
+  for( int r = 0; r < done; r++) writeResult(file, &results[r], r == done - 1);
+  fprintf(file, "  ]\n");
+  fprintf(file, "}\n");
+  bool ok = fflush(file) == 0 && !ferror(file);
+  if(file != stdout) ok = fclose(file) == 0 && ok;
+  free(results);
+  return ok && !failed ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+/*
+#================================================================================
+# * Block Steps             Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Hermite integration with individual power of two time steps
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "block_steps.h"
+#include "gravity.h"
+#include "thread_pool.h"
+#include <math.h>         // Header File for the math library
+#include <string.h>       // Header File for memset/memcpy
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define BLOCK_ARRAYS 15                          // doubles per body in scratch
+#define BLOCK_END    (1LL << BLOCK_MAX_LEVEL)    // ticks in one outer step
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagBlockTask - what the parallel loops need to know
+typedef struct
+{
+  tagBlockSteps* block;
+  tagBodies*     bodies;
+  long long      now;          // tick of the current sub-step
+  int            activeCount;
+}tagBlockTask;
+
+//#==============================================================================
+//# * stepTicks / tickSeconds
+//#------------------------------------------------------------------------------
+//# Length of a level's step in ticks, and a number of ticks in seconds
+//#==============================================================================
+static inline long long stepTicks(int level)
+{
+  return 1LL << (BLOCK_MAX_LEVEL - level);
+}
+
+static inline double tickSeconds(const tagBlockSteps* block, long long ticks)
+{
+  return (double)ticks * (block->outer / (double)BLOCK_END);
+}
+
+//#==============================================================================
+//# * levelFor
+//#------------------------------------------------------------------------------
+//# Shallowest level whose step is no longer than the one asked for
+//#==============================================================================
+static int levelFor(const tagBlockSteps* block, double step)
+{
+  int level = 0;
+  double size = block->outer;
+  while(level < BLOCK_MAX_LEVEL && !(size <= step))   // NaN goes to the bottom
+  {
+    size *= 0.5;
+    level++;
+  }
+  return level;
+}
+
+//#==============================================================================
+//# * blockStepsReserve
+//#------------------------------------------------------------------------------
+//# Makes room for the bodies, carving every array out of one allocation.
+//# Only needed from outside to put back saved levels and jerks.
+//#==============================================================================
+void blockStepsReserve(tagBlockSteps* block, int capacity)
+{
+  if(capacity <= block->capacity) return;
+  blockStepsDestroy(block);
+
+  unsigned long stride = ((unsigned long)capacity + 7) & ~7UL;   // 64-byte aligned
+  block->scratch = (double*)alignedAlloc(sizeof(double) * stride * BLOCK_ARRAYS);
+  double** arrays[BLOCK_ARRAYS] =
+  {
+    &block->jx,  &block->jy,  &block->jz,
+    &block->px,  &block->py,  &block->pz,
+    &block->pvx, &block->pvy, &block->pvz,
+    &block->nax, &block->nay, &block->naz,
+    &block->njx, &block->njy, &block->njz
+  };
+  for( int a = 0; a < BLOCK_ARRAYS; a++)
+  {
+    *arrays[a] = block->scratch + stride * a;
+  }
+  block->tick     = (long long*)alignedAlloc(sizeof(long long) * stride);
+  block->level    = (int*)alignedAlloc(sizeof(int) * stride);
+  block->active   = (int*)alignedAlloc(sizeof(int) * stride);
+  block->capacity = capacity;
+}
+
+//#==============================================================================
+//# * predictTask
+//#------------------------------------------------------------------------------
+//# Taylor series of every body from its own time to the current sub-step
+//#==============================================================================
+static void predictTask(void* context, int begin, int end)
+{
+  tagBlockTask* task   = (tagBlockTask*)context;
+  tagBlockSteps* block = task->block;
+  tagBodies* bodies    = task->bodies;
+  for( int i = begin; i < end; i++)
+  {
+    const double h  = tickSeconds(block, task->now - block->tick[i]);
+    const double h2 = h * h * 0.5, h3 = h * h * h / 6.0;
+    block->px[i]  = bodies->x[i]  + bodies->vx[i] * h + bodies->ax[i] * h2 + block->jx[i] * h3;
+    block->py[i]  = bodies->y[i]  + bodies->vy[i] * h + bodies->ay[i] * h2 + block->jy[i] * h3;
+    block->pz[i]  = bodies->z[i]  + bodies->vz[i] * h + bodies->az[i] * h2 + block->jz[i] * h3;
+    block->pvx[i] = bodies->vx[i] + bodies->ax[i] * h + block->jx[i] * h2;
+    block->pvy[i] = bodies->vy[i] + bodies->ay[i] * h + block->jy[i] * h2;
+    block->pvz[i] = bodies->vz[i] + bodies->az[i] * h + block->jz[i] * h2;
+  }
+}
+
+//#==============================================================================
+//# * forceTask
+//#------------------------------------------------------------------------------
+//# Acceleration and jerk of a range of active bodies from every predicted
+//# body. Each active body sums its sources in index order, so the result
+//# doesn't depend on how the active list is split between threads.
+//#==============================================================================
+static void forceTask(void* context, int begin, int end)
+{
+  tagBlockTask* task   = (tagBlockTask*)context;
+  tagBlockSteps* block = task->block;
+  const double* mass   = task->bodies->mass;
+  const double* px  = block->px;  const double* py  = block->py;  const double* pz  = block->pz;
+  const double* pvx = block->pvx; const double* pvy = block->pvy; const double* pvz = block->pvz;
+  const int count = task->bodies->count;
+
+  for( int a = begin; a < end; a++)
+  {
+    const int i = block->active[a];
+    const double xi  = px[i],  yi  = py[i],  zi  = pz[i];
+    const double vxi = pvx[i], vyi = pvy[i], vzi = pvz[i];
+    double ax = 0, ay = 0, az = 0, jx = 0, jy = 0, jz = 0;
+    for( int j = 0; j < count; j++)
+    {
+      double dx  = px[j] - xi,   dy  = py[j] - yi,   dz  = pz[j] - zi;
+      double dvx = pvx[j] - vxi, dvy = pvy[j] - vyi, dvz = pvz[j] - vzi;
+      double r2  = dx*dx + dy*dy + dz*dz;
+      double inv = r2 > 0 ? 1.0 / r2 : 0;        // the body itself adds nothing
+      double s   = gravity_constant * mass[j] * inv * sqrt(inv);
+      double rv  = 3.0 * (dx*dvx + dy*dvy + dz*dvz) * inv;
+      ax += s * dx;
+      ay += s * dy;
+      az += s * dz;
+      jx += s * (dvx - rv * dx);
+      jy += s * (dvy - rv * dy);
+      jz += s * (dvz - rv * dz);
+    }
+    block->nax[i] = ax; block->nay[i] = ay; block->naz[i] = az;
+    block->njx[i] = jx; block->njy[i] = jy; block->njz[i] = jz;
+  }
+}
+
+//#==============================================================================
+//# * correctTask
+//#------------------------------------------------------------------------------
+//# Hermite corrector for a range of active bodies, then a new level from
+//# Aarseth's criterion using the second and third derivatives the corrector
+//# implies. A step may shrink at any time but only grows one level at a
+//# time, and only where the longer step would start on its own boundary.
+//#==============================================================================
+static inline double length(double x, double y, double z)
+{
+  return sqrt(x*x + y*y + z*z);
+}
+
+static void correctTask(void* context, int begin, int end)
+{
+  tagBlockTask* task   = (tagBlockTask*)context;
+  tagBlockSteps* block = task->block;
+  tagBodies* bodies    = task->bodies;
+  for( int a = begin; a < end; a++)
+  {
+    const int i = block->active[a];
+    const double h = tickSeconds(block, task->now - block->tick[i]);
+    double* pos[3]  = { bodies->x,  bodies->y,  bodies->z  };
+    double* vel[3]  = { bodies->vx, bodies->vy, bodies->vz };
+    double* acc[3]  = { bodies->ax, bodies->ay, bodies->az };
+    double* jerk[3] = { block->jx,  block->jy,  block->jz  };
+    const double* newAcc[3]  = { block->nax, block->nay, block->naz };
+    const double* newJerk[3] = { block->njx, block->njy, block->njz };
+    double snap[3], crackle[3];
+
+    for( int c = 0; c < 3; c++)
+    {
+      double a0 = acc[c][i],    a1 = newAcc[c][i];
+      double j0 = jerk[c][i],   j1 = newJerk[c][i];
+      double v0 = vel[c][i];
+      double v1 = v0 + (a0 + a1) * h * 0.5 + (j0 - j1) * h * h / 12.0;
+      pos[c][i] += (v0 + v1) * h * 0.5 + (a0 - a1) * h * h / 12.0;
+      vel[c][i]  = v1;
+      acc[c][i]  = a1;
+      jerk[c][i] = j1;
+
+      double a3  = (12.0 * (a0 - a1) + 6.0 * h * (j0 + j1)) / (h * h * h);
+      double a2  = (-6.0 * (a0 - a1) - h * (4.0 * j0 + 2.0 * j1)) / (h * h);
+      snap[c]    = a2 + h * a3;    // at the end of the step
+      crackle[c] = a3;
+    }
+
+    double an = length(bodies->ax[i], bodies->ay[i], bodies->az[i]);
+    double jn = length(block->jx[i], block->jy[i], block->jz[i]);
+    double sn = length(snap[0], snap[1], snap[2]);
+    double cn = length(crackle[0], crackle[1], crackle[2]);
+    double below = jn * cn + sn * sn;
+    double step  = below > 0 ? sqrt(block->eta * (an * sn + jn * jn) / below) : block->outer;
+
+    int old   = block->level[i];
+    int level = levelFor(block, step);
+    if(level < old)
+    {
+      level = old - 1;
+      if(task->now % stepTicks(level) != 0) level = old;
+    }
+    block->level[i] = level;
+    block->tick[i]  = task->now;
+  }
+}
+
+//#==============================================================================
+//# * blockSync
+//#------------------------------------------------------------------------------
+//# Starts afresh from the bodies as they are: every body's acceleration and
+//# jerk, and a first level from the ratio of the two.
+//#==============================================================================
+static void blockSync(tagBlockSteps* block, tagBodies* bodies, double dt)
+{
+  const int count = bodies->count;
+  blockStepsReserve(block, count);
+  block->outer = dt;
+  block->count = count;
+  for( int i = 0; i < count; i++)
+  {
+    block->tick[i]   = 0;
+    block->active[i] = i;
+  }
+
+  memcpy(block->px,  bodies->x,  sizeof(double) * count);
+  memcpy(block->py,  bodies->y,  sizeof(double) * count);
+  memcpy(block->pz,  bodies->z,  sizeof(double) * count);
+  memcpy(block->pvx, bodies->vx, sizeof(double) * count);
+  memcpy(block->pvy, bodies->vy, sizeof(double) * count);
+  memcpy(block->pvz, bodies->vz, sizeof(double) * count);
+
+  tagBlockTask task = { block, bodies, 0, count };
+  threadPoolFor(count, 8, forceTask, &task);
+  block->forces += count;
+
+  for( int i = 0; i < count; i++)
+  {
+    bodies->ax[i] = block->nax[i]; bodies->ay[i] = block->nay[i]; bodies->az[i] = block->naz[i];
+    block->jx[i]  = block->njx[i]; block->jy[i]  = block->njy[i]; block->jz[i]  = block->njz[i];
+    double an = length(bodies->ax[i], bodies->ay[i], bodies->az[i]);
+    double jn = length(block->jx[i], block->jy[i], block->jz[i]);
+    block->level[i] = levelFor(block, jn > 0 ? 0.5 * block->eta * an / jn : dt);
+  }
+  block->synced = true;
+}
+
+//#==============================================================================
+//# * blockStepsCreate / blockStepsDestroy
+//#==============================================================================
+void blockStepsCreate(tagBlockSteps* block, double eta)
+{
+  memset(block, 0, sizeof(*block));
+  block->eta = eta;
+}
+
+void blockStepsDestroy(tagBlockSteps* block)
+{
+  if(block->scratch != NULL)
+  {
+    alignedFree(block->scratch);
+    alignedFree(block->tick);
+    alignedFree(block->level);
+    alignedFree(block->active);
+  }
+  block->scratch  = NULL;
+  block->capacity = 0;
+  block->synced   = false;
+}
+
+//#==============================================================================
+//# * blockStepsStep
+//#------------------------------------------------------------------------------
+//# Advances every body by dt. Bodies go through as many sub-steps as their
+//# levels ask for and all end up at the same time again. Levels carry over
+//# to the next call as long as dt and the number of bodies stay the same.
+//#==============================================================================
+void blockStepsStep(tagBlockSteps* block, tagBodies* bodies, double dt)
+{
+  if(!block->synced || block->outer != dt || block->count != bodies->count)
+  {
+    blockSync(block, bodies, dt);
+  }
+  const int count = bodies->count;
+
+  while(true)
+  {
+    // the next sub-step is the earliest time any body's step ends
+    long long now = BLOCK_END + 1;
+    for( int i = 0; i < count; i++)
+    {
+      long long next = block->tick[i] + stepTicks(block->level[i]);
+      now = next < now ? next : now;
+    }
+    if(now > BLOCK_END) break;   // everyone is at the end
+
+    int activeCount = 0;
+    for( int i = 0; i < count; i++)
+    {
+      if(block->tick[i] + stepTicks(block->level[i]) != now) continue;
+      block->active[activeCount++] = i;
+      if(block->level[i] > block->deepest) block->deepest = block->level[i];
+    }
+
+    tagBlockTask task = { block, bodies, now, activeCount };
+    threadPoolFor(count, 4096, predictTask, &task);
+    threadPoolFor(activeCount, 8, forceTask, &task);
+    threadPoolFor(activeCount, 256, correctTask, &task);
+    block->forces += activeCount;
+    block->blocks++;
+  }
+
+  for( int i = 0; i < count; i++)
+  {
+    block->tick[i] = 0;   // the end of this step is the start of the next
+  }
+}
@@ -0,0 +1,73 @@
+/*
+#================================================================================
+# * Block Steps             Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Fourth order Hermite integration with hierarchical block time steps. Every
+# body gets its own step, a power of two fraction of the outer step, chosen
+# from its acceleration and its derivatives (Aarseth's criterion). On each
+# sub-step only the bodies whose step ends there ("active" bodies) have their
+# forces worked out; everyone else is just predicted forward as a source.
+# Mercury can then take small steps without dragging Neptune along with it.
+#
+# Time inside an outer step is counted in integer ticks so that block
+# boundaries line up exactly; every body finishes the outer step together.
+#================================================================================
+*/
+#ifndef SOLAR_BLOCK_STEPS_H
+#define SOLAR_BLOCK_STEPS_H
+
+#include "bodies.h"
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define BLOCK_MAX_LEVEL 40    // smallest step is the outer step / 2^40
+#define BLOCK_ETA       0.02  // default accuracy parameter of the criterion
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagBlockSteps
+typedef struct
+{
+  double     eta;        // accuracy parameter (smaller is more accurate)
+  bool       synced;     // levels and jerks belong to the current bodies
+  double     outer;      // outer step the levels are fractions of
+  int        count;      // number of bodies when last synced
+  int        capacity;   // bodies the arrays below can hold
+  double*    scratch;    // backing store for the arrays below
+  double*    jx;         // jerk (derivative of acceleration) at the body's time
+  double*    jy;
+  double*    jz;
+  double*    px;         // predicted position at the current sub-step
+  double*    py;
+  double*    pz;
+  double*    pvx;        // predicted velocity at the current sub-step
+  double*    pvy;
+  double*    pvz;
+  double*    nax;        // new acceleration of active bodies
+  double*    nay;
+  double*    naz;
+  double*    njx;        // new jerk of active bodies
+  double*    njy;
+  double*    njz;
+  long long* tick;       // time of each body within the outer step
+  int*       level;      // step of each body is outer / 2^level
+  int*       active;     // bodies whose step ends at the current sub-step
+  long       blocks;     // sub-steps taken
+  long       forces;     // single body force evaluations
+  int        deepest;    // highest level used since creation
+}tagBlockSteps;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void blockStepsCreate  ( tagBlockSteps* block, double eta );
+void blockStepsDestroy ( tagBlockSteps* block );
+void blockStepsReserve ( tagBlockSteps* block, int capacity );
+void blockStepsStep    ( tagBlockSteps* block, tagBodies* bodies, double dt );
+
+#endif // SOLAR_BLOCK_STEPS_H
@@ -0,0 +1,175 @@
+/*
+#================================================================================
+# * Bodies                  Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Structure-of-arrays store for any number of bodies
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "bodies.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for posix_memalign/realloc/abort
+#include <string.h>       // Header File for memcpy
+
+//#==============================================================================
+//# * alignedAlloc / alignedFree
+//#------------------------------------------------------------------------------
+//# Allocates memory starting on a BODIES_ALIGNMENT boundary. Running out of
+//# memory is not something the simulation can recover from, so it aborts.
+//#==============================================================================
+void* alignedAlloc(unsigned long size)
+{
+  void* memory = NULL;
+  if(size == 0) size = BODIES_ALIGNMENT;
+#ifdef _WIN32
+  memory = _aligned_malloc(size, BODIES_ALIGNMENT);
+#else
+  if(posix_memalign(&memory, BODIES_ALIGNMENT, size) != 0) memory = NULL;
+#endif
+  if(memory == NULL)
+  {
+    fprintf(stderr, "out of memory allocating %lu bytes\n", size);
+    abort();
+  }
+  return memory;
+}
+
+void alignedFree(void* memory)
+{
+#ifdef _WIN32
+  _aligned_free(memory);
+#else
+  free(memory);
+#endif
+}
+
+//#==============================================================================
+//# * growMemory
+//#------------------------------------------------------------------------------
+//# realloc that aborts rather than returning NULL, for the same reason
+//#==============================================================================
+void* growMemory(void* memory, unsigned long size)
+{
+  void* grown = realloc(memory, size);
+  if(grown == NULL)
+  {
+    fprintf(stderr, "out of memory allocating %lu bytes\n", size);
+    abort();
+  }
+  return grown;
+}
+
+//#==============================================================================
+//# * growArray
+//#------------------------------------------------------------------------------
+//# Moves the first "count" values of an array into a new, larger one
+//#==============================================================================
+static double* growArray(double* array, int count, int capacity)
+{
+  double* grown = (double*)alignedAlloc(sizeof(double) * (unsigned long)capacity);
+  if(array != NULL)
+  {
+    memcpy(grown, array, sizeof(double) * (unsigned long)count);
+    alignedFree(array);
+  }
+  return grown;
+}
+
+//#==============================================================================
+//# * bodiesCreate
+//#------------------------------------------------------------------------------
+//# Sets up an empty store with room for "capacity" bodies
+//#==============================================================================
+void bodiesCreate(tagBodies* bodies, int capacity)
+{
+  memset(bodies, 0, sizeof(*bodies));
+  bodiesReserve(bodies, capacity > 0 ? capacity : 1);
+}
+
+//#==============================================================================
+//# * bodiesDestroy
+//#------------------------------------------------------------------------------
+//# Releases every array
+//#==============================================================================
+void bodiesDestroy(tagBodies* bodies)
+{
+  double** arrays[] = { &bodies->x,  &bodies->y,  &bodies->z,
+                        &bodies->vx, &bodies->vy, &bodies->vz,
+                        &bodies->ax, &bodies->ay, &bodies->az,
+                        &bodies->mass, &bodies->radius };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    if(*arrays[i] != NULL) alignedFree(*arrays[i]);
+    *arrays[i] = NULL;
+  }
+  bodies->count    = 0;
+  bodies->capacity = 0;
+}
+
+//#==============================================================================
+//# * bodiesReserve
+//#------------------------------------------------------------------------------
+//# Makes sure the arrays can hold at least "capacity" bodies. Existing bodies
+//# are kept.
+//#==============================================================================
+void bodiesReserve(tagBodies* bodies, int capacity)
+{
+  if(capacity <= bodies->capacity) return;
+
+  double** arrays[] = { &bodies->x,  &bodies->y,  &bodies->z,
+                        &bodies->vx, &bodies->vy, &bodies->vz,
+                        &bodies->ax, &bodies->ay, &bodies->az,
+                        &bodies->mass, &bodies->radius };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    *arrays[i] = growArray(*arrays[i], bodies->count, capacity);
+  }
+  bodies->capacity = capacity;
+}
+
+//#==============================================================================
+//# * bodiesCopy
+//#------------------------------------------------------------------------------
+//# Makes "destination" hold the same bodies as "source"
+//#==============================================================================
+void bodiesCopy(tagBodies* destination, const tagBodies* source)
+{
+  bodiesReserve(destination, source->count);
+  unsigned long size = sizeof(double) * (unsigned long)source->count;
+  memcpy(destination->x,      source->x,      size);
+  memcpy(destination->y,      source->y,      size);
+  memcpy(destination->z,      source->z,      size);
+  memcpy(destination->vx,     source->vx,     size);
+  memcpy(destination->vy,     source->vy,     size);
+  memcpy(destination->vz,     source->vz,     size);
+  memcpy(destination->ax,     source->ax,     size);
+  memcpy(destination->ay,     source->ay,     size);
+  memcpy(destination->az,     source->az,     size);
+  memcpy(destination->mass,   source->mass,   size);
+  memcpy(destination->radius, source->radius, size);
+  destination->count = source->count;
+}
+
+//#==============================================================================
+//# * bodiesAdd
+//#------------------------------------------------------------------------------
+//# Appends a body, growing the arrays if needed. Returns the new body's index.
+//#==============================================================================
+int bodiesAdd(tagBodies* bodies, double mass, double radius,
+              double x,  double y,  double z,
+              double vx, double vy, double vz)
+{
+  if(bodies->count == bodies->capacity)
+  {
+    bodiesReserve(bodies, bodies->capacity * 2);
+  }
+  int i = bodies->count++;
+  bodies->x[i]  = x;   bodies->y[i]  = y;   bodies->z[i]  = z;
+  bodies->vx[i] = vx;  bodies->vy[i] = vy;  bodies->vz[i] = vz;
+  bodies->ax[i] = 0;   bodies->ay[i] = 0;   bodies->az[i] = 0;
+  bodies->mass[i]   = mass;
+  bodies->radius[i] = radius;
+  return i;
+}
@@ -0,0 +1,57 @@
+/*
+#================================================================================
+# * Bodies                  Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Structure-of-arrays store for any number of bodies. Each component lives in
+# its own contiguous, 64-byte aligned array so the force loops stream through
+# memory instead of striding across whole objects.
+#================================================================================
+*/
+#ifndef SOLAR_BODIES_H
+#define SOLAR_BODIES_H
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define BODIES_ALIGNMENT 64   // cache line (and widest SIMD register) size
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagBodies
+typedef struct
+{
+  double* x;         // x component of position
+  double* y;         // y component of position
+  double* z;         // z component of position
+  double* vx;        // x component of velocity
+  double* vy;        // y component of velocity
+  double* vz;        // z component of velocity
+  double* ax;        // x component of acceleration (scratch for the step)
+  double* ay;        // y component of acceleration (scratch for the step)
+  double* az;        // z component of acceleration (scratch for the step)
+  double* mass;      // mass of the body (kg)
+  double* radius;    // physical radius of the body (m)
+  int     count;     // number of bodies in use
+  int     capacity;  // number of bodies the arrays can hold
+}tagBodies;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void bodiesCreate  ( tagBodies* bodies, int capacity );
+void bodiesDestroy ( tagBodies* bodies );
+void bodiesReserve ( tagBodies* bodies, int capacity );
+void bodiesCopy    ( tagBodies* destination, const tagBodies* source );
+int  bodiesAdd     ( tagBodies* bodies, double mass, double radius,
+                     double x,  double y,  double z,
+                     double vx, double vy, double vz );
+
+void* alignedAlloc ( unsigned long size );
+void  alignedFree  ( void* memory );
+void* growMemory   ( void* memory, unsigned long size );
+
+#endif // SOLAR_BODIES_H
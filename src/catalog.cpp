@@ -0,0 +1,492 @@
+/*
+#================================================================================
+# * Catalog                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# CSV and packed catalog loading, straight out of a memory map
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "catalog.h"
+#include "gravity.h"
+#include "mapped_file.h"
+#include "clock.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for strtod
+#include <string.h>       // Header File for memchr/memcpy
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define CATALOG_COLUMNS 64                  // columns looked at in a CSV row
+#define CATALOG_AU      1.495978707E+11     // astronomical unit (m)
+#define CATALOG_TILT    0.40909280422232897 // obliquity of the ecliptic (J2000, rad)
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of the CSV columns that mean something
+enum
+{
+  COLUMN_IGNORED = -1,
+  COLUMN_MASS = 0, COLUMN_RADIUS,
+  COLUMN_X,  COLUMN_Y,  COLUMN_Z,  COLUMN_VX, COLUMN_VY,   COLUMN_VZ,
+  COLUMN_A,  COLUMN_E,  COLUMN_I,  COLUMN_NODE, COLUMN_PERI, COLUMN_M,
+  COLUMN_COUNT
+};
+
+static const char* columnNames[COLUMN_COUNT] =
+{
+  "mass", "radius", "x", "y", "z", "vx", "vy", "vz",
+  "a", "e", "i", "node", "peri", "M"
+};
+
+//#==============================================================================
+//# * parseNumber
+//#------------------------------------------------------------------------------
+//# Reads a decimal number from [p, end), which need not be NUL terminated.
+//# Returns the first character after it, or NULL if there isn't one. Most
+//# values (up to 15 or so significant digits with a small exponent) are
+//# converted exactly without strtod; anything else is copied out for strtod
+//# so the result is always correctly rounded.
+//#==============================================================================
+static const char* parseNumber(const char* p, const char* end, double* out)
+{
+  const char* start = p;
+  bool negative = false;
+  if(p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+  unsigned long long mantissa = 0;
+  int  digits = 0, scale = 0;
+  bool any = false, exact = true;
+  for( ; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    any = true;
+    if(digits < 19)
+    {
+      mantissa = mantissa * 10 + (unsigned)(*p - '0');
+      if(mantissa != 0) digits++;
+    }
+    else
+    {
+      scale++;
+      if(*p != '0') exact = false;
+    }
+  }
+  if(p < end && *p == '.')
+  {
+    for( p++; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+      any = true;
+      if(digits < 19)
+      {
+        mantissa = mantissa * 10 + (unsigned)(*p - '0');
+        if(mantissa != 0) digits++;
+        scale--;
+      }
+      else if(*p != '0') exact = false;
+    }
+  }
+  if(!any) return NULL;
+
+  if(p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* q = p + 1;
+    bool minus = false;
+    if(q < end && (*q == '-' || *q == '+')) minus = *q++ == '-';
+    if(q < end && *q >= '0' && *q <= '9')
+    {
+      int exponent = 0;
+      for( ; q < end && *q >= '0' && *q <= '9'; q++)
+        if(exponent < 10000) exponent = exponent * 10 + (*q - '0');
+      scale += minus ? -exponent : exponent;
+      p = q;
+    }
+  }
+
+  static const double powers[] = { 1E0,  1E1,  1E2,  1E3,  1E4,  1E5,  1E6,  1E7,
+                                   1E8,  1E9,  1E10, 1E11, 1E12, 1E13, 1E14, 1E15,
+                                   1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22 };
+  if(exact && mantissa <= (1ULL << 53) && scale >= -22 && scale <= 22)
+  {
+    double value = (double)mantissa;                  // both exact, so one rounding
+    value = scale >= 0 ? value * powers[scale] : value / powers[-scale];
+    *out  = negative ? -value : value;
+    return p;
+  }
+
+  char copy[128];
+  if(p - start >= (long)sizeof(copy)) return NULL;
+  memcpy(copy, start, p - start);
+  copy[p - start] = '\0';
+  *out = strtod(copy, NULL);
+  return p;
+}
+
+//#==============================================================================
+//# * trimField
+//#------------------------------------------------------------------------------
+//# Narrows [*begin, *end) to leave out spaces and surrounding quotes
+//#==============================================================================
+static void trimField(const char** begin, const char** end)
+{
+  while(*begin < *end && (**begin == ' ' || **begin == '\t')) ++*begin;
+  while(*end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '\r')) --*end;
+  if(*end - *begin >= 2 && **begin == '"' && (*end)[-1] == '"')
+  {
+    ++*begin;
+    --*end;
+  }
+}
+
+//#==============================================================================
+//# * nextField
+//#------------------------------------------------------------------------------
+//# The field starting at p on a line ending at "end": sets [*begin, *finish)
+//# and returns where the next field starts (past end if this was the last).
+//# Commas inside quotes don't split fields.
+//#==============================================================================
+static const char* nextField(const char* p, const char* end,
+                             const char** begin, const char** finish)
+{
+  const char* q = p;
+  bool quoted = false;
+  for( ; q < end; q++)
+  {
+    if(*q == '"') quoted = !quoted;
+    else if(*q == ',' && !quoted) break;
+  }
+  *begin  = p;
+  *finish = q;
+  trimField(begin, finish);
+  return q + 1;
+}
+
+//#==============================================================================
+//# * sameName
+//#------------------------------------------------------------------------------
+//# Case-insensitive comparison of a field with a column name
+//#==============================================================================
+static bool sameName(const char* begin, const char* end, const char* name)
+{
+  for( ; begin < end && *name != '\0'; begin++, name++)
+  {
+    char c = *begin;
+    char n = *name;
+    if(c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    if(n >= 'A' && n <= 'Z') n = (char)(n - 'A' + 'a');
+    if(c != n) return false;
+  }
+  return begin == end && *name == '\0';
+}
+
+//#==============================================================================
+//# * elementsToState
+//#------------------------------------------------------------------------------
+//# Heliocentric ecliptic orbital elements (a in AU, angles in degrees) to a
+//# position and velocity relative to a centre of mass "gm", turned into the
+//# equatorial frame the planets' seed values are in
+//#==============================================================================
+static void elementsToState(const double* values, double gm, double p[3], double v[3])
+{
+  const double degrees = 0.017453292519943295;
+  double a     = values[COLUMN_A] * CATALOG_AU;
+  double e     = values[COLUMN_E];
+  double i     = values[COLUMN_I]    * degrees;
+  double node  = values[COLUMN_NODE] * degrees;
+  double peri  = values[COLUMN_PERI] * degrees;
+  double M     = fmod(values[COLUMN_M] * degrees, 6.283185307179586);
+
+  double E = e < 0.8 ? M : 3.141592653589793;       // Kepler's equation by Newton
+  for( int k = 0; k < 50; k++)
+  {
+    double step = (E - e * sin(E) - M) / (1 - e * cos(E));
+    E -= step;
+    if(fabs(step) < 1E-15) break;
+  }
+
+  double root = sqrt(1 - e * e);
+  double r    = a * (1 - e * cos(E));
+  double xp   = a * (cos(E) - e),   yp  = a * root * sin(E);
+  double rate = sqrt(gm * a) / r;
+  double vxp  = -rate * sin(E),     vyp = rate * root * cos(E);
+
+  double cn = cos(node), sn = sin(node), cw = cos(peri), sw = sin(peri);
+  double ci = cos(i),    si = sin(i);
+  double px = cn * cw - sn * sw * ci,  qx = -cn * sw - sn * cw * ci;
+  double py = sn * cw + cn * sw * ci,  qy = -sn * sw + cn * cw * ci;
+  double pz = sw * si,                 qz = cw * si;
+
+  double ecliptic[6] = { px * xp  + qx * yp,  py * xp  + qy * yp,  pz * xp  + qz * yp,
+                         px * vxp + qx * vyp, py * vxp + qy * vyp, pz * vxp + qz * vyp };
+  double ct = cos(CATALOG_TILT), st = sin(CATALOG_TILT);
+  p[0] = ecliptic[0];
+  p[1] = ecliptic[1] * ct - ecliptic[2] * st;
+  p[2] = ecliptic[1] * st + ecliptic[2] * ct;
+  v[0] = ecliptic[3];
+  v[1] = ecliptic[4] * ct - ecliptic[5] * st;
+  v[2] = ecliptic[4] * st + ecliptic[5] * ct;
+}
+
+//#==============================================================================
+//# * addRow
+//#------------------------------------------------------------------------------
+//# Files one row as a body or a test particle, growing the arrays by doubling
+//# so that a million rows only reallocate a handful of times
+//#==============================================================================
+static void addRow(tagBodies* bodies, tagParticles* particles, double massiveAbove,
+                   double mass, double radius, const double p[3], const double v[3],
+                   tagCatalogStats* stats)
+{
+  if(mass > massiveAbove)
+  {
+    if(bodies->count == bodies->capacity)
+      bodiesReserve(bodies, bodies->capacity > 0 ? bodies->capacity * 2 : 1024);
+    bodiesAdd(bodies, mass, radius, p[0], p[1], p[2], v[0], v[1], v[2]);
+    stats->massive++;
+  }
+  else
+  {
+    if(particles->count == particles->capacity)
+      particlesReserve(particles, particles->capacity > 0 ? particles->capacity * 2 : 1024);
+    particlesAdd(particles, p[0], p[1], p[2], v[0], v[1], v[2]);
+    stats->particles++;
+  }
+}
+
+//#==============================================================================
+//# * loadCsv
+//#------------------------------------------------------------------------------
+//# Parses a CSV catalog in place. Returns false (after saying where) at the
+//# first thing it can't make sense of.
+//#==============================================================================
+static bool loadCsv(const char* path, const char* data, const char* end, double massiveAbove,
+                    tagBodies* bodies, tagParticles* particles, tagCatalogStats* stats)
+{
+  int  columns[CATALOG_COLUMNS];
+  int  columnCount = 0;
+  bool header = false, elements = false;
+  long line   = 0;
+
+  for( const char* p = data; p < end; )
+  {
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    if(eol == NULL) eol = end;
+    const char* row = p;
+    p = eol + 1;
+    line++;
+
+    const char* first = row;
+    while(first < eol && (*first == ' ' || *first == '\t' || *first == '\r')) first++;
+    if(first == eol || *first == '#') continue;
+
+    if(!header)
+    {
+      // the column names, and from them which kind of rows follow
+      bool seen[COLUMN_COUNT] = { false };
+      for( const char* f = row; f <= eol && columnCount < CATALOG_COLUMNS; )
+      {
+        const char *begin, *finish;
+        f = nextField(f, eol, &begin, &finish);
+        int column = COLUMN_IGNORED;
+        for( int c = 0; c < COLUMN_COUNT; c++)
+          if(sameName(begin, finish, columnNames[c])) column = c;
+        if(column != COLUMN_IGNORED && seen[column]) column = COLUMN_IGNORED;
+        if(column != COLUMN_IGNORED) seen[column] = true;
+        columns[columnCount++] = column;
+      }
+      bool state = true, orbit = true;
+      for( int c = COLUMN_X; c <= COLUMN_VZ; c++) state = state && seen[c];
+      for( int c = COLUMN_A; c <= COLUMN_M;  c++) orbit = orbit && seen[c];
+      if(!state && !orbit)
+      {
+        fprintf(stderr, "%s:%ld: the header needs x,y,z,vx,vy,vz or a,e,i,node,peri,M\n",
+                path, line);
+        return false;
+      }
+      elements = !state;
+      header   = true;
+      continue;
+    }
+
+    double values[COLUMN_COUNT] = { 0 };
+    int    column = 0;
+    for( const char* f = row; f <= eol && column < columnCount; column++)
+    {
+      const char *begin, *finish;
+      f = nextField(f, eol, &begin, &finish);
+      int role = columns[column];
+      if(role == COLUMN_IGNORED) continue;
+      if(begin == finish && (role == COLUMN_MASS || role == COLUMN_RADIUS)) continue;
+      if(parseNumber(begin, finish, &values[role]) != finish)
+      {
+        fprintf(stderr, "%s:%ld: '%.*s' is not a number (column %s)\n", path, line,
+                (int)(finish - begin), begin, columnNames[role]);
+        return false;
+      }
+    }
+    if(column < columnCount)
+    {
+      fprintf(stderr, "%s:%ld: expected %d columns\n", path, line, columnCount);
+      return false;
+    }
+
+    double position[3], velocity[3];
+    if(elements)
+    {
+      if(bodies->count == 0)
+      {
+        fprintf(stderr, "%s:%ld: orbital elements need a body to orbit; "
+                        "list the sun (with x..vz columns) first\n", path, line);
+        return false;
+      }
+      if(!(values[COLUMN_E] >= 0 && values[COLUMN_E] < 1 && values[COLUMN_A] > 0))
+      {
+        fprintf(stderr, "%s:%ld: only closed orbits (0 <= e < 1, a > 0) can be loaded\n",
+                path, line);
+        return false;
+      }
+      elementsToState(values, gravity_constant * bodies->mass[0], position, velocity);
+      position[0] += bodies->x[0];   velocity[0] += bodies->vx[0];
+      position[1] += bodies->y[0];   velocity[1] += bodies->vy[0];
+      position[2] += bodies->z[0];   velocity[2] += bodies->vz[0];
+    }
+    else
+    {
+      for( int k = 0; k < 3; k++)
+      {
+        position[k] = values[COLUMN_X + k];
+        velocity[k] = values[COLUMN_VX + k];
+      }
+    }
+    addRow(bodies, particles, massiveAbove, values[COLUMN_MASS], values[COLUMN_RADIUS],
+           position, velocity, stats);
+    stats->rows++;
+  }
+
+  if(!header)
+  {
+    fprintf(stderr, "%s: no header line\n", path);
+    return false;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * loadPacked
+//#------------------------------------------------------------------------------
+//# Copies the arrays of a packed catalog onto the end of bodies and particles
+//#==============================================================================
+static bool loadPacked(const char* path, const tagMappedFile* file,
+                       tagBodies* bodies, tagParticles* particles, tagCatalogStats* stats)
+{
+  const tagCatalogHeader* header = (const tagCatalogHeader*)file->data;
+  uint64_t left = file->size - sizeof(*header);
+  if(header->version != CATALOG_VERSION || header->massive > 0x7FFFFFFF ||
+     header->particles > 0x7FFFFFFF ||
+     left != sizeof(double) * (8 * header->massive + 6 * header->particles))
+  {
+    fprintf(stderr, "%s is not a packed catalog this version can read\n", path);
+    return false;
+  }
+  const double* in = (const double*)(file->data + sizeof(*header));
+
+  int massive = (int)header->massive;
+  bodiesReserve(bodies, bodies->count + massive);
+  double* arrays[] = { bodies->mass, bodies->radius, bodies->x,  bodies->y,  bodies->z,
+                       bodies->vx,   bodies->vy,     bodies->vz };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++, in += massive)
+    memcpy(arrays[a] + bodies->count, in, sizeof(double) * massive);
+  memset(bodies->ax + bodies->count, 0, sizeof(double) * massive);
+  memset(bodies->ay + bodies->count, 0, sizeof(double) * massive);
+  memset(bodies->az + bodies->count, 0, sizeof(double) * massive);
+  bodies->count += massive;
+
+  int count = (int)header->particles;
+  particlesReserve(particles, particles->count + count);
+  double* values[] = { particles->x,  particles->y,  particles->z,
+                       particles->vx, particles->vy, particles->vz };
+  for( unsigned v = 0; v < sizeof(values)/sizeof(values[0]); v++, in += count)
+    memcpy(values[v] + particles->count, in, sizeof(double) * count);
+  memset(particles->ax + particles->count, 0, sizeof(double) * count);
+  memset(particles->ay + particles->count, 0, sizeof(double) * count);
+  memset(particles->az + particles->count, 0, sizeof(double) * count);
+  particles->count += count;
+  particles->fresh  = false;
+
+  stats->rows      = massive + (long)count;
+  stats->massive   = massive;
+  stats->particles = count;
+  return true;
+}
+
+//#==============================================================================
+//# * catalogLoad
+//#------------------------------------------------------------------------------
+//# Appends the catalog at "path" (CSV or packed, told apart by the first
+//# bytes) to bodies and particles. Rows heavier than massiveAbove kg become
+//# bodies and the rest test particles; packed catalogs are already split.
+//# Returns false (after saying why) if the file can't be read, in which case
+//# some of its rows may already have been added.
+//#==============================================================================
+bool catalogLoad(const char* path, double massiveAbove, tagBodies* bodies,
+                 tagParticles* particles, tagCatalogStats* stats)
+{
+  double start = clockSeconds();
+  memset(stats, 0, sizeof(*stats));
+
+  tagMappedFile file;
+  if(!mappedFileOpen(&file, path))
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+  stats->bytes  = (double)file.size;
+  stats->packed = file.size >= sizeof(tagCatalogHeader) &&
+                  memcmp(file.data, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) == 0;
+
+  const char* data = (const char*)file.data;
+  bool ok = stats->packed
+          ? loadPacked(path, &file, bodies, particles, stats)
+          : loadCsv(path, data, data + file.size, massiveAbove, bodies, particles, stats);
+  mappedFileClose(&file);
+  stats->seconds = clockSeconds() - start;
+  return ok;
+}
+
+//#==============================================================================
+//# * catalogSave
+//#------------------------------------------------------------------------------
+//# Writes bodies and particles as a packed catalog. Returns false if the file
+//# couldn't be written.
+//#==============================================================================
+bool catalogSave(const char* path, const tagBodies* bodies, const tagParticles* particles)
+{
+  FILE* file = fopen(path, "wb");
+  if(file == NULL) return false;
+
+  tagCatalogHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+  header.version   = CATALOG_VERSION;
+  header.massive   = (uint64_t)bodies->count;
+  header.particles = (uint64_t)particles->count;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  const double* arrays[] = { bodies->mass, bodies->radius, bodies->x,  bodies->y,  bodies->z,
+                             bodies->vx,   bodies->vy,     bodies->vz };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+    ok = ok && fwrite(arrays[a], sizeof(double), bodies->count, file) == (size_t)bodies->count;
+  const double* values[] = { particles->x,  particles->y,  particles->z,
+                             particles->vx, particles->vy, particles->vz };
+  for( unsigned v = 0; v < sizeof(values)/sizeof(values[0]); v++)
+    ok = ok && fwrite(values[v], sizeof(double), particles->count, file)
+               == (size_t)particles->count;
+
+  ok = fclose(file) == 0 && ok;
+  return ok;
+}
@@ -0,0 +1,79 @@
+/*
+#================================================================================
+# * Catalog                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Initial conditions read from a file instead of the built-in 2011 values.
+#
+# CSV catalogs start with a header line naming the columns, in any order.
+# Lines starting with # and blank lines are skipped, and so are columns with
+# names not listed here (so exports with extra columns load as they are):
+#   name               ignored, may be quoted
+#   mass, radius       kg and m (both 0 if missing)
+#   x, y, z            position (m)
+#   vx, vy, vz         velocity (m/s)
+# or, instead of x..vz, heliocentric ecliptic orbital elements about the
+# first body loaded (as in MPC-style lists):
+#   a                  semi-major axis (AU)
+#   e                  eccentricity (below 1)
+#   i, node, peri, M   inclination, longitude of the ascending node, argument
+#                      of perihelion and mean anomaly (degrees)
+#
+# Packed catalogs (written by catalogSave) hold the same thing as plain
+# arrays and load with one copy per array:
+#   tagCatalogHeader
+#   massive bodies: mass, radius, x, y, z, vx, vy, vz (double x massive each)
+#   test particles: x, y, z, vx, vy, vz (double x particles each)
+#
+# Either kind is mapped and read in place; rows are parsed straight out of
+# the map with nothing allocated per row.
+#================================================================================
+*/
+#ifndef SOLAR_CATALOG_H
+#define SOLAR_CATALOG_H
+
+#include "bodies.h"
+#include "particles.h"
+#include <stdint.h>       // Header File for fixed width integers
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define CATALOG_MAGIC   "SOLCAT"   // first 8 bytes of a packed catalog (with \0s)
+#define CATALOG_VERSION 1
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagCatalogHeader - start of a packed catalog
+typedef struct
+{
+  char     magic[8];    // CATALOG_MAGIC
+  uint32_t version;     // CATALOG_VERSION
+  uint32_t reserved;
+  uint64_t massive;     // bodies that pull on everything
+  uint64_t particles;   // massless test particles
+}tagCatalogHeader;
+
+// tagCatalogStats - what a load did
+typedef struct
+{
+  long   rows;          // rows read
+  int    massive;       // rows that became bodies
+  int    particles;     // rows that became test particles
+  bool   packed;        // was it a packed catalog?
+  double bytes;         // size of the file
+  double seconds;       // wall time for the whole load
+}tagCatalogStats;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool catalogLoad ( const char* path, double massiveAbove, tagBodies* bodies,
+                   tagParticles* particles, tagCatalogStats* stats );
+bool catalogSave ( const char* path, const tagBodies* bodies,
+                   const tagParticles* particles );
+
+#endif // SOLAR_CATALOG_H
@@ -0,0 +1,559 @@
+/*
+#================================================================================
+# * Checkpoint              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Saving and restoring the whole simulation, written out on its own thread
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "checkpoint.h"
+#include "physics.h"
+#include "precision.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include <stdio.h>              // Header File for the standard library
+#include <stdlib.h>             // Header File for realloc/free
+#include <string.h>             // Header File for memcpy/memcmp
+#include <condition_variable>   // Header File for std::condition_variable
+#include <mutex>                // Header File for std::mutex
+#include <thread>               // Header File for std::thread
+#ifdef _WIN32
+# include <io.h>                // Header File for _commit
+# include <windows.h>           // Header File for MoveFileEx
+#else
+# include <unistd.h>            // Header File for fsync
+#endif
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagCheckpointBuffer - a state packed for writing
+typedef struct
+{
+  unsigned char* data;
+  uint64_t       size;
+  uint64_t       capacity;
+}tagCheckpointBuffer;
+
+// tagCheckpointReader - what is left of a state being unpacked
+typedef struct
+{
+  const unsigned char* data;
+  uint64_t             left;
+  bool                 ok;      // false once anything ran off the end
+}tagCheckpointReader;
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static char*                   target    = NULL;   // the checkpoint file
+static char*                   temporary = NULL;   // written, then renamed to target
+static tagCheckpointBuffer     buffers[3];         // filling, pending and writing
+static tagCheckpointBuffer*    filling   = &buffers[0];   // saver side only
+static tagCheckpointBuffer*    pending   = &buffers[1];   // handed over, not yet taken
+static tagCheckpointBuffer*    writing   = &buffers[2];   // writer side only
+static bool                    ready     = false;  // "pending" holds a state
+static tagCheckpointView       view      = { 0, 0, 0, 0 };
+static long                    written   = 0;
+static long                    dropped   = 0;
+static std::thread             writer;
+static std::mutex              writerMutex;        // guards the globals shared with the writer
+static std::condition_variable writerWake;
+static bool                    stopping  = false;
+
+//#==============================================================================
+//# * put / putInt / putLong / putDouble
+//#------------------------------------------------------------------------------
+//# Appends to a buffer. Everything is stored at a fixed width so that the
+//# file doesn't depend on the size of long.
+//#==============================================================================
+static void put(tagCheckpointBuffer* buffer, const void* data, uint64_t bytes)
+{
+  if(buffer->size + bytes > buffer->capacity)
+  {
+    uint64_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while(capacity < buffer->size + bytes) capacity *= 2;
+    buffer->data     = (unsigned char*)growMemory(buffer->data, (unsigned long)capacity);
+    buffer->capacity = capacity;
+  }
+  if(bytes > 0) memcpy(buffer->data + buffer->size, data, bytes);
+  buffer->size += bytes;
+}
+
+static void putInt(tagCheckpointBuffer* buffer, int value)
+{
+  int32_t stored = value;
+  put(buffer, &stored, sizeof(stored));
+}
+
+static void putLong(tagCheckpointBuffer* buffer, long value)
+{
+  int64_t stored = value;
+  put(buffer, &stored, sizeof(stored));
+}
+
+static void putDouble(tagCheckpointBuffer* buffer, double value)
+{
+  put(buffer, &value, sizeof(value));
+}
+
+//#==============================================================================
+//# * get / getInt / getLong / getDouble
+//#------------------------------------------------------------------------------
+//# The reverse of put. Reading past the end gives zeros and clears ok.
+//#==============================================================================
+static void get(tagCheckpointReader* reader, void* data, uint64_t bytes)
+{
+  if(!reader->ok || bytes > reader->left)
+  {
+    reader->ok = false;
+    memset(data, 0, bytes);
+    return;
+  }
+  if(bytes > 0) memcpy(data, reader->data, bytes);
+  reader->data += bytes;
+  reader->left -= bytes;
+}
+
+static int getInt(tagCheckpointReader* reader)
+{
+  int32_t stored;
+  get(reader, &stored, sizeof(stored));
+  return stored;
+}
+
+static long getLong(tagCheckpointReader* reader)
+{
+  int64_t stored;
+  get(reader, &stored, sizeof(stored));
+  return (long)stored;
+}
+
+static double getDouble(tagCheckpointReader* reader)
+{
+  double stored;
+  get(reader, &stored, sizeof(stored));
+  return stored;
+}
+
+//#==============================================================================
+//# * checksum
+//#------------------------------------------------------------------------------
+//# 64-bit FNV-1a
+//#==============================================================================
+static uint64_t checksum(const unsigned char* data, uint64_t bytes)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for( uint64_t i = 0; i < bytes; i++)
+  {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+//#==============================================================================
+//# * writeFile
+//#------------------------------------------------------------------------------
+//# Writes a packed state to the temporary file, makes sure it is on the disk
+//# and then renames it over the checkpoint, which is atomic on both POSIX
+//# and NTFS: a reader sees either the old checkpoint or the new one.
+//#==============================================================================
+static bool writeFile(const tagCheckpointBuffer* state)
+{
+  tagCheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+  header.version  = CHECKPOINT_VERSION;
+  header.bytes    = state->size;
+  header.checksum = checksum(state->data, state->size);
+
+  FILE* file = fopen(temporary, "wb");
+  if(file == NULL) return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+         && fwrite(state->data, 1, state->size, file) == state->size
+         && fflush(file) == 0;
+#ifdef _WIN32
+  ok = ok && _commit(_fileno(file)) == 0;
+  ok = fclose(file) == 0 && ok;
+  ok = ok && MoveFileExA(temporary, target,
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  ok = ok && fsync(fileno(file)) == 0;
+  ok = fclose(file) == 0 && ok;
+  ok = ok && rename(temporary, target) == 0;
+#endif
+  if(!ok) remove(temporary);
+  return ok;
+}
+
+//#==============================================================================
+//# * writerMain
+//#------------------------------------------------------------------------------
+//# Background thread: writes each state handed over, until stopped with
+//# nothing left waiting
+//#==============================================================================
+static void writerMain()
+{
+  profilerNameThread("checkpoint");
+  std::unique_lock<std::mutex> lock(writerMutex);
+  for(;;)
+  {
+    while(!ready && !stopping) writerWake.wait(lock);
+    if(!ready) break;
+
+    tagCheckpointBuffer* swap = writing;
+    writing = pending;
+    pending = swap;
+    ready   = false;
+
+    lock.unlock();
+    bool ok;
+    {
+      PROFILE_ZONE("checkpoint write");
+      ok = writeFile(writing);
+    }
+    lock.lock();
+    if(ok)
+      written++;
+    else
+      fprintf(stderr, "checkpoint: can't write %s\n", target);
+  }
+}
+
+//#==============================================================================
+//# * checkpointStart
+//#------------------------------------------------------------------------------
+//# Starts the writer for checkpoints kept at "path". Returns false if the
+//# temporary file next to it can't be created.
+//#==============================================================================
+bool checkpointStart(const char* path)
+{
+  checkpointStop();
+
+  unsigned long length = (unsigned long)strlen(path);
+  target    = (char*)growMemory(NULL, length + 1);
+  temporary = (char*)growMemory(NULL, length + 5);
+  memcpy(target, path, length + 1);
+  memcpy(temporary, path, length);
+  memcpy(temporary + length, ".tmp", 5);
+
+  FILE* probe = fopen(temporary, "wb");   // find out now rather than at the first save
+  if(probe == NULL)
+  {
+    free(target);
+    free(temporary);
+    target = temporary = NULL;
+    return false;
+  }
+  fclose(probe);
+  remove(temporary);
+
+  stopping = false;
+  ready    = false;
+  written  = 0;
+  dropped  = 0;
+  writer   = std::thread(writerMain);
+  return true;
+}
+
+//#==============================================================================
+//# * checkpointStop
+//#------------------------------------------------------------------------------
+//# Finishes writing whatever was saved last and stops the background thread
+//#==============================================================================
+void checkpointStop()
+{
+  if(writer.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(writerMutex);
+      stopping = true;
+    }
+    writerWake.notify_one();
+    writer.join();
+  }
+  for( int b = 0; b < 3; b++)
+  {
+    free(buffers[b].data);
+    memset(&buffers[b], 0, sizeof(buffers[b]));
+  }
+  free(target);
+  free(temporary);
+  target = temporary = NULL;
+}
+
+//#==============================================================================
+//# * checkpointSetView
+//#------------------------------------------------------------------------------
+//# What the window is showing, saved along with the next checkpoints
+//#==============================================================================
+void checkpointSetView(const tagCheckpointView* current)
+{
+  std::lock_guard<std::mutex> lock(writerMutex);
+  view = *current;
+}
+
+//#==============================================================================
+//# * checkpointSave
+//#------------------------------------------------------------------------------
+//# Copies the state of the run (the bodies, plus the integrator and test
+//# particles physicsStep is using) and hands it to the writer. Must be called
+//# from whichever thread steps the physics, between steps. Never waits for
+//# the disk.
+//#==============================================================================
+void checkpointSave(const tagCheckpointState* state, const tagBodies* bodies)
+{
+  if(!writer.joinable()) return;
+  PROFILE_ZONE("checkpoint copy");
+
+  tagCheckpointView shown;
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    shown = view;
+  }
+
+  tagCheckpointBuffer* out = filling;
+  out->size = 0;
+  putDouble(out, state->dt);
+  putDouble(out, state->time);
+  putLong  (out, state->steps);
+  putInt   (out, state->solver);
+  putDouble(out, state->theta);
+  putInt   (out, state->multipole);
+  putInt   (out, state->integrator);
+  putDouble(out, state->tolerance);
+  putDouble(out, state->eta);
+  putInt   (out, state->precision);
+  putInt   (out, state->collisions);
+
+  putDouble(out, shown.speed);
+  putDouble(out, shown.zoom);
+  putDouble(out, shown.yrot);
+  putInt   (out, shown.camera);
+
+  // what the integrator carries from one step to the next
+  const tagIntegrator* integrator = physicsIntegrator();
+  const tagBlockSteps* block      = &integrator->block;
+  putDouble(out, integrator->h);
+  putInt   (out, integrator->fresh);
+  putLong  (out, integrator->forceEvaluations);
+  putLong  (out, integrator->bodyForces);
+  putLong  (out, integrator->accepted);
+  putLong  (out, integrator->rejected);
+  putInt   (out, block->synced);
+  putDouble(out, block->outer);
+  putInt   (out, block->count);
+  putLong  (out, block->blocks);
+  putLong  (out, block->forces);
+  putInt   (out, block->deepest);
+  if(block->synced)
+  {
+    uint64_t size = sizeof(double) * (uint64_t)block->count;
+    put(out, block->jx, size);
+    put(out, block->jy, size);
+    put(out, block->jz, size);
+    put(out, block->level, sizeof(int) * (uint64_t)block->count);
+  }
+
+  const double* arrays[] = { bodies->x,  bodies->y,  bodies->z,
+                             bodies->vx, bodies->vy, bodies->vz,
+                             bodies->ax, bodies->ay, bodies->az,
+                             bodies->mass, bodies->radius };
+  putInt(out, bodies->count);
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+    put(out, arrays[a], sizeof(double) * (uint64_t)bodies->count);
+
+  const tagParticles* particles = physicsParticles();
+  int particleCount = particles != NULL ? particles->count : 0;
+  putInt(out, particleCount);
+  putInt(out, particleCount > 0 && particles->fresh);
+  if(particleCount > 0)
+  {
+    const double* values[] = { particles->x,  particles->y,  particles->z,
+                               particles->vx, particles->vy, particles->vz,
+                               particles->ax, particles->ay, particles->az };
+    for( unsigned a = 0; a < sizeof(values)/sizeof(values[0]); a++)
+      put(out, values[a], sizeof(double) * (uint64_t)particleCount);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    filling = pending;
+    pending = out;
+    if(ready) dropped++;   // the writer never got to the one before
+    ready = true;
+  }
+  writerWake.notify_one();
+}
+
+//#==============================================================================
+//# * checkpointLoad
+//#------------------------------------------------------------------------------
+//# Reads a checkpoint back: fills in the state and view, creates "bodies" and
+//# "particles" as they were, selects the solver and integrator the run used
+//# and puts back the integrator's state, attaching the particles to the
+//# physics. Returns false (after saying why) if the file can't be used.
+//#==============================================================================
+bool checkpointLoad(const char* path, tagCheckpointState* state,
+                    tagCheckpointView* shown, tagBodies* bodies,
+                    tagParticles* particles)
+{
+  tagMappedFile file;
+  if(!mappedFileOpen(&file, path))
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+  const tagCheckpointHeader* header = (const tagCheckpointHeader*)file.data;
+  if(file.size < sizeof(*header) ||
+     memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0)
+  {
+    fprintf(stderr, "%s is not a checkpoint\n", path);
+    mappedFileClose(&file);
+    return false;
+  }
+  if(header->version != CHECKPOINT_VERSION)
+  {
+    fprintf(stderr, "%s is a version %u checkpoint; this build reads version %d\n",
+            path, header->version, CHECKPOINT_VERSION);
+    mappedFileClose(&file);
+    return false;
+  }
+  const unsigned char* data = file.data + sizeof(*header);
+  if(header->bytes != file.size - sizeof(*header) ||
+     checksum(data, header->bytes) != header->checksum)
+  {
+    fprintf(stderr, "%s is damaged (checksum mismatch)\n", path);
+    mappedFileClose(&file);
+    return false;
+  }
+
+  tagCheckpointReader in = { data, header->bytes, true };
+  state->dt         = getDouble(&in);
+  state->time       = getDouble(&in);
+  state->steps      = getLong  (&in);
+  state->solver     = getInt   (&in);
+  state->theta      = getDouble(&in);
+  state->multipole  = getInt   (&in);
+  state->integrator = getInt   (&in);
+  state->tolerance  = getDouble(&in);
+  state->eta        = getDouble(&in);
+  state->precision  = getInt   (&in);
+  state->collisions = getInt   (&in);
+  shown->speed      = getDouble(&in);
+  shown->zoom       = getDouble(&in);
+  shown->yrot       = getDouble(&in);
+  shown->camera     = getInt   (&in);
+
+  if(state->integrator < 0 || state->integrator >= INTEGRATOR_COUNT ||
+     (state->solver != SOLVER_DIRECT && state->solver != SOLVER_TREE) ||
+     state->precision < 0 || state->precision >= PRECISION_COUNT)
+    in.ok = false;
+  if(in.ok && state->precision != PRECISION_NATIVE &&
+     (state->solver == SOLVER_TREE || state->integrator == INTEGRATOR_BLOCK))
+  {
+    fprintf(stderr, "%s asks for the %s direct sum with a solver or integrator that has "
+                    "its own\n", path, precisionName(state->precision));
+    mappedFileClose(&file);
+    return false;
+  }
+  if(in.ok && state->solver == SOLVER_TREE && state->integrator == INTEGRATOR_BLOCK)
+  {
+    fprintf(stderr, "%s asks for the tree with the block integrator, which always sums "
+                    "directly\n", path);
+    mappedFileClose(&file);
+    return false;
+  }
+  physicsSelectSolver(in.ok ? state->solver : SOLVER_DIRECT, state->theta, state->multipole);
+  physicsSelectPrecision(in.ok ? state->precision : PRECISION_NATIVE);
+  physicsSetCollisions(in.ok && state->collisions != 0);
+  physicsSelectIntegrator(in.ok ? state->integrator : INTEGRATOR_EULER,
+                          state->tolerance, state->eta);
+
+  tagIntegrator* integrator = physicsIntegrator();
+  tagBlockSteps* block      = &integrator->block;
+  integrator->h                = getDouble(&in);
+  integrator->fresh            = getInt(&in) != 0;
+  integrator->forceEvaluations = getLong(&in);
+  integrator->bodyForces       = getLong(&in);
+  integrator->accepted         = getLong(&in);
+  integrator->rejected         = getLong(&in);
+  bool synced                  = getInt(&in) != 0;
+  block->outer                 = getDouble(&in);
+  int blockCount               = getInt(&in);
+  block->blocks                = getLong(&in);
+  block->forces                = getLong(&in);
+  block->deepest               = getInt(&in);
+  if(synced && !(in.ok && blockCount > 0 && (uint64_t)blockCount <= in.left / sizeof(double)))
+    in.ok = false;
+  if(synced && in.ok)
+  {
+    blockStepsReserve(block, blockCount);
+    uint64_t size = sizeof(double) * (uint64_t)blockCount;
+    get(&in, block->jx, size);
+    get(&in, block->jy, size);
+    get(&in, block->jz, size);
+    get(&in, block->level, sizeof(int) * (uint64_t)blockCount);
+    block->count  = blockCount;
+    block->synced = in.ok;
+  }
+
+  int count = getInt(&in);
+  if(count < 0 || (uint64_t)count > in.left / (11 * sizeof(double))) in.ok = false;
+  bodiesCreate(bodies, in.ok ? count : 0);
+  bodies->count = in.ok ? count : 0;
+  double* arrays[] = { bodies->x,  bodies->y,  bodies->z,
+                       bodies->vx, bodies->vy, bodies->vz,
+                       bodies->ax, bodies->ay, bodies->az,
+                       bodies->mass, bodies->radius };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+    get(&in, arrays[a], sizeof(double) * (uint64_t)bodies->count);
+
+  int particleCount = getInt(&in);
+  bool fresh        = getInt(&in) != 0;
+  if(particleCount < 0 || (uint64_t)particleCount > in.left / (9 * sizeof(double)))
+    in.ok = false;
+  particlesCreate(particles, in.ok ? particleCount : 0);
+  particles->count = in.ok ? particleCount : 0;
+  double* values[] = { particles->x,  particles->y,  particles->z,
+                       particles->vx, particles->vy, particles->vz,
+                       particles->ax, particles->ay, particles->az };
+  for( unsigned v = 0; v < sizeof(values)/sizeof(values[0]); v++)
+    get(&in, values[v], sizeof(double) * (uint64_t)particles->count);
+  physicsAttachParticles(particles);
+  particles->fresh = fresh;
+
+  mappedFileClose(&file);
+  if(!in.ok || in.left != 0 || (block->synced && block->count != bodies->count))
+  {
+    fprintf(stderr, "%s is damaged (bad layout)\n", path);
+    physicsAttachParticles(NULL);
+    particlesDestroy(particles);
+    bodiesDestroy(bodies);
+    return false;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * checkpointWritten / checkpointDropped
+//#------------------------------------------------------------------------------
+//# Checkpoints safely on disk, and ones replaced by a newer save before the
+//# writer got to them
+//#==============================================================================
+long checkpointWritten()
+{
+  std::lock_guard<std::mutex> lock(writerMutex);
+  return written;
+}
+
+long checkpointDropped()
+{
+  std::lock_guard<std::mutex> lock(writerMutex);
+  return dropped;
+}
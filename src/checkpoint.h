@@ -0,0 +1,86 @@
+/*
+#================================================================================
+# * Checkpoint              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Periodic saves of everything needed to carry on a run exactly where it left
+# off: every body and test particle, the integrator's carried-over state and
+# the settings the run was started with.
+#
+# Saving only copies the state into memory; a background thread works out
+# the checksum and writes it to "<path>.tmp", flushes it to disk and renames
+# it over "<path>", so a crash part way through leaves the last good
+# checkpoint in place. If a save comes in while the previous one is still
+# being written, the older of the two waiting is dropped.
+#
+# File layout: tagCheckpointHeader, then the state. The checksum (64-bit
+# FNV-1a) covers the state.
+#================================================================================
+*/
+#ifndef SOLAR_CHECKPOINT_H
+#define SOLAR_CHECKPOINT_H
+
+#include "bodies.h"
+#include "particles.h"
+#include <stdint.h>       // Header File for fixed width integers
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define CHECKPOINT_MAGIC   "SOLCKPT"   // first 8 bytes of a file (with the \0)
+#define CHECKPOINT_VERSION 2
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagCheckpointHeader - start of the file
+typedef struct
+{
+  char     magic[8];   // CHECKPOINT_MAGIC
+  uint32_t version;    // CHECKPOINT_VERSION
+  uint32_t reserved;
+  uint64_t bytes;      // size of the state following the header
+  uint64_t checksum;   // FNV-1a of the state
+}tagCheckpointHeader;
+
+// tagCheckpointState - where the run is and how it was set up
+typedef struct
+{
+  double dt;           // step size (s)
+  double time;         // simulated time (s)
+  long   steps;        // steps taken since the start
+  int    solver;       // SOLVER_*
+  double theta;        // Barnes-Hut opening angle
+  int    multipole;    // OCTREE_*
+  int    integrator;   // INTEGRATOR_*
+  double tolerance;    // INTEGRATOR_DOPRI error per sub-step
+  double eta;          // INTEGRATOR_BLOCK step accuracy
+  int    precision;    // PRECISION_* of the direct sum
+  int    collisions;   // 1 if overlapping bodies are merged
+}tagCheckpointState;
+
+// tagCheckpointView - how the window was looking at it (zeros in headless)
+typedef struct
+{
+  double speed;        // speed multiplier
+  double zoom;         // camera distance in body radii
+  double yrot;         // camera angle
+  int    camera;       // body the camera follows
+}tagCheckpointView;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool checkpointStart     ( const char* path );
+void checkpointStop      ( );
+void checkpointSetView   ( const tagCheckpointView* view );
+void checkpointSave      ( const tagCheckpointState* state, const tagBodies* bodies );
+bool checkpointLoad      ( const char* path, tagCheckpointState* state,
+                           tagCheckpointView* view, tagBodies* bodies,
+                           tagParticles* particles );
+long checkpointWritten   ( );
+long checkpointDropped   ( );
+
+#endif // SOLAR_CHECKPOINT_H
@@ -0,0 +1,35 @@
+/*
+#================================================================================
+# * Clock                   Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Monotonic wall clock
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "clock.h"
+#ifdef _WIN32
+# include <windows.h>     // Header File for QueryPerformanceCounter
+#else
+# include <time.h>        // Header File for clock_gettime
+#endif
+
+//#==============================================================================
+//# * clockSeconds
+//#------------------------------------------------------------------------------
+//# Returns seconds from some arbitrary (but fixed) starting point
+//#==============================================================================
+double clockSeconds()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1E-9;
+#endif
+}
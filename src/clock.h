@@ -0,0 +1,17 @@
+/*
+#================================================================================
+# * Clock                   Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Wall clock for timing runs (GLUT_ELAPSED_TIME needs a window)
+#================================================================================
+*/
+#ifndef SOLAR_CLOCK_H
+#define SOLAR_CLOCK_H
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+double clockSeconds ( );
+
+#endif // SOLAR_CLOCK_H
@@ -0,0 +1,249 @@
+/*
+#================================================================================
+# * Collisions              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Spatial hash broad phase, overlap tests and inelastic merging
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "collisions.h"
+#include <math.h>         // Header File for the math library
+#include <stdint.h>       // Header File for fixed width integers
+#include <string.h>       // Header File for memset
+
+//#==============================================================================
+//# * collisionsCreate / collisionsDestroy
+//#------------------------------------------------------------------------------
+//# The tables grow with the first step that needs them
+//#==============================================================================
+void collisionsCreate(tagCollisions* collisions)
+{
+  memset(collisions, 0, sizeof(*collisions));
+}
+
+void collisionsDestroy(tagCollisions* collisions)
+{
+  int** arrays[] = { &collisions->bucketStart, &collisions->cursor, &collisions->bucket,
+                     &collisions->sorted, &collisions->parent, &collisions->remap };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+  {
+    if(*arrays[a] != NULL) alignedFree(*arrays[a]);
+    *arrays[a] = NULL;
+  }
+  collisions->capacity = 0;
+  collisions->buckets  = 0;
+}
+
+//#==============================================================================
+//# * reserve
+//#------------------------------------------------------------------------------
+//# Makes room for "count" bodies
+//#==============================================================================
+static void reserve(tagCollisions* collisions, int count)
+{
+  if(count <= collisions->capacity) return;
+  long tests = collisions->tests, merges = collisions->merges;
+  collisionsDestroy(collisions);
+  collisions->tests  = tests;
+  collisions->merges = merges;
+
+  int buckets = 64;
+  while(buckets < COLLISIONS_LOAD * count) buckets *= 2;
+  unsigned long size = sizeof(int) * (unsigned long)count;
+  collisions->bucketStart = (int*)alignedAlloc(sizeof(int) * ((unsigned long)buckets + 1));
+  collisions->cursor      = (int*)alignedAlloc(sizeof(int) * (unsigned long)buckets);
+  collisions->bucket      = (int*)alignedAlloc(size);
+  collisions->sorted      = (int*)alignedAlloc(size);
+  collisions->parent      = (int*)alignedAlloc(size);
+  collisions->remap       = (int*)alignedAlloc(size);
+  collisions->capacity    = count;
+  collisions->buckets     = buckets;
+}
+
+//#==============================================================================
+//# * hashCell
+//#------------------------------------------------------------------------------
+//# Bucket of a grid cell. Different cells may share a bucket; the overlap
+//# test sorts that out.
+//#==============================================================================
+static inline int hashCell(int64_t cx, int64_t cy, int64_t cz, int buckets)
+{
+  uint64_t h = (uint64_t)cx * 0x9E3779B97F4A7C15ULL;
+  h ^= (uint64_t)cy * 0xC2B2AE3D27D4EB4FULL;
+  h ^= (uint64_t)cz * 0x165667B19E3779F9ULL;
+  h ^= h >> 29;
+  return (int)(h & (uint64_t)(buckets - 1));
+}
+
+//#==============================================================================
+//# * findRoot / join
+//#------------------------------------------------------------------------------
+//# Union-find over overlapping bodies. The root of a group is the body the
+//# rest merge into: the heaviest, or the first of equally heavy ones.
+//#==============================================================================
+static int findRoot(int* parent, int i)
+{
+  int root = i;
+  while(parent[root] != root) root = parent[root];
+  while(parent[i] != root)
+  {
+    int next = parent[i];
+    parent[i] = root;
+    i = next;
+  }
+  return root;
+}
+
+static void join(int* parent, const double* mass, int i, int j)
+{
+  int a = findRoot(parent, i), b = findRoot(parent, j);
+  if(a == b) return;
+  bool aWins = mass[a] > mass[b] || (mass[a] == mass[b] && a < b);
+  if(aWins) parent[b] = a;
+  else      parent[a] = b;
+}
+
+//#==============================================================================
+//# * findOverlaps
+//#------------------------------------------------------------------------------
+//# Broad phase and narrow phase: sorts the bodies into the hashed grid, then
+//# tests each body against those after it in its own and the 26 neighbouring
+//# cells. Returns how many overlapping pairs there were.
+//#==============================================================================
+static int findOverlaps(tagCollisions* collisions, const tagBodies* bodies, double cell)
+{
+  const int count = bodies->count, buckets = collisions->buckets;
+  const double* x = bodies->x;
+  const double* y = bodies->y;
+  const double* z = bodies->z;
+  const double* radius = bodies->radius;
+  const double inv_cell = 1.0 / cell;
+  int* start  = collisions->bucketStart;
+  int* sorted = collisions->sorted;
+
+  memset(start, 0, sizeof(int) * ((unsigned long)buckets + 1));
+  for( int i = 0; i < count; i++)
+  {
+    int h = hashCell((int64_t)floor(x[i] * inv_cell), (int64_t)floor(y[i] * inv_cell),
+                     (int64_t)floor(z[i] * inv_cell), buckets);
+    collisions->bucket[i] = h;
+    start[h + 1]++;
+  }
+  for( int h = 0; h < buckets; h++)
+  {
+    start[h + 1] += start[h];
+    collisions->cursor[h] = start[h];
+  }
+  for( int i = 0; i < count; i++)
+  {
+    sorted[collisions->cursor[collisions->bucket[i]]++] = i;
+  }
+
+  int overlaps = 0;
+  long tests = 0;
+  for( int i = 0; i < count; i++)
+  {
+    const int64_t cx = (int64_t)floor(x[i] * inv_cell);
+    const int64_t cy = (int64_t)floor(y[i] * inv_cell);
+    const int64_t cz = (int64_t)floor(z[i] * inv_cell);
+    int seen[27], seenCount = 0;
+    for( int n = 0; n < 27; n++)
+    {
+      int h = hashCell(cx + n % 3 - 1, cy + n / 3 % 3 - 1, cz + n / 9 - 1, buckets);
+      bool repeat = false;
+      for( int s = 0; s < seenCount && !repeat; s++) repeat = seen[s] == h;
+      if(repeat) continue;     // two cells in one bucket: look once
+      seen[seenCount++] = h;
+
+      for( int k = start[h]; k < start[h + 1]; k++)
+      {
+        int j = sorted[k];
+        if(j <= i) continue;   // each pair once
+        tests++;
+        double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+        double reach = radius[i] + radius[j];
+        if(dx*dx + dy*dy + dz*dz < reach * reach)
+        {
+          join(collisions->parent, bodies->mass, i, j);
+          overlaps++;
+        }
+      }
+    }
+  }
+  collisions->tests += tests;
+  return overlaps;
+}
+
+//#==============================================================================
+//# * collisionsStep
+//#------------------------------------------------------------------------------
+//# Merges every group of overlapping bodies into one and closes up the gaps.
+//# Returns how many bodies were absorbed; if any were, remap[old index] is
+//# where each body (or the body that absorbed it) is now, and the
+//# accelerations are stale.
+//#==============================================================================
+int collisionsStep(tagCollisions* collisions, tagBodies* bodies)
+{
+  const int count = bodies->count;
+  if(count < 2) return 0;
+  double largest = 0;
+  for( int i = 0; i < count; i++)
+  {
+    if(bodies->radius[i] > largest) largest = bodies->radius[i];
+  }
+  if(!(largest > 0)) return 0;   // points never overlap
+
+  reserve(collisions, count);
+  int* parent = collisions->parent;
+  for( int i = 0; i < count; i++) parent[i] = i;
+  collisions->cell = 2 * largest;
+  if(findOverlaps(collisions, bodies, collisions->cell) == 0) return 0;
+
+  // merge each absorbed body into its root: centre of mass, momentum, volume
+  double* x  = bodies->x;   double* y  = bodies->y;   double* z  = bodies->z;
+  double* vx = bodies->vx;  double* vy = bodies->vy;  double* vz = bodies->vz;
+  double* mass = bodies->mass;
+  double* radius = bodies->radius;
+  for( int i = 0; i < count; i++)
+  {
+    int r = findRoot(parent, i);
+    if(r == i) continue;
+    double total = mass[r] + mass[i];
+    if(total > 0)
+    {
+      double wr = mass[r] / total, wi = mass[i] / total;
+      x[r]  = x[r]  * wr + x[i]  * wi;
+      y[r]  = y[r]  * wr + y[i]  * wi;
+      z[r]  = z[r]  * wr + z[i]  * wi;
+      vx[r] = vx[r] * wr + vx[i] * wi;
+      vy[r] = vy[r] * wr + vy[i] * wi;
+      vz[r] = vz[r] * wr + vz[i] * wi;
+    }
+    mass[r]   = total;
+    radius[r] = cbrt(radius[r] * radius[r] * radius[r] + radius[i] * radius[i] * radius[i]);
+  }
+
+  // close up the gaps, survivors first so the absorbed can find them
+  double* arrays[] = { x, y, z, vx, vy, vz, bodies->ax, bodies->ay, bodies->az, mass, radius };
+  int* remap = collisions->remap;
+  int kept = 0;
+  for( int i = 0; i < count; i++)
+  {
+    if(parent[i] != i) continue;
+    if(kept != i)
+    {
+      for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+        arrays[a][kept] = arrays[a][i];
+    }
+    remap[i] = kept++;
+  }
+  for( int i = 0; i < count; i++)
+  {
+    if(parent[i] != i) remap[i] = remap[findRoot(parent, i)];
+  }
+  bodies->count = kept;
+  collisions->merges += count - kept;
+  return count - kept;
+}
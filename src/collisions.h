@@ -0,0 +1,52 @@
+/*
+#================================================================================
+# * Collisions              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Finds bodies that overlap at the end of a step and merges them. A uniform
+# grid with cells twice the largest radius is hashed into a table rebuilt
+# every step by counting sort, so overlapping bodies are always in the same
+# or neighbouring cells and only those are compared. Overlapping groups merge
+# into their heaviest member, conserving mass and momentum (and volume, for
+# the radius), and the bodies are compacted in place, keeping their order.
+#================================================================================
+*/
+#ifndef SOLAR_COLLISIONS_H
+#define SOLAR_COLLISIONS_H
+
+#include "bodies.h"
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define COLLISIONS_LOAD 2     // hash buckets per body (before rounding up to a power of two)
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagCollisions
+typedef struct
+{
+  int     capacity;      // bodies the per body arrays can hold
+  int     buckets;       // size of the hash table (a power of two)
+  double  cell;          // edge of a grid cell on the last step (m)
+  int*    bucketStart;   // first entry of each bucket in "sorted" [buckets + 1]
+  int*    cursor;        // next free entry of each bucket while sorting [buckets]
+  int*    bucket;        // bucket of each body [capacity]
+  int*    sorted;        // bodies ordered by bucket [capacity]
+  int*    parent;        // union-find of overlapping bodies [capacity]
+  int*    remap;         // new index of each old body, or of what absorbed it [capacity]
+  long    tests;         // pairs given the overlap test
+  long    merges;        // bodies absorbed into another
+}tagCollisions;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void collisionsCreate  ( tagCollisions* collisions );
+void collisionsDestroy ( tagCollisions* collisions );
+int  collisionsStep    ( tagCollisions* collisions, tagBodies* bodies );
+
+#endif // SOLAR_COLLISIONS_H
@@ -0,0 +1,478 @@
+/*
+#================================================================================
+# * Ensemble                Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Perturbed copies of the bodies integrated side by side
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "ensemble.h"
+#include "gravity.h"
+#include "thread_pool.h"
+#include <stdio.h>        // Header File for the standard library
+#include <string.h>       // Header File for memset
+#include <math.h>         // Header File for the math library
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define ENSEMBLE_X86 1
+# include <immintrin.h>   // Header File for the AVX intrinsics
+#endif
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+// A pair applies bodies i and j to each other in copies [begin, end)
+typedef void (*EnsemblePair)( tagEnsemble* ensemble, int i, int j, int begin, int end );
+
+// tagEnsembleTask - what a parallel loop over lane blocks needs
+typedef struct
+{
+  tagEnsemble* ensemble;
+  double       dt;
+  bool         measure;   // check the energy at the end of this step
+}tagEnsembleTask;
+
+//#==============================================================================
+//# * pairScalar
+//#------------------------------------------------------------------------------
+//# Plain C++ version of a pair: Gm(x2-x1)/r^3 each way, copy by copy. Also
+//# keeps the closest the copies have seen any two bodies come.
+//#==============================================================================
+static void pairScalar(tagEnsemble* ensemble, int i, int j, int begin, int end)
+{
+  const int si = i * ensemble->stride, sj = j * ensemble->stride;
+  const double* x = ensemble->x;
+  const double* y = ensemble->y;
+  const double* z = ensemble->z;
+  double* ax = ensemble->ax;
+  double* ay = ensemble->ay;
+  double* az = ensemble->az;
+  double* closest2 = ensemble->closest2;
+  const double gmi = gravity_constant * ensemble->mass[i];
+  const double gmj = gravity_constant * ensemble->mass[j];
+
+  for( int k = begin; k < end; k++)
+  {
+    double dx = x[sj + k] - x[si + k];
+    double dy = y[sj + k] - y[si + k];
+    double dz = z[sj + k] - z[si + k];
+    double r2 = dx*dx + dy*dy + dz*dz;
+    if(r2 < closest2[k]) closest2[k] = r2;
+    double inv_r  = 1.0 / sqrt(r2);
+    double inv_r3 = inv_r * inv_r * inv_r;
+    double pj = gmj * inv_r3, pi = gmi * inv_r3;
+    ax[si + k] += dx * pj;   ax[sj + k] -= dx * pi;
+    ay[si + k] += dy * pj;   ay[sj + k] -= dy * pi;
+    az[si + k] += dz * pj;   az[sj + k] -= dz * pi;
+  }
+}
+
+#ifdef ENSEMBLE_X86
+//#==============================================================================
+//# * pairAvx2
+//#------------------------------------------------------------------------------
+//# Four copies at a time. Lane blocks are whole registers, so no leftovers.
+//#==============================================================================
+__attribute__((target("avx2,fma")))
+static void pairAvx2(tagEnsemble* ensemble, int i, int j, int begin, int end)
+{
+  const int si = i * ensemble->stride, sj = j * ensemble->stride;
+  const double* x = ensemble->x;
+  const double* y = ensemble->y;
+  const double* z = ensemble->z;
+  double* ax = ensemble->ax;
+  double* ay = ensemble->ay;
+  double* az = ensemble->az;
+  double* closest2 = ensemble->closest2;
+  const __m256d gmi = _mm256_set1_pd(gravity_constant * ensemble->mass[i]);
+  const __m256d gmj = _mm256_set1_pd(gravity_constant * ensemble->mass[j]);
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  for( int k = begin; k < end; k += 4)
+  {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + sj + k), _mm256_loadu_pd(x + si + k));
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + sj + k), _mm256_loadu_pd(y + si + k));
+    __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + sj + k), _mm256_loadu_pd(z + si + k));
+    __m256d r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+    _mm256_storeu_pd(closest2 + k, _mm256_min_pd(r2, _mm256_loadu_pd(closest2 + k)));
+    __m256d inv_r  = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+    __m256d inv_r3 = _mm256_mul_pd(_mm256_mul_pd(inv_r, inv_r), inv_r);
+    __m256d pj = _mm256_mul_pd(gmj, inv_r3);
+    __m256d pi = _mm256_mul_pd(gmi, inv_r3);
+    _mm256_storeu_pd(ax + si + k, _mm256_fmadd_pd(dx, pj, _mm256_loadu_pd(ax + si + k)));
+    _mm256_storeu_pd(ay + si + k, _mm256_fmadd_pd(dy, pj, _mm256_loadu_pd(ay + si + k)));
+    _mm256_storeu_pd(az + si + k, _mm256_fmadd_pd(dz, pj, _mm256_loadu_pd(az + si + k)));
+    _mm256_storeu_pd(ax + sj + k, _mm256_fnmadd_pd(dx, pi, _mm256_loadu_pd(ax + sj + k)));
+    _mm256_storeu_pd(ay + sj + k, _mm256_fnmadd_pd(dy, pi, _mm256_loadu_pd(ay + sj + k)));
+    _mm256_storeu_pd(az + sj + k, _mm256_fnmadd_pd(dz, pi, _mm256_loadu_pd(az + sj + k)));
+  }
+}
+
+//#==============================================================================
+//# * pairAvx512
+//#------------------------------------------------------------------------------
+//# Eight copies at a time. Unlike the gravity kernel this keeps the exact
+//# square root: copies are compared with each other, so the arithmetic
+//# shouldn't add a scatter of its own.
+//#==============================================================================
+__attribute__((target("avx512f")))
+static void pairAvx512(tagEnsemble* ensemble, int i, int j, int begin, int end)
+{
+  const int si = i * ensemble->stride, sj = j * ensemble->stride;
+  const double* x = ensemble->x;
+  const double* y = ensemble->y;
+  const double* z = ensemble->z;
+  double* ax = ensemble->ax;
+  double* ay = ensemble->ay;
+  double* az = ensemble->az;
+  double* closest2 = ensemble->closest2;
+  const __m512d gmi = _mm512_set1_pd(gravity_constant * ensemble->mass[i]);
+  const __m512d gmj = _mm512_set1_pd(gravity_constant * ensemble->mass[j]);
+  const __m512d one = _mm512_set1_pd(1.0);
+
+  for( int k = begin; k < end; k += 8)
+  {
+    __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + sj + k), _mm512_loadu_pd(x + si + k));
+    __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + sj + k), _mm512_loadu_pd(y + si + k));
+    __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + sj + k), _mm512_loadu_pd(z + si + k));
+    __m512d r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+    _mm512_storeu_pd(closest2 + k, _mm512_min_pd(r2, _mm512_loadu_pd(closest2 + k)));
+    __m512d inv_r  = _mm512_div_pd(one, _mm512_sqrt_pd(r2));
+    __m512d inv_r3 = _mm512_mul_pd(_mm512_mul_pd(inv_r, inv_r), inv_r);
+    __m512d pj = _mm512_mul_pd(gmj, inv_r3);
+    __m512d pi = _mm512_mul_pd(gmi, inv_r3);
+    _mm512_storeu_pd(ax + si + k, _mm512_fmadd_pd(dx, pj, _mm512_loadu_pd(ax + si + k)));
+    _mm512_storeu_pd(ay + si + k, _mm512_fmadd_pd(dy, pj, _mm512_loadu_pd(ay + si + k)));
+    _mm512_storeu_pd(az + si + k, _mm512_fmadd_pd(dz, pj, _mm512_loadu_pd(az + si + k)));
+    _mm512_storeu_pd(ax + sj + k, _mm512_fnmadd_pd(dx, pi, _mm512_loadu_pd(ax + sj + k)));
+    _mm512_storeu_pd(ay + sj + k, _mm512_fnmadd_pd(dy, pi, _mm512_loadu_pd(ay + sj + k)));
+    _mm512_storeu_pd(az + sj + k, _mm512_fnmadd_pd(dz, pi, _mm512_loadu_pd(az + sj + k)));
+  }
+}
+#endif // ENSEMBLE_X86
+
+//#==============================================================================
+//# * forces
+//#------------------------------------------------------------------------------
+//# Accelerations of every body in copies [begin, end), every pair once
+//#==============================================================================
+static void forces(tagEnsemble* ensemble, int begin, int end)
+{
+  EnsemblePair pair = pairScalar;
+#ifdef ENSEMBLE_X86
+  if(ensemble->kernel == GRAVITY_KERNEL_AVX2)   pair = pairAvx2;
+  if(ensemble->kernel == GRAVITY_KERNEL_AVX512) pair = pairAvx512;
+#endif
+  const int count = ensemble->count;
+  for( int b = 0; b < count; b++)
+  {
+    const unsigned long first = (unsigned long)b * ensemble->stride + begin;
+    const unsigned long bytes = sizeof(double) * (end - begin);
+    memset(ensemble->ax + first, 0, bytes);
+    memset(ensemble->ay + first, 0, bytes);
+    memset(ensemble->az + first, 0, bytes);
+  }
+  for( int i = 0; i < count - 1; i++)
+  {
+    for( int j = i + 1; j < count; j++) pair(ensemble, i, j, begin, end);
+  }
+}
+
+//#==============================================================================
+//# * kick / drift
+//#------------------------------------------------------------------------------
+//# v += a h and x += v h for copies [begin, end)
+//#==============================================================================
+static void kick(tagEnsemble* ensemble, int begin, int end, double h)
+{
+  for( int b = 0; b < ensemble->count; b++)
+  {
+    const int s = b * ensemble->stride;
+    for( int k = s + begin; k < s + end; k++)
+    {
+      ensemble->vx[k] += ensemble->ax[k] * h;
+      ensemble->vy[k] += ensemble->ay[k] * h;
+      ensemble->vz[k] += ensemble->az[k] * h;
+    }
+  }
+}
+
+static void drift(tagEnsemble* ensemble, int begin, int end, double h)
+{
+  for( int b = 0; b < ensemble->count; b++)
+  {
+    const int s = b * ensemble->stride;
+    for( int k = s + begin; k < s + end; k++)
+    {
+      ensemble->x[k] += ensemble->vx[k] * h;
+      ensemble->y[k] += ensemble->vy[k] * h;
+      ensemble->z[k] += ensemble->vz[k] * h;
+    }
+  }
+}
+
+//#==============================================================================
+//# * energy
+//#------------------------------------------------------------------------------
+//# Total energy of copies [begin, end) into energy[0 .. end - begin)
+//#==============================================================================
+static void energy(const tagEnsemble* ensemble, int begin, int end, double* energy)
+{
+  const int count = ensemble->count, stride = ensemble->stride;
+  for( int k = begin; k < end; k++) energy[k - begin] = 0;
+  for( int i = 0; i < count; i++)
+  {
+    const double half = 0.5 * ensemble->mass[i];
+    for( int k = begin; k < end; k++)
+    {
+      const int n = i * stride + k;
+      energy[k - begin] += half * (ensemble->vx[n]*ensemble->vx[n] +
+                                   ensemble->vy[n]*ensemble->vy[n] +
+                                   ensemble->vz[n]*ensemble->vz[n]);
+    }
+    for( int j = i + 1; j < count; j++)
+    {
+      const double gmm = gravity_constant * ensemble->mass[i] * ensemble->mass[j];
+      for( int k = begin; k < end; k++)
+      {
+        double dx = ensemble->x[j * stride + k] - ensemble->x[i * stride + k];
+        double dy = ensemble->y[j * stride + k] - ensemble->y[i * stride + k];
+        double dz = ensemble->z[j * stride + k] - ensemble->z[i * stride + k];
+        energy[k - begin] -= gmm / sqrt(dx*dx + dy*dy + dz*dz);
+      }
+    }
+  }
+}
+
+//#==============================================================================
+//# * laneBlock
+//#------------------------------------------------------------------------------
+//# The copies [*begin, *end) making up lane block "block"
+//#==============================================================================
+static void laneBlock(const tagEnsemble* ensemble, int block, int* begin, int* end)
+{
+  *begin = block * ENSEMBLE_LANES;
+  *end   = *begin + ENSEMBLE_LANES < ensemble->stride ? *begin + ENSEMBLE_LANES
+                                                      : ensemble->stride;
+}
+
+//#==============================================================================
+//# * startTask / stepTask
+//#------------------------------------------------------------------------------
+//# Parallel over lane blocks. Start works out the first accelerations and
+//# energies; a step takes the block's copies through every sub-step of dt,
+//# then (every so often) compares their energy with the start.
+//#==============================================================================
+static void startTask(void* context, int first, int last)
+{
+  tagEnsemble* ensemble = ((tagEnsembleTask*)context)->ensemble;
+  for( int block = first; block < last; block++)
+  {
+    int begin, end;
+    laneBlock(ensemble, block, &begin, &end);
+    forces(ensemble, begin, end);
+    energy(ensemble, begin, end, ensemble->energy0 + begin);
+  }
+}
+
+static void stepTask(void* context, int first, int last)
+{
+  tagEnsembleTask* task = (tagEnsembleTask*)context;
+  tagEnsemble* ensemble = task->ensemble;
+  const double dt = task->dt;
+  for( int block = first; block < last; block++)
+  {
+    int begin, end;
+    laneBlock(ensemble, block, &begin, &end);
+    if(ensemble->weightCount == 0)
+    {
+      // semi-implicit Euler, as integratorStep does it
+      forces(ensemble, begin, end);
+      kick(ensemble, begin, end, dt);
+      drift(ensemble, begin, end, dt);
+    }
+    for( int w = 0; w < ensemble->weightCount; w++)
+    {
+      // kick-drift-kick; the closing accelerations open the next sub-step
+      const double h = ensemble->weights[w] * dt;
+      kick(ensemble, begin, end, h * 0.5);
+      drift(ensemble, begin, end, h);
+      forces(ensemble, begin, end);
+      kick(ensemble, begin, end, h * 0.5);
+    }
+
+    if(!task->measure) continue;
+    double now[ENSEMBLE_LANES];
+    energy(ensemble, begin, end, now);
+    for( int k = begin; k < end; k++)
+    {
+      double change = fabs((now[k - begin] - ensemble->energy0[k]) / ensemble->energy0[k]);
+      if(change > ensemble->drift[k]) ensemble->drift[k] = change;
+    }
+  }
+}
+
+//#==============================================================================
+//# * spreadTask
+//#------------------------------------------------------------------------------
+//# Per lane block and body, the sum over its copies of the squared distance
+//# from copy 0. Each block has its own row of sums, so adding the rows up in
+//# order gives the same answer on any number of threads.
+//#==============================================================================
+static void spreadTask(void* context, int first, int last)
+{
+  tagEnsemble* ensemble = ((tagEnsembleTask*)context)->ensemble;
+  const int stride = ensemble->stride;
+  for( int block = first; block < last; block++)
+  {
+    int begin, end;
+    laneBlock(ensemble, block, &begin, &end);
+    if(end > ensemble->copies) end = ensemble->copies;   // not the padding
+    for( int b = 0; b < ensemble->count; b++)
+    {
+      const int s = b * stride;
+      double sum = 0;
+      for( int k = s + begin; k < s + end; k++)
+      {
+        double dx = ensemble->x[k] - ensemble->x[s];
+        double dy = ensemble->y[k] - ensemble->y[s];
+        double dz = ensemble->z[k] - ensemble->z[s];
+        sum += dx*dx + dy*dy + dz*dz;
+      }
+      ensemble->sums[block * ensemble->count + b] = sum;
+    }
+  }
+}
+
+//#==============================================================================
+//# * gaussian
+//#------------------------------------------------------------------------------
+//# Normally distributed numbers (Box-Muller) from a splitmix64 sequence
+//#==============================================================================
+static double uniform(unsigned long long* state)
+{
+  unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return ((z >> 11) + 0.5) * (1.0 / 9007199254740992.0);   // (0, 1)
+}
+
+static double gaussian(unsigned long long* state)
+{
+  double u = uniform(state), v = uniform(state);
+  return sqrt(-2 * log(u)) * cos(6.283185307179586 * v);
+}
+
+//#==============================================================================
+//# * ensembleCreate
+//#------------------------------------------------------------------------------
+//# Sets up "copies" copies of the bodies. Every copy but the first has each
+//# body's position moved by a normally distributed amount with standard
+//# deviation "sigma" (m) along each axis. The integrator must be euler or one
+//# of the leapfrog family; returns false (after saying so) for the others.
+//#==============================================================================
+bool ensembleCreate(tagEnsemble* ensemble, const tagBodies* bodies, int copies,
+                    double sigma, int integrator, unsigned long seed)
+{
+  memset(ensemble, 0, sizeof(*ensemble));
+  ensemble->weightCount = integratorWeights(integrator, ensemble->weights);
+  if(ensemble->weightCount == 0 && integrator != INTEGRATOR_EULER)
+  {
+    fprintf(stderr, "--ensemble: can't use the %s integrator; use euler, leapfrog, "
+                    "yoshida4 or yoshida6\n", integratorName(integrator));
+    return false;
+  }
+  const int count = bodies->count;
+  ensemble->count      = count;
+  ensemble->copies     = copies;
+  ensemble->stride     = (copies + 7) & ~7;
+  ensemble->kernel     = gravityKernel();
+  ensemble->integrator = integrator;
+
+  const unsigned long size = sizeof(double) * (unsigned long)count * ensemble->stride;
+  double** arrays[] = { &ensemble->x,  &ensemble->y,  &ensemble->z,
+                        &ensemble->vx, &ensemble->vy, &ensemble->vz,
+                        &ensemble->ax, &ensemble->ay, &ensemble->az };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+    *arrays[a] = (double*)alignedAlloc(size);
+  const int blocks = (ensemble->stride + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES;
+  ensemble->mass      = (double*)alignedAlloc(sizeof(double) * count);
+  ensemble->energy0   = (double*)alignedAlloc(sizeof(double) * ensemble->stride);
+  ensemble->drift     = (double*)alignedAlloc(sizeof(double) * ensemble->stride);
+  ensemble->closest2  = (double*)alignedAlloc(sizeof(double) * ensemble->stride);
+  ensemble->spread    = (double*)alignedAlloc(sizeof(double) * count);
+  ensemble->spreadMax = (double*)alignedAlloc(sizeof(double) * count);
+  ensemble->sums      = (double*)alignedAlloc(sizeof(double) * count * blocks);
+  memcpy(ensemble->mass, bodies->mass, sizeof(double) * count);
+  memset(ensemble->drift, 0, sizeof(double) * ensemble->stride);
+  memset(ensemble->spread, 0, sizeof(double) * count);
+  memset(ensemble->spreadMax, 0, sizeof(double) * count);
+  for( int k = 0; k < ensemble->stride; k++) ensemble->closest2[k] = HUGE_VAL;
+
+  // padding copies past "copies" repeat copy 0 so they stay well behaved
+  for( int k = 0; k < ensemble->stride; k++)
+  {
+    unsigned long long state = seed + 0x632BE59BD9B4E019ULL * (unsigned long long)k;
+    bool nudge = k > 0 && k < copies;
+    for( int b = 0; b < count; b++)
+    {
+      const int n = b * ensemble->stride + k;
+      ensemble->x[n]  = bodies->x[b] + (nudge ? sigma * gaussian(&state) : 0);
+      ensemble->y[n]  = bodies->y[b] + (nudge ? sigma * gaussian(&state) : 0);
+      ensemble->z[n]  = bodies->z[b] + (nudge ? sigma * gaussian(&state) : 0);
+      ensemble->vx[n] = bodies->vx[b];
+      ensemble->vy[n] = bodies->vy[b];
+      ensemble->vz[n] = bodies->vz[b];
+    }
+  }
+
+  tagEnsembleTask task = { ensemble, 0, false };
+  threadPoolFor(blocks, 1, startTask, &task);
+  return true;
+}
+
+//#==============================================================================
+//# * ensembleDestroy
+//#==============================================================================
+void ensembleDestroy(tagEnsemble* ensemble)
+{
+  double* arrays[] = { ensemble->x,  ensemble->y,  ensemble->z,
+                       ensemble->vx, ensemble->vy, ensemble->vz,
+                       ensemble->ax, ensemble->ay, ensemble->az,
+                       ensemble->mass, ensemble->energy0, ensemble->drift,
+                       ensemble->closest2, ensemble->spread, ensemble->spreadMax,
+                       ensemble->sums };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+    if(arrays[a] != NULL) alignedFree(arrays[a]);
+  memset(ensemble, 0, sizeof(*ensemble));
+}
+
+//#==============================================================================
+//# * ensembleStep
+//#------------------------------------------------------------------------------
+//# Advances every copy by dt seconds and brings the statistics up to date
+//#==============================================================================
+void ensembleStep(tagEnsemble* ensemble, double dt)
+{
+  const int count  = ensemble->count;
+  const int blocks = (ensemble->stride + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES;
+  ensemble->steps++;
+  tagEnsembleTask task = { ensemble, dt, ensemble->steps % ENSEMBLE_ENERGY_EVERY == 0 };
+  threadPoolFor(blocks, 1, stepTask, &task);
+  threadPoolFor(blocks, 1, spreadTask, &task);
+
+  const int evaluations = ensemble->weightCount > 0 ? ensemble->weightCount : 1;
+  ensemble->pairs += (long)evaluations * ensemble->copies * count * (count - 1) / 2;
+  for( int b = 0; b < count; b++)
+  {
+    double sum = 0;
+    for( int block = 0; block < blocks; block++) sum += ensemble->sums[block * count + b];
+    double spread = ensemble->copies > 1 ? sqrt(sum / (ensemble->copies - 1)) : 0;
+    ensemble->spread[b] = spread;
+    if(spread > ensemble->spreadMax[b]) ensemble->spreadMax[b] = spread;
+  }
+}
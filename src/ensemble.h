@@ -0,0 +1,75 @@
+/*
+#================================================================================
+# * Ensemble                Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Many copies of the same bodies, each with its starting positions nudged at
+# random, integrated side by side in one process. Every array holds one value
+# per body per copy with the copy index innermost ([body * stride + copy]), so
+# a pair of bodies is loaded once and the arithmetic runs down the copies in
+# SIMD lanes. Copies are handed to the threads ENSEMBLE_LANES at a time, and
+# each thread takes its copies through the whole step on its own.
+#
+# Copy 0 is left as it was and is the reference the others are measured
+# against. The statistics are brought up to date as the run goes, so nothing
+# but the current state is ever kept.
+#================================================================================
+*/
+#ifndef SOLAR_ENSEMBLE_H
+#define SOLAR_ENSEMBLE_H
+
+#include "bodies.h"
+#include "integrator.h"
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define ENSEMBLE_LANES        64   // copies stepped together by one task
+#define ENSEMBLE_ENERGY_EVERY 16   // steps between energy checks
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagEnsemble
+typedef struct
+{
+  int     count;        // bodies in every copy
+  int     copies;       // copies being integrated, counting the reference
+  int     stride;       // copies rounded up to whole SIMD registers
+  int     kernel;       // GRAVITY_KERNEL_* the force loops were built for
+  int     integrator;   // INTEGRATOR_EULER or one of the leapfrog family
+  int     weightCount;  // leapfrog sub-steps per step
+  double  weights[INTEGRATOR_WEIGHTS];
+  double* x;            // position, [body * stride + copy]
+  double* y;
+  double* z;
+  double* vx;           // velocity
+  double* vy;
+  double* vz;
+  double* ax;           // acceleration at the current positions
+  double* ay;
+  double* az;
+  double* mass;         // [body], the same in every copy
+  long    steps;        // steps taken
+  long    pairs;        // body pairs worked out, summed over the copies
+
+  // statistics
+  double* energy0;      // [copy] total energy at the start
+  double* drift;        // [copy] largest relative change in energy seen
+  double* closest2;     // [copy] smallest squared distance between two bodies seen
+  double* spread;       // [body] RMS distance of the copies from copy 0 now (m)
+  double* spreadMax;    // [body] largest "spread" seen (m)
+  double* sums;         // [block * count + body] scratch for "spread"
+}tagEnsemble;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool ensembleCreate  ( tagEnsemble* ensemble, const tagBodies* bodies, int copies,
+                       double sigma, int integrator, unsigned long seed );
+void ensembleDestroy ( tagEnsemble* ensemble );
+void ensembleStep    ( tagEnsemble* ensemble, double dt );
+
+#endif // SOLAR_ENSEMBLE_H
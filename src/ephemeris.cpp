@@ -0,0 +1,436 @@
+/*
+#================================================================================
+# * Ephemeris               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Building, caching and evaluating piecewise Chebyshev fits of the bodies
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "ephemeris.h"
+#include "physics.h"
+#include "clock.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for malloc/free
+#include <string.h>       // Header File for memcpy/memset
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# * hashBytes
+//#------------------------------------------------------------------------------
+//# 64-bit FNV-1a, continued from "hash"
+//#==============================================================================
+static uint64_t hashBytes(uint64_t hash, const void* data, unsigned long bytes)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for( unsigned long i = 0; i < bytes; i++)
+  {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+//#==============================================================================
+//# * sourceHash
+//#------------------------------------------------------------------------------
+//# Identifies everything the fit depends on: the starting bodies, the step,
+//# the fit's shape and the integrator and solver that will be used (with the
+//# tree's opening angle and multipole order, if it is the tree)
+//#==============================================================================
+static uint64_t sourceHash(const tagBodies* initial, double dt, int intervalSteps, int degree)
+{
+  const tagIntegrator* integrator = physicsIntegrator();
+  uint64_t hash = 14695981039346656037ULL;
+  unsigned long size = sizeof(double) * (unsigned long)initial->count;
+  const double* arrays[] = { initial->x,  initial->y,  initial->z,
+                             initial->vx, initial->vy, initial->vz,
+                             initial->mass, initial->radius };
+  for( unsigned a = 0; a < sizeof(arrays)/sizeof(arrays[0]); a++)
+    hash = hashBytes(hash, arrays[a], size);
+  int    settings[] = { initial->count, intervalSteps, degree, integrator->type, physicsSolver() };
+  double values[]   = { dt, integrator->tolerance, integrator->block.eta };
+  hash = hashBytes(hash, settings, sizeof(settings));
+  hash = hashBytes(hash, values, sizeof(values));
+  const tagOctree* tree = physicsTree();
+  if(physicsSolver() == SOLVER_TREE && tree != NULL)
+  {
+    hash = hashBytes(hash, &tree->theta, sizeof(tree->theta));
+    hash = hashBytes(hash, &tree->multipole, sizeof(tree->multipole));
+  }
+  return hash;
+}
+
+//#==============================================================================
+//# * fitMatrix
+//#------------------------------------------------------------------------------
+//# The least squares fit of a degree "degree" Chebyshev series to samples at
+//# the samples + 1 evenly spaced points of [-1, 1], as a matrix: coefficient
+//# j is the sum over k of fit[j * (samples + 1) + k] * sample k. Also fills in
+//# basis[k * (degree + 1) + j] = T_j at point k, for checking the fit.
+//#==============================================================================
+static void fitMatrix(int samples, int degree, double* fit, double* basis)
+{
+  const int points = samples + 1, terms = degree + 1;
+  for( int k = 0; k < points; k++)
+  {
+    double u = -1 + 2.0 * k / samples;
+    double* row = basis + k * terms;
+    row[0] = 1;
+    if(terms > 1) row[1] = u;
+    for( int j = 2; j < terms; j++) row[j] = 2 * u * row[j - 1] - row[j - 2];
+  }
+
+  // normal equations [AtA | At], solved by Gauss-Jordan with partial pivoting
+  const int width = terms + points;
+  double* system = (double*)malloc(sizeof(double) * terms * width);
+  for( int r = 0; r < terms; r++)
+  {
+    for( int c = 0; c < terms; c++)
+    {
+      double sum = 0;
+      for( int k = 0; k < points; k++) sum += basis[k * terms + r] * basis[k * terms + c];
+      system[r * width + c] = sum;
+    }
+    for( int k = 0; k < points; k++) system[r * width + terms + k] = basis[k * terms + r];
+  }
+  for( int c = 0; c < terms; c++)
+  {
+    int pivot = c;
+    for( int r = c + 1; r < terms; r++)
+      if(fabs(system[r * width + c]) > fabs(system[pivot * width + c])) pivot = r;
+    for( int k = 0; k < width && pivot != c; k++)
+    {
+      double swap = system[c * width + k];
+      system[c * width + k]     = system[pivot * width + k];
+      system[pivot * width + k] = swap;
+    }
+    double scale = 1.0 / system[c * width + c];
+    for( int k = 0; k < width; k++) system[c * width + k] *= scale;
+    for( int r = 0; r < terms; r++)
+    {
+      if(r == c) continue;
+      double factor = system[r * width + c];
+      for( int k = 0; k < width; k++) system[r * width + k] -= factor * system[c * width + k];
+    }
+  }
+  for( int j = 0; j < terms; j++)
+    memcpy(fit + j * points, system + j * width + terms, sizeof(double) * points);
+  free(system);
+}
+
+//#==============================================================================
+//# * buildFile
+//#------------------------------------------------------------------------------
+//# Integrates a copy of "initial" over "intervals" intervals, fitting and
+//# writing each one as soon as it is done. Test particles are left out.
+//#==============================================================================
+static bool buildFile(const char* path, const tagBodies* initial, double dt,
+                      int intervals, int intervalSteps, int degree, uint64_t source)
+{
+  FILE* file = fopen(path, "wb");
+  if(file == NULL) return false;
+
+  const int count = initial->count, points = intervalSteps + 1, terms = degree + 1;
+  tagEphemerisHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, EPHEMERIS_MAGIC, sizeof(EPHEMERIS_MAGIC));
+  header.version   = EPHEMERIS_VERSION;
+  header.bodies    = (uint32_t)count;
+  header.degree    = (uint32_t)degree;
+  header.intervals = (uint32_t)intervals;
+  header.source    = source;
+  header.start     = 0;
+  header.length    = dt * intervalSteps;
+  header.dt        = dt;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+         && fwrite(initial->radius, sizeof(double), count, file) == (size_t)count;
+
+  double* fit     = (double*)alignedAlloc(sizeof(double) * terms * points);
+  double* basis   = (double*)alignedAlloc(sizeof(double) * terms * points);
+  double* samples = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count * points);
+  double* coefficients = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count * terms);
+  double* error   = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count);
+  fitMatrix(intervalSteps, degree, fit, basis);
+
+  tagBodies bodies;
+  bodiesCreate(&bodies, count);
+  bodiesCopy(&bodies, initial);
+  tagParticles* particles = physicsParticles();
+  physicsAttachParticles(NULL);
+  integratorReset(physicsIntegrator());
+
+  const unsigned long size = sizeof(double) * (unsigned long)count;
+  memcpy(samples + 0 * count, bodies.x, size);
+  memcpy(samples + 1 * count, bodies.y, size);
+  memcpy(samples + 2 * count, bodies.z, size);
+  for( int interval = 0; interval < intervals && ok; interval++)
+  {
+    for( int k = 1; k < points && ok; k++)
+    {
+      ok = physicsStep(&bodies, dt);
+      double* sample = samples + 3 * (unsigned long)count * k;
+      memcpy(sample + 0 * count, bodies.x, size);
+      memcpy(sample + 1 * count, bodies.y, size);
+      memcpy(sample + 2 * count, bodies.z, size);
+    }
+
+    if(!ok) break;
+
+    // coefficients[(body * 3 + axis) * terms + j], built a sample at a time
+    // so the inner loop runs along the bodies
+    memset(coefficients, 0, size * 3 * terms);
+    for( int k = 0; k < points; k++)
+    {
+      for( int j = 0; j < terms; j++)
+      {
+        double weight = fit[j * points + k];
+        for( int axis = 0; axis < 3; axis++)
+        {
+          const double* s = samples + (3 * (unsigned long)k + axis) * count;
+          double* c = coefficients + axis * terms + j;
+          for( int b = 0; b < count; b++) c[b * 3 * terms] += weight * s[b];
+        }
+      }
+    }
+
+    // how far the fit strays from the steps it was made from
+    for( int k = 0; k < points; k++)
+    {
+      memset(error, 0, size * 3);
+      for( int axis = 0; axis < 3; axis++)
+      {
+        const double* s = samples + (3 * (unsigned long)k + axis) * count;
+        for( int b = 0; b < count; b++)
+        {
+          const double* c = coefficients + (b * 3 + axis) * terms;
+          double value = 0;
+          for( int j = 0; j < terms; j++) value += c[j] * basis[k * terms + j];
+          error[axis * count + b] = value - s[b];
+        }
+      }
+      for( int b = 0; b < count; b++)
+      {
+        double ex = error[b], ey = error[count + b], ez = error[2 * count + b];
+        double distance = sqrt(ex*ex + ey*ey + ez*ez);
+        if(distance > header.error) header.error = distance;
+      }
+    }
+
+    ok = fwrite(coefficients, sizeof(double), 3 * (unsigned long)count * terms, file)
+         == 3 * (size_t)count * terms;
+    memcpy(samples, samples + 3 * (unsigned long)count * intervalSteps, size * 3);
+  }
+
+  physicsAttachParticles(particles);
+  integratorReset(physicsIntegrator());
+  bodiesDestroy(&bodies);
+  alignedFree(fit);
+  alignedFree(basis);
+  alignedFree(samples);
+  alignedFree(coefficients);
+  alignedFree(error);
+
+  // the largest error is only known now
+  ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = fclose(file) == 0 && ok;
+  return ok;
+}
+
+//#==============================================================================
+//# * openFile
+//#------------------------------------------------------------------------------
+//# Maps an ephemeris, checking that it is whole. Returns false quietly if it
+//# isn't there or isn't usable, as that only means it has to be built.
+//#==============================================================================
+static bool openFile(tagEphemeris* ephemeris, const char* path)
+{
+  memset(ephemeris, 0, sizeof(*ephemeris));
+  if(!mappedFileOpen(&ephemeris->file, path)) return false;
+
+  const tagEphemerisHeader* header = (const tagEphemerisHeader*)ephemeris->file.data;
+  uint64_t size = ephemeris->file.size;
+  if(size < sizeof(*header) || memcmp(header->magic, EPHEMERIS_MAGIC, sizeof(EPHEMERIS_MAGIC)) != 0 ||
+     header->version != EPHEMERIS_VERSION || header->bodies == 0 || header->intervals == 0 ||
+     header->degree > EPHEMERIS_MAX_DEGREE || !(header->length > 0) ||
+     size != sizeof(*header) + sizeof(double) * ((uint64_t)header->bodies +
+             (uint64_t)header->intervals * header->bodies * 3 * (header->degree + 1)))
+  {
+    mappedFileClose(&ephemeris->file);
+    return false;
+  }
+  ephemeris->header       = header;
+  ephemeris->radius       = (const double*)(header + 1);
+  ephemeris->coefficients = ephemeris->radius + header->bodies;
+  ephemeris->end          = header->start + header->length * header->intervals;
+  return true;
+}
+
+//#==============================================================================
+//# * ephemerisLoad
+//#------------------------------------------------------------------------------
+//# Opens the ephemeris at "path" if it was built from "initial" the same way
+//# and covers "span" seconds; otherwise integrates (with the physics as it is
+//# set up now), fits intervals of intervalSteps steps with series of the
+//# given degree, writes it and opens that. Returns false (after saying why)
+//# if it can't be built or written.
+//#==============================================================================
+bool ephemerisLoad(tagEphemeris* ephemeris, const char* path,
+                   const tagBodies* initial, double dt, double span,
+                   int intervalSteps, int degree, tagEphemerisBuild* build)
+{
+  double start = clockSeconds();
+  uint64_t source = sourceHash(initial, dt, intervalSteps, degree);
+  if(openFile(ephemeris, path))
+  {
+    if(ephemeris->header->source == source && ephemeris->end >= span)
+    {
+      build->built   = false;
+      build->seconds = clockSeconds() - start;
+      return true;
+    }
+    ephemerisClose(ephemeris);
+  }
+
+  if(initial->count == 0 || degree < 0 || degree > EPHEMERIS_MAX_DEGREE ||
+     intervalSteps < degree)
+  {
+    fprintf(stderr, "%s: need bodies, and at least as many steps per interval (%d) "
+                    "as the degree (%d, at most %d)\n",
+            path, intervalSteps, degree, EPHEMERIS_MAX_DEGREE);
+    return false;
+  }
+  double length = dt * intervalSteps;
+  int intervals = span > length ? (int)ceil(span / length) : 1;
+
+  // built beside it and renamed, so a half written cache is never opened
+  unsigned long pathLength = (unsigned long)strlen(path);
+  char* temporary = (char*)malloc(pathLength + 5);
+  memcpy(temporary, path, pathLength);
+  memcpy(temporary + pathLength, ".tmp", 5);
+  bool ok = buildFile(temporary, initial, dt, intervals, intervalSteps, degree, source);
+  if(ok)
+  {
+    remove(path);                            // rename won't replace it on Windows
+    ok = rename(temporary, path) == 0;
+  }
+  else
+  {
+    remove(temporary);
+  }
+  free(temporary);
+
+  if(!ok || !openFile(ephemeris, path))
+  {
+    fprintf(stderr, "%s: can't write the ephemeris\n", path);
+    return false;
+  }
+  build->built   = true;
+  build->seconds = clockSeconds() - start;
+  return true;
+}
+
+//#==============================================================================
+//# * ephemerisClose
+//#==============================================================================
+void ephemerisClose(tagEphemeris* ephemeris)
+{
+  mappedFileClose(&ephemeris->file);
+  memset(ephemeris, 0, sizeof(*ephemeris));
+}
+
+//#==============================================================================
+//# * locate
+//#------------------------------------------------------------------------------
+//# The interval holding "time" (clamped to the ephemeris) and where in it,
+//# from -1 to 1. Returns false if the time had to be clamped.
+//#==============================================================================
+static bool locate(const tagEphemeris* ephemeris, double time, long* interval, double* u)
+{
+  const tagEphemerisHeader* header = ephemeris->header;
+  double offset = (time - header->start) / header->length;
+  bool inside = offset >= 0 && offset <= header->intervals;
+  if(!(offset > 0)) offset = 0;
+  if(offset > header->intervals) offset = header->intervals;
+  long k = (long)offset;
+  if(k >= (long)header->intervals) k = header->intervals - 1;
+  *interval = k;
+  *u = 2 * (offset - k) - 1;
+  return inside;
+}
+
+//#==============================================================================
+//# * ephemerisPosition
+//#------------------------------------------------------------------------------
+//# Position (and, if velocity isn't NULL, velocity) of one body at "time".
+//# Times outside the ephemeris give its first or last position and false.
+//#==============================================================================
+bool ephemerisPosition(const tagEphemeris* ephemeris, int body, double time,
+                       double position[3], double velocity[3])
+{
+  long   interval;
+  double u;
+  bool inside = locate(ephemeris, time, &interval, &u);
+  const int terms = ephemeris->header->degree + 1;
+  const double* c = ephemeris->coefficients
+                  + ((unsigned long)interval * ephemeris->header->bodies + body) * 3 * terms;
+
+  double T[EPHEMERIS_MAX_DEGREE + 1], D[EPHEMERIS_MAX_DEGREE + 1];  // T_j(u), T_j'(u)
+  double U0 = 1, U1 = 2 * u;                                        // U_j(u), for T'
+  T[0] = 1;  D[0] = 0;
+  if(terms > 1) { T[1] = u;  D[1] = 1; }
+  for( int j = 2; j < terms; j++)
+  {
+    T[j] = 2 * u * T[j - 1] - T[j - 2];
+    D[j] = j * U1;                                                  // T_j' = j U_{j-1}
+    double U2 = 2 * u * U1 - U0;
+    U0 = U1;
+    U1 = U2;
+  }
+  const double rate = 2 / ephemeris->header->length;                // du/dt
+  for( int axis = 0; axis < 3; axis++, c += terms)
+  {
+    double p = 0, v = 0;
+    for( int j = 0; j < terms; j++)
+    {
+      p += c[j] * T[j];
+      v += c[j] * D[j];
+    }
+    position[axis] = p;
+    if(velocity != NULL) velocity[axis] = v * rate;
+  }
+  return inside;
+}
+
+//#==============================================================================
+//# * ephemerisPositions
+//#------------------------------------------------------------------------------
+//# Positions of every body at "time", clamped to the ephemeris
+//#==============================================================================
+void ephemerisPositions(const tagEphemeris* ephemeris, double time,
+                        double* x, double* y, double* z)
+{
+  long   interval;
+  double u;
+  locate(ephemeris, time, &interval, &u);
+  const int terms = ephemeris->header->degree + 1;
+  const int count = ephemeris->header->bodies;
+  const double* c = ephemeris->coefficients + (unsigned long)interval * count * 3 * terms;
+
+  double T[EPHEMERIS_MAX_DEGREE + 1];
+  T[0] = 1;
+  if(terms > 1) T[1] = u;
+  for( int j = 2; j < terms; j++) T[j] = 2 * u * T[j - 1] - T[j - 2];
+
+  double* outputs[3] = { x, y, z };
+  for( int b = 0; b < count; b++)
+  {
+    for( int axis = 0; axis < 3; axis++, c += terms)
+    {
+      double p = 0;
+      for( int j = 0; j < terms; j++) p += c[j] * T[j];
+      outputs[axis][b] = p;
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/*
+#================================================================================
+# * Ephemeris               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Positions of every body at any time without integrating up to it.
+#
+# The run is integrated once, and each body's x, y and z over every fixed
+# interval are fitted (least squares, through every step in the interval)
+# with a Chebyshev series. Finding a position is then: divide to get the
+# interval, evaluate three short series. The same fit serves every body and
+# interval, so building costs little more than the integration itself.
+#
+# File layout (little endian):
+#   tagEphemerisHeader
+#   radius of every body (double)
+#   coefficients (double), interval by interval, then body, then x y z,
+#   each (degree + 1) long
+#
+# The header records a hash of what was integrated (starting state, step and
+# integrator), so a cache built from something else is rebuilt, not used.
+#================================================================================
+*/
+#ifndef SOLAR_EPHEMERIS_H
+#define SOLAR_EPHEMERIS_H
+
+#include "bodies.h"
+#include "mapped_file.h"
+#include <stdint.h>       // Header File for fixed width integers
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define EPHEMERIS_MAGIC      "SOLEPH"   // first 8 bytes of a file (with \0s)
+#define EPHEMERIS_VERSION    1
+#define EPHEMERIS_MAX_DEGREE 24
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagEphemerisHeader - start of the file
+typedef struct
+{
+  char     magic[8];     // EPHEMERIS_MAGIC
+  uint32_t version;      // EPHEMERIS_VERSION
+  uint32_t bodies;       // bodies covered
+  uint32_t degree;       // of every series
+  uint32_t intervals;    // intervals covered
+  uint64_t source;       // hash of the starting state and how it was stepped
+  double   start;        // simulated time the first interval starts (s)
+  double   length;       // length of every interval (s)
+  double   dt;           // step the fit was made from (s)
+  double   error;        // largest distance of a step from the fit (m)
+}tagEphemerisHeader;
+
+// tagEphemeris
+typedef struct
+{
+  tagMappedFile file;
+  const tagEphemerisHeader* header;
+  const double* radius;        // radius of every body, in the file
+  const double* coefficients;  // in the file
+  double        end;           // simulated time the last interval ends (s)
+}tagEphemeris;
+
+// tagEphemerisBuild - how a cache came to be
+typedef struct
+{
+  bool   built;          // false if an existing file was used
+  double seconds;        // wall time to integrate and fit (or to open)
+}tagEphemerisBuild;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool ephemerisLoad      ( tagEphemeris* ephemeris, const char* path,
+                          const tagBodies* initial, double dt, double span,
+                          int intervalSteps, int degree, tagEphemerisBuild* build );
+void ephemerisClose     ( tagEphemeris* ephemeris );
+bool ephemerisPosition  ( const tagEphemeris* ephemeris, int body, double time,
+                          double position[3], double velocity[3] );
+void ephemerisPositions ( const tagEphemeris* ephemeris, double time,
+                          double* x, double* y, double* z );
+
+#endif // SOLAR_EPHEMERIS_H
@@ -0,0 +1,400 @@
+/*
+#================================================================================
+# * Gravity                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Pairwise gravitational acceleration kernels
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "gravity.h"
+#include "thread_pool.h"
+#include <math.h>         // Header File for the math library
+#include <string.h>       // Header File for strcmp
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define GRAVITY_X86 1
+# include <immintrin.h>   // Header File for the AVX intrinsics
+#endif
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+// A row applies body i against bodies [begin, end) (none of which is i)
+typedef void (*GravityRow)( tagBodies* bodies, int i, int begin, int end );
+
+//#==============================================================================
+//# * rowScalar
+//#------------------------------------------------------------------------------
+//# Plain C++ version of a row. Sum of all accelerations on i = Gm(x2-x1)/r^3,
+//# and the opposite pull is applied to the other body straight away.
+//#==============================================================================
+static void rowScalar(tagBodies* bodies, int i, int begin, int end)
+{
+  const double* x    = bodies->x;
+  const double* y    = bodies->y;
+  const double* z    = bodies->z;
+  const double* mass = bodies->mass;
+  double* ax = bodies->ax;
+  double* ay = bodies->ay;
+  double* az = bodies->az;
+
+  const double xi = x[i], yi = y[i], zi = z[i];
+  const double gmi = gravity_constant * mass[i];
+  double axi = 0, ayi = 0, azi = 0;
+  for( int j = begin; j < end; j++)
+  {
+    double dx = x[j] - xi;
+    double dy = y[j] - yi;
+    double dz = z[j] - zi;
+    double r2 = dx*dx + dy*dy + dz*dz;
+    double inv_r  = 1.0 / sqrt(r2);            // only root for the pair
+    double inv_r3 = inv_r * inv_r * inv_r;
+    double sj = gravity_constant * mass[j] * inv_r3;
+    double si = gmi * inv_r3;
+    axi += dx * sj;   ax[j] -= dx * si;
+    ayi += dy * sj;   ay[j] -= dy * si;
+    azi += dz * sj;   az[j] -= dz * si;
+  }
+  ax[i] += axi;
+  ay[i] += ayi;
+  az[i] += azi;
+}
+
+#ifdef GRAVITY_X86
+//#==============================================================================
+//# * rowAvx2
+//#------------------------------------------------------------------------------
+//# Four pairs at a time. The other bodies are contiguous, so their share of
+//# the pull is a plain load/subtract/store.
+//#==============================================================================
+__attribute__((target("avx2,fma")))
+static void rowAvx2(tagBodies* bodies, int i, int begin, int end)
+{
+  const double* x    = bodies->x;
+  const double* y    = bodies->y;
+  const double* z    = bodies->z;
+  const double* mass = bodies->mass;
+  double* ax = bodies->ax;
+  double* ay = bodies->ay;
+  double* az = bodies->az;
+
+  const __m256d xi  = _mm256_set1_pd(x[i]);
+  const __m256d yi  = _mm256_set1_pd(y[i]);
+  const __m256d zi  = _mm256_set1_pd(z[i]);
+  const __m256d g   = _mm256_set1_pd(gravity_constant);
+  const __m256d gmi = _mm256_set1_pd(gravity_constant * mass[i]);
+  const __m256d one = _mm256_set1_pd(1.0);
+  __m256d axi = _mm256_setzero_pd();
+  __m256d ayi = _mm256_setzero_pd();
+  __m256d azi = _mm256_setzero_pd();
+
+  int j = begin;
+  for( ; j + 4 <= end; j += 4)
+  {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+    __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+    __m256d r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+    __m256d inv_r  = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+    __m256d inv_r3 = _mm256_mul_pd(_mm256_mul_pd(inv_r, inv_r), inv_r);
+    __m256d sj = _mm256_mul_pd(_mm256_mul_pd(g, _mm256_loadu_pd(mass + j)), inv_r3);
+    __m256d si = _mm256_mul_pd(gmi, inv_r3);
+    axi = _mm256_fmadd_pd(dx, sj, axi);
+    ayi = _mm256_fmadd_pd(dy, sj, ayi);
+    azi = _mm256_fmadd_pd(dz, sj, azi);
+    _mm256_storeu_pd(ax + j, _mm256_fnmadd_pd(dx, si, _mm256_loadu_pd(ax + j)));
+    _mm256_storeu_pd(ay + j, _mm256_fnmadd_pd(dy, si, _mm256_loadu_pd(ay + j)));
+    _mm256_storeu_pd(az + j, _mm256_fnmadd_pd(dz, si, _mm256_loadu_pd(az + j)));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, axi);  ax[i] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  _mm256_storeu_pd(lanes, ayi);  ay[i] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  _mm256_storeu_pd(lanes, azi);  az[i] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+  if(j < end) rowScalar(bodies, i, j, end);  // leftovers
+}
+
+//#==============================================================================
+//# * rowAvx512
+//#------------------------------------------------------------------------------
+//# Eight pairs at a time. Uses the 14-bit reciprocal square root estimate with
+//# two Newton-Raphson steps, which is good to about one unit in the last place
+//# and avoids both the square root and the divide.
+//#==============================================================================
+__attribute__((target("avx512f")))
+static void rowAvx512(tagBodies* bodies, int i, int begin, int end)
+{
+  const double* x    = bodies->x;
+  const double* y    = bodies->y;
+  const double* z    = bodies->z;
+  const double* mass = bodies->mass;
+  double* ax = bodies->ax;
+  double* ay = bodies->ay;
+  double* az = bodies->az;
+
+  const __m512d xi    = _mm512_set1_pd(x[i]);
+  const __m512d yi    = _mm512_set1_pd(y[i]);
+  const __m512d zi    = _mm512_set1_pd(z[i]);
+  const __m512d g     = _mm512_set1_pd(gravity_constant);
+  const __m512d gmi   = _mm512_set1_pd(gravity_constant * mass[i]);
+  const __m512d half  = _mm512_set1_pd(0.5);
+  const __m512d three = _mm512_set1_pd(1.5);
+  __m512d axi = _mm512_setzero_pd();
+  __m512d ayi = _mm512_setzero_pd();
+  __m512d azi = _mm512_setzero_pd();
+
+  int j = begin;
+  for( ; j + 8 <= end; j += 8)
+  {
+    __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+    __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+    __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), zi);
+    __m512d r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+    // y' = y * (1.5 - 0.5 * r2 * y * y), twice
+    __m512d hr2   = _mm512_mul_pd(half, r2);
+    __m512d inv_r = _mm512_rsqrt14_pd(r2);
+    inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(hr2, _mm512_mul_pd(inv_r, inv_r), three));
+    inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(hr2, _mm512_mul_pd(inv_r, inv_r), three));
+    __m512d inv_r3 = _mm512_mul_pd(_mm512_mul_pd(inv_r, inv_r), inv_r);
+    __m512d sj = _mm512_mul_pd(_mm512_mul_pd(g, _mm512_loadu_pd(mass + j)), inv_r3);
+    __m512d si = _mm512_mul_pd(gmi, inv_r3);
+    axi = _mm512_fmadd_pd(dx, sj, axi);
+    ayi = _mm512_fmadd_pd(dy, sj, ayi);
+    azi = _mm512_fmadd_pd(dz, sj, azi);
+    _mm512_storeu_pd(ax + j, _mm512_fnmadd_pd(dx, si, _mm512_loadu_pd(ax + j)));
+    _mm512_storeu_pd(ay + j, _mm512_fnmadd_pd(dy, si, _mm512_loadu_pd(ay + j)));
+    _mm512_storeu_pd(az + j, _mm512_fnmadd_pd(dz, si, _mm512_loadu_pd(az + j)));
+  }
+  ax[i] += _mm512_reduce_add_pd(axi);
+  ay[i] += _mm512_reduce_add_pd(ayi);
+  az[i] += _mm512_reduce_add_pd(azi);
+
+  if(j < end) rowScalar(bodies, i, j, end);  // leftovers
+}
+#endif // GRAVITY_X86
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static int        activeKernel = GRAVITY_KERNEL_SCALAR;
+static GravityRow activeRow    = rowScalar;
+static bool       autoSelected = false;  // has AUTO been resolved yet?
+
+//#==============================================================================
+//# * kernelSupported
+//#------------------------------------------------------------------------------
+//# Asks the processor whether it can run a kernel
+//#==============================================================================
+static bool kernelSupported(int kernel)
+{
+  switch(kernel)
+  {
+    case GRAVITY_KERNEL_SCALAR: return true;
+#ifdef GRAVITY_X86
+    case GRAVITY_KERNEL_AVX2:
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case GRAVITY_KERNEL_AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+  }
+  return false;
+}
+
+//#==============================================================================
+//# * gravitySelectKernel
+//#------------------------------------------------------------------------------
+//# Chooses the kernel used from now on. AUTO picks the widest one available.
+//# Returns false (leaving the kernel alone) if the processor can't run it.
+//#==============================================================================
+bool gravitySelectKernel(int kernel)
+{
+  if(kernel == GRAVITY_KERNEL_AUTO)
+  {
+    autoSelected = true;
+    if(gravitySelectKernel(GRAVITY_KERNEL_AVX512)) return true;
+    if(gravitySelectKernel(GRAVITY_KERNEL_AVX2))   return true;
+    return gravitySelectKernel(GRAVITY_KERNEL_SCALAR);
+  }
+  if(!kernelSupported(kernel)) return false;
+
+  autoSelected = true;
+  activeKernel = kernel;
+  switch(kernel)
+  {
+#ifdef GRAVITY_X86
+    case GRAVITY_KERNEL_AVX2:   activeRow = rowAvx2;   break;
+    case GRAVITY_KERNEL_AVX512: activeRow = rowAvx512; break;
+#endif
+    default:                    activeRow = rowScalar; break;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * gravityKernel
+//#------------------------------------------------------------------------------
+//# The kernel in use (resolving AUTO the first time it is asked)
+//#==============================================================================
+int gravityKernel()
+{
+  if(!autoSelected) gravitySelectKernel(GRAVITY_KERNEL_AUTO);
+  return activeKernel;
+}
+
+//#==============================================================================
+//# * gravityKernelName / gravityParseKernel
+//#------------------------------------------------------------------------------
+//# Converts between kernels and the names used on the command line. Parsing
+//# returns -1 for a name it doesn't know.
+//#==============================================================================
+const char* gravityKernelName(int kernel)
+{
+  switch(kernel)
+  {
+    case GRAVITY_KERNEL_AUTO:   return "auto";
+    case GRAVITY_KERNEL_SCALAR: return "scalar";
+    case GRAVITY_KERNEL_AVX2:   return "avx2";
+    case GRAVITY_KERNEL_AVX512: return "avx512";
+  }
+  return "unknown";
+}
+
+int gravityParseKernel(const char* name)
+{
+  for( int kernel = GRAVITY_KERNEL_AUTO; kernel <= GRAVITY_KERNEL_AVX512; kernel++)
+  {
+    if(strcmp(name, gravityKernelName(kernel)) == 0) return kernel;
+  }
+  return -1;
+}
+
+//#==============================================================================
+//# * gravityClear
+//#------------------------------------------------------------------------------
+//# Zeroes the accelerations of bodies [begin, end)
+//#==============================================================================
+void gravityClear(tagBodies* bodies, int begin, int end)
+{
+  for( int i = begin; i < end; i++) bodies->ax[i] = 0;
+  for( int i = begin; i < end; i++) bodies->ay[i] = 0;
+  for( int i = begin; i < end; i++) bodies->az[i] = 0;
+}
+
+//#==============================================================================
+//# * gravityDiagonal
+//#------------------------------------------------------------------------------
+//# Accumulates every pair inside [begin, end)
+//#==============================================================================
+void gravityDiagonal(tagBodies* bodies, int begin, int end)
+{
+  if(!autoSelected) gravitySelectKernel(GRAVITY_KERNEL_AUTO);
+  for( int i = begin; i < end - 1; i++)
+  {
+    activeRow(bodies, i, i + 1, end);
+  }
+}
+
+//#==============================================================================
+//# * gravityTile
+//#------------------------------------------------------------------------------
+//# Accumulates every pair with one body in [i_begin, i_end) and the other in
+//# [j_begin, j_end). The two ranges must not overlap.
+//#==============================================================================
+void gravityTile(tagBodies* bodies, int i_begin, int i_end,
+                                    int j_begin, int j_end)
+{
+  if(!autoSelected) gravitySelectKernel(GRAVITY_KERNEL_AUTO);
+  for( int i = i_begin; i < i_end; i++)
+  {
+    activeRow(bodies, i, j_begin, j_end);
+  }
+}
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagTileRound - one round of the tile schedule
+typedef struct
+{
+  tagBodies* bodies;
+  int        block;   // bodies per block
+  int        blocks;  // number of blocks
+  int        slots;   // blocks rounded up to an even number
+  int        round;   // -1 for the diagonal tiles, otherwise 0 .. slots-2
+}tagTileRound;
+
+//#==============================================================================
+//# * clearTask / roundTask
+//#------------------------------------------------------------------------------
+//# Thread pool tasks. In round r of the "circle" schedule, pair k matches
+//# block r with the odd one out (k = 0) or block r+k with block r-k (mod
+//# slots-1); no block appears twice in a round.
+//#==============================================================================
+static void clearTask(void* context, int begin, int end)
+{
+  gravityClear((tagBodies*)context, begin, end);
+}
+
+static void roundTask(void* context, int begin, int end)
+{
+  const tagTileRound* round = (const tagTileRound*)context;
+  const int count = round->bodies->count;
+  for( int k = begin; k < end; k++)
+  {
+    int a = k, b = k;
+    if(round->round >= 0)
+    {
+      const int n = round->slots - 1;
+      a = k == 0 ? round->round : (round->round + k) % n;
+      b = k == 0 ? n            : (round->round - k + n) % n;
+      if(a > b) { int swap = a; a = b; b = swap; }
+      if(b >= round->blocks) continue;   // paired with the padding block
+    }
+    int a_begin = a * round->block, a_end = a_begin + round->block;
+    int b_begin = b * round->block, b_end = b_begin + round->block;
+    if(a_end > count) a_end = count;
+    if(b_end > count) b_end = count;
+    if(a == b)
+      gravityDiagonal(round->bodies, a_begin, a_end);
+    else
+      gravityTile(round->bodies, a_begin, a_end, b_begin, b_end);
+  }
+}
+
+//#==============================================================================
+//# * gravityAccelerations
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of every body from every other body. The bodies are split
+//# into blocks and the pairs into tiles (block against block) so both sides
+//# of a tile stay in cache. Tiles are run in rounds in which no block appears
+//# twice, so a round's tiles can run on any number of threads without sharing
+//# writes. The block size depends only on the number of bodies, and every
+//# block takes its tiles in the same order however many threads there are,
+//# so the result is identical for any thread count.
+//#==============================================================================
+void gravityAccelerations(tagBodies* bodies)
+{
+  const int count = bodies->count;
+  threadPoolFor(count, 4096, clearTask, bodies);
+
+  tagTileRound round;
+  round.bodies = bodies;
+  round.block  = (count + GRAVITY_BLOCKS - 1) / GRAVITY_BLOCKS;
+  round.block  = (round.block + 7) & ~7;                  // whole cache lines
+  if(round.block < GRAVITY_MIN_BLOCK) round.block = GRAVITY_MIN_BLOCK;
+  if(round.block > GRAVITY_BLOCK)     round.block = GRAVITY_BLOCK;
+  round.blocks = (count + round.block - 1) / round.block;
+  round.slots  = round.blocks + (round.blocks & 1);
+
+  round.round = -1;                                       // diagonal tiles
+  threadPoolFor(round.blocks, 1, roundTask, &round);
+  for( round.round = 0; round.round < round.slots - 1; round.round++)
+  {
+    threadPoolFor(round.slots / 2, 1, roundTask, &round);
+  }
+}
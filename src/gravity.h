@@ -0,0 +1,58 @@
+/*
+#================================================================================
+# * Gravity                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Pairwise gravitational acceleration kernels. Every unordered pair is visited
+# once and the result is applied to both bodies (Newton's third law). There is
+# a scalar kernel that works everywhere plus AVX2 and AVX-512 kernels that are
+# picked at runtime when the processor supports them.
+#================================================================================
+*/
+#ifndef SOLAR_GRAVITY_H
+#define SOLAR_GRAVITY_H
+
+#include "bodies.h"
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define GRAVITY_BLOCK     512  // most bodies along one side of a tile
+#define GRAVITY_MIN_BLOCK 64   // fewest bodies along one side of a tile
+#define GRAVITY_BLOCKS    64   // blocks wanted (so there are tiles to share)
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of kernels
+enum
+{
+  GRAVITY_KERNEL_AUTO = 0,  // best one the processor supports
+  GRAVITY_KERNEL_SCALAR,
+  GRAVITY_KERNEL_AVX2,
+  GRAVITY_KERNEL_AVX512
+};
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// constants:
+const double gravity_constant = 6.67E-11;  // Kepler's gravity constant
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool        gravitySelectKernel ( int kernel );
+int         gravityKernel       ( );
+const char* gravityKernelName   ( int kernel );
+int         gravityParseKernel  ( const char* name );
+
+void gravityClear         ( tagBodies* bodies, int begin, int end );
+void gravityDiagonal      ( tagBodies* bodies, int begin, int end );
+void gravityTile          ( tagBodies* bodies, int i_begin, int i_end,
+                                               int j_begin, int j_end );
+void gravityAccelerations ( tagBodies* bodies );
+
+#endif // SOLAR_GRAVITY_H
@@ -0,0 +1,563 @@
+/*
+#================================================================================
+# * Headless                Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Batch runner: integrates as fast as the CPU allows with no window at all
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "headless.h"
+#include "physics.h"
+#include "gravity.h"
+#include "solar_system.h"
+#include "octree.h"
+#include "thread_pool.h"
+#include "clock.h"
+#include "trajectory.h"
+#include "checkpoint.h"
+#include "catalog.h"
+#include "ephemeris.h"
+#include "ensemble.h"
+#include "profiler.h"
+#include "precision.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for qsort
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# * compareDoubles
+//#------------------------------------------------------------------------------
+//# qsort comparison for sorting errors
+//#==============================================================================
+static int compareDoubles(const void* a, const void* b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+//#==============================================================================
+//# * runAccuracyReport
+//#------------------------------------------------------------------------------
+//# Works out the accelerations of the initial state once by direct summation
+//# and then with the tree for a range of opening angles and both multipole
+//# orders, printing how far the tree is off and how long each took. Bodies
+//# with no acceleration at all have no relative error, so they are left out.
+//#==============================================================================
+static int runAccuracyReport(const tagOptions* options, tagBodies* bodies)
+{
+  const int count = bodies->count;
+  if(count < 2)
+  {
+    fprintf(stderr, "--accuracy-report: needs at least two massive bodies, not %d\n", count);
+    return 1;
+  }
+  double* exact  = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count);
+  double* errors = (double*)alignedAlloc(sizeof(double) * (unsigned long)count);
+
+  double start = clockSeconds();
+  gravityAccelerations(bodies);
+  double direct = clockSeconds() - start;
+  for( int i = 0; i < count; i++)
+  {
+    exact[3*i + 0] = bodies->ax[i];
+    exact[3*i + 1] = bodies->ay[i];
+    exact[3*i + 2] = bodies->az[i];
+  }
+
+  printf("Bodies          : \t%d\n", count);
+  printf("Threads         : \t%d\n", threadPoolSize());
+  printf("Direct sum (s)  : \t%.4f (%s kernel)\n", direct,
+         gravityKernelName(gravityKernel()));
+  printf("\n%-10s  %-6s  %10s  %10s  %10s  %10s  %9s  %9s  %7s\n",
+         "multipole", "theta", "mean err", "median", "99th pct", "max",
+         "build (s)", "walk (s)", "speedup");
+
+  double thetas[] = { 0.3, 0.5, 0.7, 1.0, options->theta };
+  int thetaCount = sizeof(thetas)/sizeof(thetas[0]);
+  for( int t = 0; t < thetaCount - 1; t++)
+  {
+    if(thetas[t] == options->theta) thetaCount--;   // already in the list
+  }
+
+  for( int multipole = OCTREE_MONOPOLE; multipole <= OCTREE_QUADRUPOLE; multipole++)
+  {
+    for( int t = 0; t < thetaCount; t++)
+    {
+      tagOctree tree;
+      octreeCreate(&tree, thetas[t], multipole);
+      double built = clockSeconds();
+      octreeBuild(&tree, bodies);
+      double walked = clockSeconds();
+      octreeAccelerations(&tree, bodies, 0, tree.leafCount);  // one thread
+      double done = clockSeconds();
+      octreeDestroy(&tree);
+
+      double sum = 0;
+      int measured = 0;
+      for( int i = 0; i < count; i++)
+      {
+        double ex = exact[3*i], ey = exact[3*i + 1], ez = exact[3*i + 2];
+        double magnitude = sqrt(ex*ex + ey*ey + ez*ez);
+        if(!(magnitude > 0)) continue;
+        double dx = bodies->ax[i] - ex, dy = bodies->ay[i] - ey, dz = bodies->az[i] - ez;
+        errors[measured] = sqrt(dx*dx + dy*dy + dz*dz) / magnitude;
+        sum += errors[measured++];
+      }
+      if(measured == 0)
+      {
+        fprintf(stderr, "--accuracy-report: no body is accelerated at all\n");
+        alignedFree(exact);
+        alignedFree(errors);
+        return 1;
+      }
+      qsort(errors, measured, sizeof(double), compareDoubles);
+
+      double total = done - built;
+      printf("%-10s  %-6.2f  %10.3e  %10.3e  %10.3e  %10.3e  %9.4f  %9.4f  %6.1fx\n",
+             octreeMultipoleName(multipole), thetas[t], sum / measured,
+             errors[measured / 2], errors[(int)(measured * 0.99)], errors[measured - 1],
+             walked - built, done - walked, total > 0 ? direct / total : 0.0);
+    }
+  }
+
+  alignedFree(exact);
+  alignedFree(errors);
+  return 0;
+}
+
+//#==============================================================================
+//# * runReplayReport
+//#------------------------------------------------------------------------------
+//# Describes a recording and times decoding every frame of it, which is all
+//# the window does per frame when it plays one back
+//#==============================================================================
+static int runReplayReport(const tagOptions* options)
+{
+  tagTrajectoryReader reader;
+  if(!trajectoryOpen(&reader, options->replay)) return 1;
+
+  const tagTrajectoryHeader* header = reader.header;
+  const int count = (int)header->bodies;
+  double* x = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count);
+  double* y = x + count;
+  double* z = y + count;
+
+  double start = clockSeconds();
+  for( long frame = 0; frame < (long)reader.frameCount; frame++)
+  {
+    trajectoryReadFrame(&reader, frame, x, y, z, NULL, NULL, NULL);
+  }
+  double elapsed = clockSeconds() - start;
+
+  double span = trajectoryFrameTime(&reader, (long)reader.frameCount - 1) - header->startTime;
+  printf("Recording       : \t%s\n",    options->replay);
+  printf("Bodies          : \t%d\n",    count);
+  printf("Format          : \t%s\n",    trajectoryFormatName(header->format));
+  printf("Frames          : \t%llu in %u chunks%s\n", (unsigned long long)reader.frameCount,
+         reader.chunkCount, header->indexOffset ? "" : " (no index, rebuilt)");
+  printf("Frame interval  : \t%g s (every %u steps)\n", header->interval, header->decimation);
+  printf("Time span (y)   : \t%3.3f\n",  span/(60*60*24)/365.25);
+  printf("File size (MB)  : \t%.3f\n",   reader.file.size / 1048576.0);
+  if(elapsed > 0)
+    printf("Frames/second   : \t%.0f\n", reader.frameCount / elapsed);
+
+  alignedFree(x);
+  trajectoryCloseReader(&reader);
+  return 0;
+}
+
+//#==============================================================================
+//# * runEphemerisReport
+//#------------------------------------------------------------------------------
+//# Builds (or reuses) the ephemeris of --steps steps, describes it and times
+//# looking positions up in it. With --at, prints where everything is then.
+//#==============================================================================
+static int runEphemerisReport(const tagOptions* options, const tagBodies* bodies)
+{
+  tagEphemeris ephemeris;
+  tagEphemerisBuild build;
+  double span = options->steps * options->dt;
+  if(!ephemerisLoad(&ephemeris, options->ephemeris, bodies, options->dt, span,
+                    optionsEphemerisSteps(options),
+                    options->ephemerisDegree, &build))
+    return 1;
+
+  const tagEphemerisHeader* header = ephemeris.header;
+  const int count = (int)header->bodies;
+  const int queries = 1000000;
+  double* x = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count);
+  double* y = x + count;
+  double* z = y + count;
+
+  // single bodies at scattered times, so every lookup lands somewhere new
+  unsigned long long seed = 2011;
+  double check = 0, position[3], velocity[3];
+  double start = clockSeconds();
+  for( int q = 0; q < queries; q++)
+  {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    double time = (seed >> 11) * (1.0 / 9007199254740992.0) * ephemeris.end;
+    ephemerisPosition(&ephemeris, (int)((seed >> 32) % count), time, position, velocity);
+    check += position[0];
+  }
+  double single = clockSeconds() - start;
+
+  const int frames = queries / count > 1000 ? queries / count : 1000;
+  start = clockSeconds();
+  for( int f = 0; f < frames; f++)
+  {
+    ephemerisPositions(&ephemeris, ephemeris.end * f / frames, x, y, z);
+    check += x[0];
+  }
+  double all = clockSeconds() - start;
+
+  printf("Ephemeris       : \t%s (%s)\n", options->ephemeris,
+         build.built ? "built" : "reused");
+  printf("%s: \t%.3f\n", build.built ? "Build time (s)  " : "Open time (s)   ", build.seconds);
+  printf("Bodies          : \t%d\n",     count);
+  printf("Intervals       : \t%u of %g days, degree %u\n", header->intervals,
+         header->length / 86400, header->degree);
+  printf("Time span (y)   : \t%3.3f\n",  ephemeris.end/(60*60*24)/365.25);
+  printf("File size (MB)  : \t%.3f\n",   ephemeris.file.size / 1048576.0);
+  printf("Max fit error   : \t%.3e km\n", header->error / 1000);
+  printf("Position lookup : \t%.1f ns (with velocity)\n", single * 1e9 / queries);
+  printf("All positions   : \t%.1f ns per body\n", all * 1e9 / frames / count);
+  if(check != check) printf("\n");   // keeps the lookups from being optimized away
+
+  if(options->at >= 0)
+  {
+    double time = options->at * 86400;
+    if(time > ephemeris.end)
+      printf("\nDay %g is past the end of the ephemeris; showing its end\n", options->at);
+    printf("\n%6s  %14s  %14s  %14s  %11s  %11s  %11s\n", "body",
+           "x (AU)", "y (AU)", "z (AU)", "vx (km/s)", "vy (km/s)", "vz (km/s)");
+    const double au = 1.495978707E11;
+    for( int b = 0; b < count; b++)
+    {
+      ephemerisPosition(&ephemeris, b, time, position, velocity);
+      printf("%6d  %14.9f  %14.9f  %14.9f  %11.6f  %11.6f  %11.6f\n", b,
+             position[0] / au, position[1] / au, position[2] / au,
+             velocity[0] / 1000, velocity[1] / 1000, velocity[2] / 1000);
+    }
+  }
+
+  alignedFree(x);
+  ephemerisClose(&ephemeris);
+  return 0;
+}
+
+//#==============================================================================
+//# * printSpread
+//#------------------------------------------------------------------------------
+//# One line of the smallest, median and largest of "values" (sorted in place)
+//#==============================================================================
+static void printSpread(const char* label, double* values, int count, double scale,
+                        const char* format, const char* unit)
+{
+  qsort(values, count, sizeof(double), compareDoubles);
+  char line[128];
+  snprintf(line, sizeof(line), "%s: \t%s / %s / %s%s\n", label, format, format, format, unit);
+  printf(line, values[0] * scale, values[count / 2] * scale, values[count - 1] * scale);
+}
+
+//#==============================================================================
+//# * runEnsembleReport
+//#------------------------------------------------------------------------------
+//# Integrates --ensemble copies of the bodies for --steps steps, then reports
+//# how fast that went and what the statistics gathered on the way came to
+//#==============================================================================
+static int runEnsembleReport(const tagOptions* options, const tagBodies* bodies)
+{
+  tagEnsemble ensemble;
+  if(!ensembleCreate(&ensemble, bodies, options->ensemble, options->ensembleSigma,
+                     options->integrator, 2013))
+    return 1;
+
+  double start = clockSeconds();
+  for( long s = 0; s < options->steps; s++)
+  {
+    ensembleStep(&ensemble, options->dt);
+  }
+  double elapsed = clockSeconds() - start;
+
+  const int copies = ensemble.copies;
+  double years = options->steps * options->dt/(60*60*24)/365.25;
+  double* values = (double*)alignedAlloc(sizeof(double) * copies);
+  printf("Ensemble        : \t%d copies of %d bodies, scattered by %g m\n", copies,
+         ensemble.count, options->ensembleSigma);
+  printf("Solver          : \tdirect (%s kernel)\n", gravityKernelName(ensemble.kernel));
+  printf("Integrator      : \t%s\n",     integratorName(ensemble.integrator));
+  printf("Threads         : \t%d\n",     threadPoolSize());
+  printf("Steps           : \t%ld\n",    ensemble.steps);
+  printf("Step size (s)   : \t%g\n",     options->dt);
+  printf("Time Elapsed (y): \t%3.3f\n",  years);
+  printf("Wall time (s)   : \t%6.3f\n",  elapsed);
+  if(elapsed > 0)
+  {
+    printf("Copy steps/sec  : \t%.0f\n", (double)ensemble.steps * copies / elapsed);
+    if(ensemble.pairs > 0)
+      printf("Time per pair   : \t%.2f ns\n", elapsed * 1e9 / ensemble.pairs);
+  }
+  printf("                  \tbest / median / worst copy\n");
+  if(ensemble.steps >= ENSEMBLE_ENERGY_EVERY)
+  {
+    for( int k = 0; k < copies; k++) values[k] = ensemble.drift[k];
+    printSpread("Energy drift    ", values, copies, 1, "%.3e", "");
+  }
+  for( int k = 0; k < copies; k++) values[k] = sqrt(ensemble.closest2[k]);
+  printSpread("Closest pair    ", values, copies, 1e-3, "%.0f", " km");
+
+  printf("\n%6s  %16s  %16s\n", "body", "spread now (km)", "largest (km)");
+  for( int b = 0; b < ensemble.count && b < 16; b++)
+    printf("%6d  %16.3f  %16.3f\n", b, ensemble.spread[b] / 1000, ensemble.spreadMax[b] / 1000);
+  if(ensemble.count > 16)
+    printf("%6s\n", "...");
+
+  alignedFree(values);
+  ensembleDestroy(&ensemble);
+  return 0;
+}
+
+//#==============================================================================
+//# * printZones
+//#------------------------------------------------------------------------------
+//# Finishes the --trace file and prints how long each timing zone took
+//#==============================================================================
+static void printZones(const tagOptions* options)
+{
+  if(options->trace == NULL) return;
+  profilerStop();
+
+  tagProfilerStats stats[PROFILER_ZONES];
+  int count = profilerStats(stats, PROFILER_ZONES);
+  printf("Trace           : \t%s\n", options->trace);
+  for( int z = 0; z < count; z++)
+    printf("  %-16s: \t%ld, p50 %.4f ms, p99 %.4f ms\n", stats[z].name,
+           stats[z].totalCount, stats[z].totalP50 * 1000, stats[z].totalP99 * 1000);
+  if(profilerDropped() > 0)
+    printf("  dropped         : \t%ld events (the trace fell behind)\n", profilerDropped());
+}
+
+//#==============================================================================
+//# * runHeadless
+//#------------------------------------------------------------------------------
+//# Runs options->steps steps of options->dt seconds, then reports how fast it
+//# went. Nothing is printed while stepping so the run is bound by the math.
+//# With --resume the run carries on from the checkpoint up to the same total.
+//#==============================================================================
+int runHeadless(const tagOptions* options)
+{
+  if(options->replay != NULL) return runReplayReport(options);
+  if(options->trace != NULL)
+  {
+    if(!profilerStart(options->trace))
+    {
+      fprintf(stderr, "--trace: can't write '%s'\n", options->trace);
+      return 1;
+    }
+    profilerSetHistograms(true);   // for the table at the end
+    profilerNameThread("main");
+  }
+
+  tagBodies bodies;
+  tagParticles particles;
+  tagCheckpointState state;
+  tagCatalogStats catalogs[OPTIONS_CATALOGS];
+  if(options->resume)
+  {
+    tagCheckpointView view;
+    if(!checkpointLoad(options->checkpoint, &state, &view, &bodies, &particles)) return 1;
+  }
+  else
+  {
+    bodiesCreate(&bodies, SOLAR_SYSTEM_BODIES + options->belt);
+    particlesCreate(&particles, options->particles);
+    if(options->catalogCount == 0) solarSystemInit(&bodies);
+    for( int c = 0; c < options->catalogCount; c++)
+    {
+      if(!catalogLoad(options->catalogs[c], options->massiveAbove, &bodies, &particles,
+                      &catalogs[c]))
+      {
+        particlesDestroy(&particles);
+        bodiesDestroy(&bodies);
+        return 1;
+      }
+    }
+    solarSystemAddBelt(&bodies, options->belt, 2011);
+    solarSystemAddParticles(&particles, options->particles, 2012);
+    physicsAttachParticles(&particles);
+    if(options->saveCatalog != NULL && !catalogSave(options->saveCatalog, &bodies, &particles))
+      fprintf(stderr, "--save-catalog: can't write '%s'\n", options->saveCatalog);
+
+    state.dt         = options->dt;
+    state.time       = 0;
+    state.steps      = 0;
+    state.solver     = options->solver;
+    state.theta      = options->theta;
+    state.multipole  = options->multipole;
+    state.integrator = options->integrator;
+    state.tolerance  = options->tolerance;
+    state.eta        = options->eta;
+    state.precision  = options->precision;
+    state.collisions = options->collisions ? 1 : 0;
+  }
+  const long first = state.steps;
+
+  if(options->accuracy || options->ephemeris != NULL || options->ensemble > 0)
+  {
+    int result = options->accuracy          ? runAccuracyReport(options, &bodies)
+               : options->ephemeris != NULL ? runEphemerisReport(options, &bodies)
+               :                              runEnsembleReport(options, &bodies);
+    printZones(options);
+    physicsAttachParticles(NULL);
+    particlesDestroy(&particles);
+    bodiesDestroy(&bodies);
+    return result;
+  }
+
+  // the energy check is O(N^2) and serial, so leave it out for big belts
+  bool energy = bodies.count <= 20000;
+  double energy0 = energy ? physicsEnergy(&bodies) : 0;
+
+  tagTrajectoryWriter recorder;
+  if(options->record != NULL)
+  {
+    if(!trajectoryCreate(&recorder, options->record, options->recordFormat,
+                         options->recordEvery, state.dt, state.time, &bodies))
+    {
+      fprintf(stderr, "can't write %s\n", options->record);
+      physicsAttachParticles(NULL);
+      particlesDestroy(&particles);
+      bodiesDestroy(&bodies);
+      return 1;
+    }
+    physicsAttachRecorder(&recorder);
+  }
+  tagPublisher publisher;
+  if(options->share != NULL)
+  {
+    if(!publisherCreate(&publisher, options->share, bodies.capacity, state.dt,
+                        state.time, state.steps))
+    {
+      fprintf(stderr, "--share: can't create shared memory '%s'\n", options->share);
+      if(options->record != NULL) trajectoryClose(&recorder);
+      physicsAttachRecorder(NULL);
+      physicsAttachParticles(NULL);
+      particlesDestroy(&particles);
+      bodiesDestroy(&bodies);
+      return 1;
+    }
+    physicsAttachPublisher(&publisher);
+  }
+  if(options->checkpoint != NULL && !checkpointStart(options->checkpoint))
+  {
+    fprintf(stderr, "--checkpoint: can't write next to '%s'\n", options->checkpoint);
+    if(options->record != NULL) trajectoryClose(&recorder);
+    if(options->share != NULL) publisherClose(&publisher);
+    physicsAttachRecorder(NULL);
+    physicsAttachPublisher(NULL);
+    physicsAttachParticles(NULL);
+    particlesDestroy(&particles);
+    bodiesDestroy(&bodies);
+    return 1;
+  }
+
+  double start = clockSeconds();
+  bool stepped = true;
+  while(state.steps < options->steps)
+  {
+    if(!physicsStep(&bodies, state.dt))
+    {
+      fprintf(stderr, "stopped after %ld steps\n", state.steps);
+      stepped = false;
+      break;
+    }
+    state.time += state.dt;
+    state.steps++;
+    if(options->checkpoint != NULL && state.steps % options->checkpointEvery == 0)
+      checkpointSave(&state, &bodies);   // copied here, written in the background
+  }
+  double elapsed = clockSeconds() - start;
+
+  long checkpoints = 0;
+  if(options->checkpoint != NULL)
+  {
+    // a failed step leaves the bodies part way through it: keep the last good one
+    if(stepped && state.steps % options->checkpointEvery != 0) checkpointSave(&state, &bodies);
+    checkpointStop();
+    checkpoints = checkpointWritten();
+  }
+
+  bool recorded = true;
+  if(options->record != NULL)
+  {
+    physicsAttachRecorder(NULL);
+    recorded = trajectoryClose(&recorder);
+    if(!recorded) fprintf(stderr, "error writing %s\n", options->record);
+  }
+  long shared = 0;
+  if(options->share != NULL)
+  {
+    physicsAttachPublisher(NULL);
+    shared = (long)publisher.header->published;
+    publisherClose(&publisher);
+  }
+
+  long   ran   = state.steps - first;
+  double years = state.time/(60*60*24)/365.25;
+  const tagIntegrator* integrator = physicsIntegrator();
+  for( int c = 0; c < options->catalogCount && !options->resume; c++)
+    printf("Catalog         : \t%s, %ld rows (%s, %.1f MB) in %.3f s\n", options->catalogs[c],
+           catalogs[c].rows, catalogs[c].packed ? "packed" : "CSV",
+           catalogs[c].bytes / 1048576.0, catalogs[c].seconds);
+  printf("Bodies          : \t%d\n",     bodies.count);
+  if(particles.count > 0)
+    printf("Test particles  : \t%d\n",   particles.count);
+  if(physicsSolver() == SOLVER_TREE)
+    printf("Solver          : \ttree\n");
+  else if(physicsPrecision() != PRECISION_NATIVE)
+    printf("Solver          : \tdirect (%s%s)\n", precisionName(physicsPrecision()),
+           precisionFixed(bodies.count) ? ", fixed count" : "");
+  else
+    printf("Solver          : \tdirect (%s kernel)\n", gravityKernelName(gravityKernel()));
+  printf("Integrator      : \t%s\n",     integratorName(integrator->type));
+  printf("Threads         : \t%d\n",     threadPoolSize());
+  printf("Steps           : \t%ld\n",    ran);
+  if(first > 0)
+    printf("Resumed from    : \tstep %ld\n", first);
+  printf("Step size (s)   : \t%g\n",     state.dt);
+  printf("Time Elapsed (y): \t%3.3f\n",  years);
+  printf("Wall time (s)   : \t%6.3f\n",  elapsed);
+  if(elapsed > 0)
+    printf("Steps/second    : \t%.0f\n", ran / elapsed);
+  printf("Force evals     : \t%ld\n",    integrator->forceEvaluations);
+  if(years > 0 && bodies.count > 0)   // in whole system evaluations
+    printf("Evals/year      : \t%.1f\n",  integrator->bodyForces / (double)bodies.count / years);
+  if(integrator->type == INTEGRATOR_DOPRI)
+    printf("Sub-steps       : \t%ld accepted, %ld rejected\n",
+           integrator->accepted, integrator->rejected);
+  if(integrator->type == INTEGRATOR_BLOCK)
+    printf("Sub-steps       : \t%ld, deepest step dt/2^%d\n",
+           integrator->block.blocks, integrator->block.deepest);
+  if(energy && energy0 != 0)
+    printf("Energy drift    : \t%.3e\n",  fabs((physicsEnergy(&bodies) - energy0) / energy0));
+
+  if(options->record != NULL && recorded)
+    printf("Recorded        : \t%s (%s, every %d steps)\n", options->record,
+           trajectoryFormatName(options->recordFormat), options->recordEvery);
+  if(options->checkpoint != NULL)
+    printf("Checkpoints     : \t%ld written to %s\n", checkpoints, options->checkpoint);
+  if(options->share != NULL)
+    printf("Shared          : \t%ld steps published to %s\n", shared, options->share);
+  if(physicsCollisions() != NULL)
+    printf("Collisions      : \t%ld bodies merged, %ld pairs tested\n",
+           physicsCollisions()->merges, physicsCollisions()->tests);
+  printZones(options);
+
+  physicsAttachParticles(NULL);
+  particlesDestroy(&particles);
+  bodiesDestroy(&bodies);
+  return recorded && stepped ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+/*
+#================================================================================
+# * Headless                Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Batch runner: integrates as fast as the CPU allows with no window at all
+#================================================================================
+*/
+#ifndef SOLAR_HEADLESS_H
+#define SOLAR_HEADLESS_H
+
+#include "options.h"
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+int runHeadless ( const tagOptions* options );
+
+#endif // SOLAR_HEADLESS_H
@@ -0,0 +1,570 @@
+/*
+#================================================================================
+# * Integrator              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Euler, leapfrog, Yoshida and Dormand-Prince integrators
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "integrator.h"
+#include "physics.h"
+#include "thread_pool.h"
+#include <stdio.h>        // Header File for the standard library
+#include <math.h>         // Header File for the math library
+#include <string.h>       // Header File for strcmp/memset
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define INTEGRATOR_GRAIN 4096   // bodies per parallel chunk (fixed, so that
+                                // reductions don't depend on thread count)
+#define DOPRI_ARRAYS     (6 + 6 * DOPRI_STAGES)
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// constants:
+
+// Dormand-Prince 5(4) tableau
+static const double dopriA[DOPRI_STAGES][DOPRI_STAGES] =
+{
+  { 0 },
+  { 1.0/5 },
+  { 3.0/40,        9.0/40 },
+  { 44.0/45,      -56.0/15,       32.0/9 },
+  { 19372.0/6561, -25360.0/2187,  64448.0/6561, -212.0/729 },
+  { 9017.0/3168,  -355.0/33,      46732.0/5247,  49.0/176,  -5103.0/18656 },
+  { 35.0/384,      0,             500.0/1113,    125.0/192, -2187.0/6784,  11.0/84 }
+};
+// difference between the fifth and fourth order weights
+static const double dopriE[DOPRI_STAGES] =
+{
+  71.0/57600, 0, -71.0/16695, 71.0/1920, -17253.0/339200, 22.0/525, -1.0/40
+};
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagIntegratorTask - what the parallel loops need to know
+typedef struct
+{
+  tagIntegrator* integrator;
+  tagBodies*     bodies;
+  double         h;          // step (or kick/drift) length
+  int            stage;      // dopri stage being set up
+  double*        partial;    // dopri: one result per chunk
+  double         rFloor;     // dopri: smallest position scale
+  double         vFloor;     // dopri: smallest velocity scale
+}tagIntegratorTask;
+
+//#==============================================================================
+//# * scratchArray
+//#------------------------------------------------------------------------------
+//# Dormand-Prince scratch layout: arrays 0-5 are the start state (x, y, z,
+//# vx, vy, vz), then for every stage the derivative of each of those six
+//#==============================================================================
+static inline double* scratchArray(tagIntegrator* integrator, int array)
+{
+  return integrator->scratch + (unsigned long)array * integrator->stride;
+}
+
+static inline double* stageArray(tagIntegrator* integrator, int stage, int component)
+{
+  return scratchArray(integrator, 6 + stage * 6 + component);
+}
+
+//#==============================================================================
+//# * evaluate
+//#------------------------------------------------------------------------------
+//# Works out the accelerations of the current positions
+//#==============================================================================
+static void evaluate(tagIntegrator* integrator, tagBodies* bodies)
+{
+  physicsAccelerations(bodies);
+  integrator->forceEvaluations++;
+  integrator->bodyForces += bodies->count;
+  integrator->fresh = true;
+}
+
+//#==============================================================================
+//# * kickTask / driftTask
+//#------------------------------------------------------------------------------
+//# v += a h and x += v h over a range of bodies
+//#==============================================================================
+static void kickTask(void* context, int begin, int end)
+{
+  tagBodies* bodies = ((tagIntegratorTask*)context)->bodies;
+  const double h    = ((tagIntegratorTask*)context)->h;
+  for( int i = begin; i < end; i++) bodies->vx[i] += bodies->ax[i] * h;
+  for( int i = begin; i < end; i++) bodies->vy[i] += bodies->ay[i] * h;
+  for( int i = begin; i < end; i++) bodies->vz[i] += bodies->az[i] * h;
+}
+
+static void driftTask(void* context, int begin, int end)
+{
+  tagBodies* bodies = ((tagIntegratorTask*)context)->bodies;
+  const double h    = ((tagIntegratorTask*)context)->h;
+  for( int i = begin; i < end; i++) bodies->x[i] += bodies->vx[i] * h;
+  for( int i = begin; i < end; i++) bodies->y[i] += bodies->vy[i] * h;
+  for( int i = begin; i < end; i++) bodies->z[i] += bodies->vz[i] * h;
+}
+
+static void kick(tagBodies* bodies, double h)
+{
+  tagIntegratorTask task = { NULL, bodies, h, 0, NULL, 0, 0 };
+  threadPoolFor(bodies->count, INTEGRATOR_GRAIN, kickTask, &task);
+}
+
+static void drift(tagBodies* bodies, double h)
+{
+  tagIntegratorTask task = { NULL, bodies, h, 0, NULL, 0, 0 };
+  threadPoolFor(bodies->count, INTEGRATOR_GRAIN, driftTask, &task);
+}
+
+//#==============================================================================
+//# * leapfrog
+//#------------------------------------------------------------------------------
+//# Kick-drift-kick. The accelerations at the end of one step are those at the
+//# start of the next, so each step costs one evaluation.
+//#==============================================================================
+static void leapfrog(tagIntegrator* integrator, tagBodies* bodies, double h)
+{
+  if(!integrator->fresh) evaluate(integrator, bodies);
+  kick(bodies, h * 0.5);
+  drift(bodies, h);
+  evaluate(integrator, bodies);
+  kick(bodies, h * 0.5);
+}
+
+//#==============================================================================
+//# * dopriStageTask
+//#------------------------------------------------------------------------------
+//# Sets the bodies to the state of a stage: start + h * sum(a * k). The stage's
+//# position derivative is that state's velocity.
+//#==============================================================================
+static void dopriStageTask(void* context, int begin, int end)
+{
+  tagIntegratorTask* task   = (tagIntegratorTask*)context;
+  tagIntegrator* integrator = task->integrator;
+  tagBodies* bodies         = task->bodies;
+  const int s               = task->stage;
+  double* state[6] = { bodies->x,  bodies->y,  bodies->z,
+                       bodies->vx, bodies->vy, bodies->vz };
+
+  for( int c = 0; c < 6; c++)
+  {
+    const double* start = scratchArray(integrator, c);
+    double* out = state[c];
+    for( int i = begin; i < end; i++) out[i] = start[i];
+    for( int j = 0; j < s; j++)
+    {
+      const double a = dopriA[s][j] * task->h;
+      if(a == 0) continue;
+      const double* k = stageArray(integrator, j, c);
+      for( int i = begin; i < end; i++) out[i] += a * k[i];
+    }
+  }
+  // dx/dt of this stage is its velocity
+  memcpy(stageArray(integrator, s, 0) + begin, bodies->vx + begin, sizeof(double) * (end - begin));
+  memcpy(stageArray(integrator, s, 1) + begin, bodies->vy + begin, sizeof(double) * (end - begin));
+  memcpy(stageArray(integrator, s, 2) + begin, bodies->vz + begin, sizeof(double) * (end - begin));
+}
+
+//#==============================================================================
+//# * dopriSaveTask / dopriAccelerationTask / dopriRestoreTask
+//#------------------------------------------------------------------------------
+//# Copying between the bodies and the scratch arrays
+//#==============================================================================
+static void dopriSaveTask(void* context, int begin, int end)
+{
+  tagIntegratorTask* task   = (tagIntegratorTask*)context;
+  tagIntegrator* integrator = task->integrator;
+  tagBodies* bodies         = task->bodies;
+  const double* state[6] = { bodies->x,  bodies->y,  bodies->z,
+                             bodies->vx, bodies->vy, bodies->vz };
+  unsigned long size = sizeof(double) * (end - begin);
+  for( int c = 0; c < 6; c++)
+  {
+    memcpy(scratchArray(integrator, c) + begin, state[c] + begin, size);
+  }
+  // stage 1: the derivative of the start state
+  for( int c = 0; c < 3; c++)
+  {
+    memcpy(stageArray(integrator, 0, c) + begin, state[3 + c] + begin, size);
+  }
+  memcpy(stageArray(integrator, 0, 3) + begin, bodies->ax + begin, size);
+  memcpy(stageArray(integrator, 0, 4) + begin, bodies->ay + begin, size);
+  memcpy(stageArray(integrator, 0, 5) + begin, bodies->az + begin, size);
+}
+
+static void dopriAccelerationTask(void* context, int begin, int end)
+{
+  tagIntegratorTask* task   = (tagIntegratorTask*)context;
+  tagIntegrator* integrator = task->integrator;
+  tagBodies* bodies         = task->bodies;
+  unsigned long size = sizeof(double) * (end - begin);
+  memcpy(stageArray(integrator, task->stage, 3) + begin, bodies->ax + begin, size);
+  memcpy(stageArray(integrator, task->stage, 4) + begin, bodies->ay + begin, size);
+  memcpy(stageArray(integrator, task->stage, 5) + begin, bodies->az + begin, size);
+}
+
+static void dopriRestoreTask(void* context, int begin, int end)
+{
+  tagIntegratorTask* task   = (tagIntegratorTask*)context;
+  tagIntegrator* integrator = task->integrator;
+  tagBodies* bodies         = task->bodies;
+  double* state[6] = { bodies->x,  bodies->y,  bodies->z,
+                       bodies->vx, bodies->vy, bodies->vz };
+  unsigned long size = sizeof(double) * (end - begin);
+  for( int c = 0; c < 6; c++)
+  {
+    memcpy(state[c] + begin, scratchArray(integrator, c) + begin, size);
+  }
+  memcpy(bodies->ax + begin, stageArray(integrator, 0, 3) + begin, size);
+  memcpy(bodies->ay + begin, stageArray(integrator, 0, 4) + begin, size);
+  memcpy(bodies->az + begin, stageArray(integrator, 0, 5) + begin, size);
+}
+
+//#==============================================================================
+//# * dopriScaleTask / dopriErrorTask
+//#------------------------------------------------------------------------------
+//# Per-chunk maxima: the largest distance and speed (for the error scale
+//# floors), then the largest scaled error. These run over chunk numbers
+//# rather than bodies so every chunk always gets its own result, however the
+//# pool splits the work. Maxima don't depend on the order they are combined
+//# in, so neither does the step size.
+//#==============================================================================
+static void chunkRange(const tagIntegratorTask* task, int chunk, int* begin, int* end)
+{
+  *begin = chunk * INTEGRATOR_GRAIN;
+  *end   = *begin + INTEGRATOR_GRAIN < task->bodies->count ?
+           *begin + INTEGRATOR_GRAIN : task->bodies->count;
+}
+
+static void dopriScaleChunk(tagIntegratorTask* task, int chunk)
+{
+  tagIntegrator* integrator = task->integrator;
+  int begin, end;
+  chunkRange(task, chunk, &begin, &end);
+  const double* x  = scratchArray(integrator, 0);
+  const double* y  = scratchArray(integrator, 1);
+  const double* z  = scratchArray(integrator, 2);
+  const double* vx = scratchArray(integrator, 3);
+  const double* vy = scratchArray(integrator, 4);
+  const double* vz = scratchArray(integrator, 5);
+  double r2 = 0, v2 = 0;
+  for( int i = begin; i < end; i++)
+  {
+    double ri = x[i]*x[i] + y[i]*y[i] + z[i]*z[i];
+    double vi = vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i];
+    r2 = ri > r2 ? ri : r2;
+    v2 = vi > v2 ? vi : v2;
+  }
+  task->partial[2*chunk]     = r2;
+  task->partial[2*chunk + 1] = v2;
+}
+
+static void dopriErrorChunk(tagIntegratorTask* task, int chunk)
+{
+  tagIntegrator* integrator = task->integrator;
+  const double h   = task->h;
+  const double tol = integrator->tolerance;
+  int begin, end;
+  chunkRange(task, chunk, &begin, &end);
+  double worst = 0;
+  for( int i = begin; i < end; i++)
+  {
+    double e[6], start[6];
+    for( int c = 0; c < 6; c++)
+    {
+      e[c] = 0;
+      for( int j = 0; j < DOPRI_STAGES; j++)
+      {
+        e[c] += dopriE[j] * stageArray(integrator, j, c)[i];
+      }
+      e[c] *= h;
+      start[c] = scratchArray(integrator, c)[i];
+    }
+    double r = sqrt(start[0]*start[0] + start[1]*start[1] + start[2]*start[2]);
+    double v = sqrt(start[3]*start[3] + start[4]*start[4] + start[5]*start[5]);
+    double er = sqrt(e[0]*e[0] + e[1]*e[1] + e[2]*e[2]) / (tol * (r > task->rFloor ? r : task->rFloor));
+    double ev = sqrt(e[3]*e[3] + e[4]*e[4] + e[5]*e[5]) / (tol * (v > task->vFloor ? v : task->vFloor));
+    worst = er > worst ? er : worst;
+    worst = ev > worst ? ev : worst;
+  }
+  task->partial[chunk] = worst;
+}
+
+static void dopriScaleTask(void* context, int first, int last)
+{
+  for( int chunk = first; chunk < last; chunk++)
+  {
+    dopriScaleChunk((tagIntegratorTask*)context, chunk);
+  }
+}
+
+static void dopriErrorTask(void* context, int first, int last)
+{
+  for( int chunk = first; chunk < last; chunk++)
+  {
+    dopriErrorChunk((tagIntegratorTask*)context, chunk);
+  }
+}
+
+//#==============================================================================
+//# * dopriAttempt
+//#------------------------------------------------------------------------------
+//# Tries one Dormand-Prince sub-step of length h. Returns the error relative
+//# to the tolerance (accepted when at most 1, NaN if the sub-step blew up);
+//# on rejection the bodies are put back the way they were.
+//#==============================================================================
+static double dopriAttempt(tagIntegrator* integrator, tagBodies* bodies, double h)
+{
+  const int count  = bodies->count;
+  const int chunks = (count + INTEGRATOR_GRAIN - 1) / INTEGRATOR_GRAIN;
+  double partial[2 * 256], *partials = partial;
+  if(chunks > 256) partials = (double*)alignedAlloc(sizeof(double) * 2 * chunks);
+
+  tagIntegratorTask task = { integrator, bodies, h, 0, partials, 0, 0 };
+  if(!integrator->fresh) evaluate(integrator, bodies);
+  threadPoolFor(count, INTEGRATOR_GRAIN, dopriSaveTask, &task);
+
+  for( int s = 1; s < DOPRI_STAGES; s++)
+  {
+    task.stage = s;
+    threadPoolFor(count, INTEGRATOR_GRAIN, dopriStageTask, &task);
+    evaluate(integrator, bodies);
+    threadPoolFor(count, INTEGRATOR_GRAIN, dopriAccelerationTask, &task);
+  }
+  // the last stage is the new state, and its accelerations are already in
+  // ax/ay/az ready for the next sub-step (first same as last)
+
+  threadPoolFor(chunks, 1, dopriScaleTask, &task);
+  double r2 = 0, v2 = 0;
+  for( int c = 0; c < chunks; c++)
+  {
+    r2 = partials[2*c]     > r2 ? partials[2*c]     : r2;
+    v2 = partials[2*c + 1] > v2 ? partials[2*c + 1] : v2;
+  }
+  task.rFloor = 1E-3 * sqrt(r2) + 1E-300;   // nothing at the origin can
+  task.vFloor = 1E-3 * sqrt(v2) + 1E-300;   // demand an infinitely small error
+  threadPoolFor(chunks, 1, dopriErrorTask, &task);
+  double error = 0;
+  for( int c = 0; c < chunks; c++)
+  {
+    error = partials[c] <= error ? error : partials[c];   // keeps a NaN
+  }
+
+  if(!(error <= 1))
+  {
+    threadPoolFor(count, INTEGRATOR_GRAIN, dopriRestoreTask, &task);
+    integrator->fresh = true;
+  }
+  if(partials != partial) alignedFree(partials);
+  return error;
+}
+
+//#==============================================================================
+//# * dopri
+//#------------------------------------------------------------------------------
+//# Covers exactly dt with as many sub-steps as the error control wants. The
+//# sub-step size carries over from call to call. Returns false, with the
+//# bodies part way through dt, if the sub-steps had to shrink below
+//# DOPRI_MIN_STEP of dt (bodies passing through each other, say).
+//#==============================================================================
+static bool dopri(tagIntegrator* integrator, tagBodies* bodies, double dt)
+{
+  if(bodies->capacity + 8 > integrator->stride)
+  {
+    if(integrator->scratch != NULL) alignedFree(integrator->scratch);
+    integrator->stride  = (bodies->capacity + 8) & ~7;   // keep arrays aligned
+    integrator->scratch = (double*)alignedAlloc(sizeof(double) *
+                            (unsigned long)integrator->stride * DOPRI_ARRAYS);
+  }
+  if(integrator->h <= 0) integrator->h = dt;
+
+  double remaining = dt;
+  while(remaining > 0)
+  {
+    bool last = integrator->h >= remaining;
+    double h  = last ? remaining : integrator->h;
+    double error  = dopriAttempt(integrator, bodies, h);
+    double factor = error == 0 ? 5 : 0.9 * pow(error, -0.2);
+    if(factor > 5) factor = 5;
+    if(!(factor >= 0.2)) factor = 0.2;   // a non-finite error too
+
+    if(error <= 1)
+    {
+      integrator->accepted++;
+      remaining = last ? 0 : remaining - h;
+      // a sub-step cut short to land on dt says nothing about the size
+      // that would have worked, so only ever grow from it
+      double next = h * factor;
+      if(!last || next > integrator->h) integrator->h = next;
+    }
+    else
+    {
+      integrator->rejected++;
+      integrator->h = h * factor;
+      if(integrator->h < dt * DOPRI_MIN_STEP)
+      {
+        fprintf(stderr, "dopri: sub-steps fell below %g s with %g s of the step left\n",
+                integrator->h, remaining);
+        integrator->h = 0;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * yoshida
+//#------------------------------------------------------------------------------
+//# Leapfrog steps with the given weights, which sum to one
+//#==============================================================================
+static void yoshida(tagIntegrator* integrator, tagBodies* bodies, double dt,
+                    const double* weights, int count)
+{
+  for( int w = 0; w < count; w++)
+  {
+    leapfrog(integrator, bodies, weights[w] * dt);
+  }
+}
+
+//#==============================================================================
+//# * integratorCreate / integratorDestroy / integratorReset
+//#------------------------------------------------------------------------------
+//# Reset must be called whenever the bodies are changed by anything other
+//# than integratorStep, since the saved accelerations no longer apply.
+//#==============================================================================
+void integratorCreate(tagIntegrator* integrator, int type, double tolerance, double eta)
+{
+  memset(integrator, 0, sizeof(*integrator));
+  integrator->type      = type;
+  integrator->tolerance = tolerance;
+  blockStepsCreate(&integrator->block, eta);
+}
+
+void integratorDestroy(tagIntegrator* integrator)
+{
+  if(integrator->scratch != NULL) alignedFree(integrator->scratch);
+  integrator->scratch = NULL;
+  integrator->stride  = 0;
+  blockStepsDestroy(&integrator->block);
+}
+
+void integratorReset(tagIntegrator* integrator)
+{
+  integrator->fresh        = false;
+  integrator->block.synced = false;
+}
+
+//#==============================================================================
+//# * integratorStep
+//#------------------------------------------------------------------------------
+//# Advances the bodies by dt seconds. Only dopri can fail, when its error
+//# control can't be met (see dopri).
+//#==============================================================================
+bool integratorStep(tagIntegrator* integrator, tagBodies* bodies, double dt)
+{
+  switch(integrator->type)
+  {
+    case INTEGRATOR_LEAPFROG:
+      leapfrog(integrator, bodies, dt);
+      break;
+    case INTEGRATOR_YOSHIDA4:
+    case INTEGRATOR_YOSHIDA6:
+    {
+      double weights[INTEGRATOR_WEIGHTS];
+      yoshida(integrator, bodies, dt, weights, integratorWeights(integrator->type, weights));
+      break;
+    }
+    case INTEGRATOR_DOPRI:
+      return dopri(integrator, bodies, dt);
+    case INTEGRATOR_BLOCK:
+    {
+      long blocks = integrator->block.blocks, forces = integrator->block.forces;
+      blockStepsStep(&integrator->block, bodies, dt);
+      integrator->forceEvaluations += integrator->block.blocks - blocks;
+      integrator->bodyForces       += integrator->block.forces - forces;
+      integrator->fresh = false;   // ax/ay/az are from predicted positions
+      break;
+    }
+    default:
+      // semi-implicit Euler: velocity first, then position with the new velocity
+      evaluate(integrator, bodies);
+      kick(bodies, dt);
+      drift(bodies, dt);
+      integrator->fresh = false;
+      break;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * integratorWeights
+//#------------------------------------------------------------------------------
+//# Fills in the leapfrog sub-steps (as fractions of a step) that a step of the
+//# leapfrog family is made of, and returns how many. Returns 0 for the rest.
+//#==============================================================================
+int integratorWeights(int type, double weights[INTEGRATOR_WEIGHTS])
+{
+  switch(type)
+  {
+    case INTEGRATOR_LEAPFROG:
+      weights[0] = 1;
+      return 1;
+    case INTEGRATOR_YOSHIDA4:
+    {
+      const double w1 = 1.0 / (2.0 - cbrt(2.0));
+      const double w0 = -cbrt(2.0) * w1;
+      weights[0] = w1;  weights[1] = w0;  weights[2] = w1;
+      return 3;
+    }
+    case INTEGRATOR_YOSHIDA6:
+    {
+      const double w1 = -1.17767998417887;
+      const double w2 =  0.235573213359357;
+      const double w3 =  0.784513610477560;
+      const double w0 = 1.0 - 2.0 * (w1 + w2 + w3);
+      weights[0] = w3;  weights[1] = w2;  weights[2] = w1;  weights[3] = w0;
+      weights[4] = w1;  weights[5] = w2;  weights[6] = w3;
+      return 7;
+    }
+  }
+  return 0;
+}
+
+//#==============================================================================
+//# * integratorName / integratorParse
+//#------------------------------------------------------------------------------
+//# Converts between integrators and the names used on the command line.
+//# Parsing returns -1 for a name it doesn't know.
+//#==============================================================================
+const char* integratorName(int type)
+{
+  switch(type)
+  {
+    case INTEGRATOR_EULER:    return "euler";
+    case INTEGRATOR_LEAPFROG: return "leapfrog";
+    case INTEGRATOR_YOSHIDA4: return "yoshida4";
+    case INTEGRATOR_YOSHIDA6: return "yoshida6";
+    case INTEGRATOR_DOPRI:    return "dopri";
+    case INTEGRATOR_BLOCK:    return "block";
+  }
+  return "unknown";
+}
+
+int integratorParse(const char* name)
+{
+  for( int type = 0; type < INTEGRATOR_COUNT; type++)
+  {
+    if(strcmp(name, integratorName(type)) == 0) return type;
+  }
+  return -1;
+}
@@ -0,0 +1,80 @@
+/*
+#================================================================================
+# * Integrator              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Ways of advancing the bodies once their accelerations are known. Every
+# integrator advances by exactly the step it is asked for; the adaptive one
+# splits that step up as finely as its error control needs.
+#
+#   euler     semi-implicit (symplectic) Euler, first order, 1 force
+#             evaluation per step. What the simulator has always done.
+#   leapfrog  kick-drift-kick velocity Verlet, second order, 1 evaluation
+#   yoshida4  Yoshida's fourth order composition of leapfrog, 3 evaluations
+#   yoshida6  Yoshida's sixth order composition (solution A), 7 evaluations
+#   dopri     Dormand-Prince 5(4) with error control, 6 evaluations per
+#             accepted sub-step
+#   block     fourth order Hermite with a power of two step per body; only
+#             the bodies due on a sub-step have their forces worked out
+#================================================================================
+*/
+#ifndef SOLAR_INTEGRATOR_H
+#define SOLAR_INTEGRATOR_H
+
+#include "bodies.h"
+#include "block_steps.h"
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define DOPRI_STAGES 7
+#define DOPRI_MIN_STEP 1E-12  // smallest dopri sub-step, as a fraction of the step
+#define INTEGRATOR_WEIGHTS 7   // most leapfrog sub-steps in a step (yoshida6)
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of integrators
+enum
+{
+  INTEGRATOR_EULER = 0,
+  INTEGRATOR_LEAPFROG,
+  INTEGRATOR_YOSHIDA4,
+  INTEGRATOR_YOSHIDA6,
+  INTEGRATOR_DOPRI,
+  INTEGRATOR_BLOCK,
+  INTEGRATOR_COUNT
+};
+
+// tagIntegrator
+typedef struct
+{
+  int     type;              // INTEGRATOR_*
+  double  tolerance;         // dopri: relative error allowed per sub-step
+  double  h;                 // dopri: size of the next sub-step to try
+  bool    fresh;             // ax/ay/az belong to the current positions
+  long    forceEvaluations;  // passes working out accelerations
+  long    bodyForces;        // single body accelerations worked out
+  long    accepted;          // dopri: sub-steps kept
+  long    rejected;          // dopri: sub-steps thrown away and retried
+  double* scratch;           // dopri: start state and stage derivatives
+  int     stride;            // doubles between scratch arrays
+  tagBlockSteps block;       // block: per body steps and derivatives
+}tagIntegrator;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void integratorCreate  ( tagIntegrator* integrator, int type, double tolerance,
+                         double eta );
+void integratorDestroy ( tagIntegrator* integrator );
+void integratorReset   ( tagIntegrator* integrator );
+bool integratorStep    ( tagIntegrator* integrator, tagBodies* bodies, double dt );
+int  integratorWeights ( int type, double weights[INTEGRATOR_WEIGHTS] );
+
+const char* integratorName  ( int type );
+int         integratorParse ( const char* name );
+
+#endif // SOLAR_INTEGRATOR_H
@@ -15,6 +15,22 @@
 #include <GL/gl.h>        // Header File for the OpenGL Library
 #include <GL/glut.h>      // Header File for the GLUT Library
 #include <math.h>         // Header File for the math library
+#include "physics.h"      // Header File for the N-body step
+#include "gravity.h"      // Header File for the gravity kernels
+#include "thread_pool.h"  // Header File for the physics threads
+#include "solar_system.h" // Header File for the planet seed values
+#include "options.h"      // Header File for the command line options
+#include "headless.h"     // Header File for the batch runner
+#include "simulation.h"   // Header File for the physics thread
+#include "clock.h"        // Header File for the wall clock
+#include "render.h"       // Header File for the sphere meshes
+#include "telemetry.h"    // Header File for the statistics writer
+#include "trajectory.h"   // Header File for recording and replay
+#include "ephemeris.h"    // Header File for drawing from a fitted ephemeris
+#include "checkpoint.h"   // Header File for saving and resuming runs
+#include "catalog.h"      // Header File for loading initial conditions
+#include "profiler.h"     // Header File for the timing zones
+#include "publisher.h"    // Header File for sharing steps with other processes
 
 //#==============================================================================
 //# Definitions
@@ -22,42 +38,28 @@
 
 typedef unsigned char UCHAR;
 typedef bool          FLAG;
-typedef char          INDEX;
+typedef int           INDEX;
 
 //#==============================================================================
 //# Structures & Enumerations
 //#==============================================================================
 
-// tagObjects
-typedef struct
-{
-  double x, dx, ddx; // x component of position, velocity, acceleration
-  double y, dy, ddy; // y component of position, velocity, acceleration
-  double z, dz, ddz; // z componont of position, velocity, acceleration
-  double mass;       // mass of the object (planet)
-  double radius;     // radius of the object (for deciding width of spheres)
-}tagObjects;
-
 // Enumeration for menu index
 enum
 {
   MENU_CAMERA = 0x0001,
+  MENU_HUD,
+  MENU_ZONES,
   MENU_EXIT
 };
 
-// Enumeration of planets
-enum
-{
-  SUN = 0,  MERCURY,  VENUS,  EARTH,   MARS,
-  JUPITER,  SATURN,  URANUS, NEPTUNE, PLUTO
-};
-
 
 //#==============================================================================
 //# Globals
 //#==============================================================================
 // constants:
 const double scale = 5E-11;  // Scale of the system
+const double fovy  = 30;     // Vertical field of view (degrees)
 
 // statics:
 static int WIN_WIDTH  = 640;
@@ -69,10 +71,25 @@ static float lasty        = 0.0;     //
 static INDEX activeCamera = 0;       // Check active camera
 
 float yrot  = 0.0;  // the y rotation angle
-double time = 0;    // the time to increase
+double simTime = 0; // the simulated time being drawn
+double alpha = 1;   // how far between the snapshot's two states to draw
 
 // Structures:
-tagObjects objects[10]; // Create 10 objects (9 planets, 1 star)
+tagBodies     bodies;      // The sun, 9 planets and anything else that was loaded
+tagParticles  particles;   // Massless test particles pulled along by "bodies"
+tagOptions    options;     // Command line options
+tagSimulation simulation;  // Physics thread (owns "bodies" while running)
+const tagSnapshot* snapshot = NULL;  // What is being drawn
+float* particleVertices = NULL;      // Scaled particle positions for glDrawArrays
+double lastFrame = 0;                // clockSeconds() at the last display()
+int    particleVertexCapacity = 0;
+tagTrajectoryWriter recorder;        // Where the steps go with --record
+tagPublisher        publisher;       // Where the steps go with --share
+tagTrajectoryReader replay;          // What is played back with --replay
+tagEphemeris ephemeris;              // What is drawn from with --ephemeris
+tagSnapshot replayShot;              // The two frames of "replay" either side of simTime,
+                                     // or with --ephemeris, the positions at simTime
+long   replayFrame = -1;             // The frame held in replayShot's first state
 
 
 
@@ -80,9 +97,21 @@ tagObjects objects[10]; // Create 10 objects (9 planets, 1 star)
 //# Prototypes
 //#==============================================================================
 
-void drawPlanet    ( int index,  float x_pos, float y_pos, float z_pos);
+void drawPlanet    ( int index,  double x_pos, double y_pos, double z_pos);
+double displayRadius ( int index );
+void bodyPosition  ( int index,  double* x_pos, double* y_pos, double* z_pos );
+void drawParticles ( );
+void drawHud       ( const tagTelemetrySample* sample );
+void drawZones     ( );
+void drawLines     ( const char lines[][64], int count, int first );
+void toggleZones   ( );
+void cameraOnActive( );
 void init      ( );
-void calculate    ( );
+void stopSimulation ( );
+double replayAdvance ( double now );
+double ephemerisAdvance ( double now );
+void newcamera ( double radius, double x_pos, double y_pos, double z_pos );
+void display    ( );
 void idle      ( );
 void visible    ( int vis );
 void reshape    ( int width,  int height);
@@ -106,6 +135,10 @@ int BuildPopupMenu ( void )
 {
   int    menu = glutCreateMenu (SelectFromMenu);
   glutAddMenuEntry ("Center Camera \tc",  MENU_CAMERA    );
+  glutAddMenuEntry ("Toggle HUD \th",     MENU_HUD       );
+#ifdef SOLAR_PROFILE
+  glutAddMenuEntry ("Toggle Zone Timings \tp", MENU_ZONES );
+#endif
   glutAddMenuEntry ("Exit \tEsc",    MENU_EXIT    );
   return  menu;
 }
@@ -122,6 +155,12 @@ void SelectFromMenu( int idCommand )
     yrot = 0.0;          // reset yrotation
     zoomFactor = 10.0;      // reset zoom
     break;
+    case MENU_HUD:
+    options.hud = !options.hud;  // show/hide statistics
+    break;
+    case MENU_ZONES:
+    toggleZones();               // show/hide p50/p99 of each zone
+    break;
     case MENU_EXIT:
     exit (0);          // close program
     break;
@@ -144,135 +183,330 @@ void init()
   glEnable( GL_COLOR_MATERIAL );    // Configure glColor().
   glColorMaterial( GL_FRONT, GL_AMBIENT_AND_DIFFUSE );
   glShadeModel( GL_SMOOTH );        // set shading (For planets)
+  renderInit();                     // sphere meshes, built once
+
+  if(options.replay != NULL)
+  {
+    // no physics at all: the snapshot is filled straight from the recording
+    const int count = (int)replay.header->bodies;
+    double** arrays[] = { &replayShot.x0, &replayShot.y0, &replayShot.z0,
+                          &replayShot.x1, &replayShot.y1, &replayShot.z1 };
+    for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+      *arrays[i] = (double*)alignedAlloc(sizeof(double) * (unsigned long)count);
+    replayShot.radius   = (double*)replay.radius;   // read in place from the map
+    replayShot.count    = count;
+    replayShot.capacity = count;
+    simTime  = replay.header->startTime;
+    snapshot = &replayShot;
+    alpha    = replayAdvance(clockSeconds());
+    return;
+  }
+
+  tagCheckpointState state;
+  if(options.resume)
+  {
+    // carry on where the checkpoint left off, looking at what it was
+    tagCheckpointView view;
+    if(!checkpointLoad(options.checkpoint, &state, &view, &bodies, &particles)) exit(1);
+    if(view.zoom > 0)
+    {
+      speedFactor  = (float)view.speed;
+      zoomFactor   = (float)view.zoom;
+      yrot         = (float)view.yrot;
+      activeCamera = view.camera < bodies.count ? view.camera : 0;
+    }
+  }
+  else
+  {
+    // Initialize the values of the bodies
+    bodiesCreate(&bodies, SOLAR_SYSTEM_BODIES + options.belt);
+    particlesCreate(&particles, options.particles);
+    if(options.catalogCount == 0) solarSystemInit(&bodies);
+    for( int c = 0; c < options.catalogCount; c++)
+    {
+      tagCatalogStats catalog;
+      if(!catalogLoad(options.catalogs[c], options.massiveAbove, &bodies, &particles, &catalog))
+        exit(1);
+      printf("%s: %d bodies and %d test particles in %.3f s\n", options.catalogs[c],
+             catalog.massive, catalog.particles, catalog.seconds);
+    }
+    if(bodies.count == 0)
+    {
+      fprintf(stderr, "--catalog: nothing massive to draw\n");
+      exit(1);
+    }
+    solarSystemAddBelt(&bodies, options.belt, 2011);
+    solarSystemAddParticles(&particles, options.particles, 2012);
+    physicsAttachParticles(&particles);
+    if(options.saveCatalog != NULL && !catalogSave(options.saveCatalog, &bodies, &particles))
+      fprintf(stderr, "--save-catalog: can't write '%s'\n", options.saveCatalog);
+
+    state.dt         = options.dt;
+    state.time       = 0;
+    state.steps      = 0;
+    state.solver     = options.solver;
+    state.theta      = options.theta;
+    state.multipole  = options.multipole;
+    state.integrator = options.integrator;
+    state.tolerance  = options.tolerance;
+    state.eta        = options.eta;
+    state.precision  = options.precision;
+    state.collisions = options.collisions ? 1 : 0;
+  }
+  if(options.ephemeris != NULL)
+  {
+    // integrated once (or read back) up front; every frame is then a lookup
+    tagEphemerisBuild build;
+    if(!ephemerisLoad(&ephemeris, options.ephemeris, &bodies, state.dt,
+                      options.steps * state.dt, optionsEphemerisSteps(&options),
+                      options.ephemerisDegree, &build))
+      exit(1);
+    printf("%s: %s in %.3f s, %.1f years\n", options.ephemeris,
+           build.built ? "built" : "reused", build.seconds, ephemeris.end/(60*60*24)/365.25);
+    const int count = (int)ephemeris.header->bodies;
+    replayShot.x0 = (double*)alignedAlloc(sizeof(double) * 3 * (unsigned long)count);
+    replayShot.y0 = replayShot.x0 + count;
+    replayShot.z0 = replayShot.y0 + count;
+    replayShot.x1 = replayShot.x0;            // nothing to interpolate between
+    replayShot.y1 = replayShot.y0;
+    replayShot.z1 = replayShot.z0;
+    replayShot.radius   = (double*)ephemeris.radius;
+    replayShot.count    = count;
+    replayShot.capacity = count;
+    snapshot = &replayShot;
+    alpha    = ephemerisAdvance(clockSeconds());
+    return;
+  }
+  if(options.record != NULL)
+  {
+    if(!trajectoryCreate(&recorder, options.record, options.recordFormat,
+                         options.recordEvery, state.dt, state.time, &bodies))
+    {
+      fprintf(stderr, "--record: can't write '%s'\n", options.record);
+      exit(1);
+    }
+    physicsAttachRecorder(&recorder);
+  }
+  if(options.share != NULL)
+  {
+    if(!publisherCreate(&publisher, options.share, bodies.capacity, state.dt,
+                        state.time, state.steps))
+    {
+      fprintf(stderr, "--share: can't create shared memory '%s'\n", options.share);
+      exit(1);
+    }
+    physicsAttachPublisher(&publisher);
+  }
+
+  if(options.checkpoint != NULL)
+  {
+    if(!checkpointStart(options.checkpoint))
+    {
+      fprintf(stderr, "--checkpoint: can't write next to '%s'\n", options.checkpoint);
+      exit(1);
+    }
+    simulationCheckpoint(&simulation, &state, options.checkpointEvery);
+  }
+
+  // Hand the bodies to the physics thread. A day per step, and sixty days
+  // per second at 1x (what one step per frame used to give at 60 Hz).
+  simulationStart(&simulation, &bodies, &particles, state.time, state.steps,
+                  state.dt, options.rate * 86400, speedFactor);
+  snapshot = simulationAcquire(&simulation);
+}
+
+//#==============================================================================
+//# * stopSimulation
+//#------------------------------------------------------------------------------
+//# Stops the physics thread when the program exits, then saves a last
+//# checkpoint, finishes off the recording and closes the shared memory (if
+//# there are any) now nothing else is touching the bodies
+//#==============================================================================
+void stopSimulation()
+{
+  simulationStop(&simulation);
+  if(options.checkpoint != NULL)
+  {
+    simulation.checkpoint.time  = simulation.time;
+    simulation.checkpoint.steps = simulation.steps;
+    checkpointSave(&simulation.checkpoint, &bodies);
+    checkpointStop();
+  }
+  if(options.record != NULL)
+  {
+    physicsAttachRecorder(NULL);
+    if(!trajectoryClose(&recorder))
+      fprintf(stderr, "--record: error writing '%s'\n", options.record);
+  }
+  if(options.share != NULL)
+  {
+    physicsAttachPublisher(NULL);
+    publisherClose(&publisher);
+  }
+  if(options.replay != NULL) trajectoryCloseReader(&replay);
+  if(options.ephemeris != NULL) ephemerisClose(&ephemeris);
+}
+
+//#==============================================================================
+//# * replayAdvance
+//#------------------------------------------------------------------------------
+//# Replay's stand-in for the physics thread: moves simTime on by the real
+//# time since the last frame, decodes the recorded frames either side of it
+//# (only when that changes) and returns how far between them to draw
+//#==============================================================================
+double replayAdvance(double now)
+{
+  double elapsed = lastFrame > 0 ? now - lastFrame : 0;
+  simTime += elapsed * options.rate * 86400 * speedFactor;
+
+  long last = (long)replay.frameCount - 1;
+  double first = trajectoryFrameTime(&replay, 0);
+  double end   = trajectoryFrameTime(&replay, last);
+  if(simTime < first) simTime = first;
+  if(simTime > end)   simTime = end;     // hold the last frame
+
+  long frame = trajectoryFrameAt(&replay, simTime);
+  long next  = frame < last ? frame + 1 : frame;
+  if(frame != replayFrame)
+  {
+    if(frame == replayFrame + 1 && next != frame)   // playing on: reuse the later state
+    {
+      double* swap;
+      swap = replayShot.x0; replayShot.x0 = replayShot.x1; replayShot.x1 = swap;
+      swap = replayShot.y0; replayShot.y0 = replayShot.y1; replayShot.y1 = swap;
+      swap = replayShot.z0; replayShot.z0 = replayShot.z1; replayShot.z1 = swap;
+    }
+    else
+    {
+      trajectoryReadFrame(&replay, frame, replayShot.x0, replayShot.y0, replayShot.z0,
+                          NULL, NULL, NULL);
+    }
+    trajectoryReadFrame(&replay, next, replayShot.x1, replayShot.y1, replayShot.z1,
+                        NULL, NULL, NULL);
+    replayShot.time0 = trajectoryFrameTime(&replay, frame);
+    replayShot.time1 = trajectoryFrameTime(&replay, next);
+    replayShot.steps = frame * (long)replay.header->decimation;
+    replayFrame = frame;
+  }
 
-  // Initialize the values of the Object structure
-
-  // Sun
-  objects[SUN].mass     = 1.99E+30;
-  objects[SUN].radius   = 695500000 * scale*50;
-  objects[SUN].x        =
-  objects[SUN].y        =
-  objects[SUN].z        =
-  objects[SUN].dx       =
-  objects[SUN].dy       =
-  objects[SUN].dz       = 0;
-
-  // Mercury
-  objects[MERCURY].mass   = 3.34E+23;
-  objects[MERCURY].radius = 2439700 * scale*100;
-  objects[MERCURY].x      =-20665696392;
-  objects[MERCURY].y      =-59636889090;
-  objects[MERCURY].z      =-29712844059;
-  objects[MERCURY].dx     = 3.66E+04;
-  objects[MERCURY].dy     =-9.51E+03;
-  objects[MERCURY].dz     =-8.88E+03;
-
-  // Venus
-  objects[VENUS].mass   = 4.87E+24;
-  objects[VENUS].radius = 6051800 * scale*100;
-  objects[VENUS].x      =-1.07478E+11;
-  objects[VENUS].y      =-6401037913;
-  objects[VENUS].z      = 3920831085;
-  objects[VENUS].dx     = 8.82E+02;
-  objects[VENUS].dy     =-3.19E+04;
-  objects[VENUS].dz     =-1.45E+04;
-
-  // Earth
-  objects[EARTH].mass   = 5.98E+24;
-  objects[EARTH].radius = 6378100 * scale*100;
-  objects[EARTH].x      =-26516914541;
-  objects[EARTH].y      = 1.32754E+11;
-  objects[EARTH].z      = 57555479554;
-  objects[EARTH].dx     =-2.98E+04;
-  objects[EARTH].dy     =-4.78E+03;
-  objects[EARTH].dz     =-2.06E+03;
-
-  // Mars
-  objects[MARS].mass    = 6.40e23;
-  objects[MARS].radius  = 3397000 * scale*100;
-  objects[MARS].x       = 2.08092E+11;
-  objects[MARS].y       = 1150108018;
-  objects[MARS].z       =-5098849339;
-  objects[MARS].dx      = 1.30E+03;
-  objects[MARS].dy      = 2.39E+04;
-  objects[MARS].dz      = 1.09E+04;
-
-  // Jupiter
-  objects[JUPITER].mass   = 1.90E+27;
-  objects[JUPITER].radius = 71492000 * scale*100;
-  objects[JUPITER].x      = 5.94749E+11;
-  objects[JUPITER].y      = 4.1426E+11;
-  objects[JUPITER].z      = 1.63068E+11;
-  objects[JUPITER].dx     =-7.89E+03;
-  objects[JUPITER].dy     = 1.02E+04;
-  objects[JUPITER].dz     = 4.54E+03;
-
-  // Saturn
-  objects[SATURN].mass   = 5.69E+26;
-  objects[SATURN].radius = 60268000 * scale*100;
-  objects[SATURN].x      = 9.48999E+11;
-  objects[SATURN].y      = 9.31359E+11;
-  objects[SATURN].z      = 3.4387E+11;
-  objects[SATURN].dx     =-7.44E+03;
-  objects[SATURN].dy     = 6.12E+03;
-  objects[SATURN].dz     = 2.85E+03;
-
-  // Uranus
-  objects[URANUS].mass   = 8.67E+25;
-  objects[URANUS].radius = 25559000 * scale*100;
-  objects[URANUS].x      = 2.17596E+12;
-  objects[URANUS].y      =-1.85516E+12;
-  objects[URANUS].z      =-8.43327E+11;
-  objects[URANUS].dx     = 4.66E+03;
-  objects[URANUS].dy     = 4.29E+03;
-  objects[URANUS].dz     = 1.81E+03;
-
-  // Neptune
-  objects[NEPTUNE].mass   = 1.03E+26;
-  objects[NEPTUNE].radius = 24764000 * scale*100;
-  objects[NEPTUNE].x      = 2.5472E+12;
-  objects[NEPTUNE].y      =-3.41681E+12;
-  objects[NEPTUNE].z      =-1.46188E+12;
-  objects[NEPTUNE].dx     = 4.50E+03;
-  objects[NEPTUNE].dy     = 2.91E+03;
-  objects[NEPTUNE].dz     = 1.08E+03;
-
-  // Pluto
-  objects[PLUTO].mass   = 6.58e23;
-  objects[PLUTO].radius = 1180000 * scale*100;  // has to be scaled to be seen
-  objects[PLUTO].x      =-1.42071E+12;
-  objects[PLUTO].y      =-4.20637E+12;
-  objects[PLUTO].z      =-8.84208E+11;
-  objects[PLUTO].dx     = 5.28E+03;
-  objects[PLUTO].dy     =-1.96E+03;
-  objects[PLUTO].dz     =-2.19E+03;
+  double span = replayShot.time1 - replayShot.time0;
+  if(span <= 0) return 1;
+  double alpha = (simTime - replayShot.time0) / span;
+  return alpha < 0 ? 0 : (alpha > 1 ? 1 : alpha);
+}
+
+//#==============================================================================
+//# * ephemerisAdvance
+//#------------------------------------------------------------------------------
+//# The ephemeris' stand-in for the physics thread: moves simTime on like
+//# replayAdvance and looks the positions up right at it, so any speed costs
+//# the same per frame
+//#==============================================================================
+double ephemerisAdvance(double now)
+{
+  double elapsed = lastFrame > 0 ? now - lastFrame : 0;
+  simTime += elapsed * options.rate * 86400 * speedFactor;
+  if(simTime < ephemeris.header->start) simTime = ephemeris.header->start;
+  if(simTime > ephemeris.end)           simTime = ephemeris.end;
+
+  ephemerisPositions(&ephemeris, simTime, replayShot.x0, replayShot.y0, replayShot.z0);
+  replayShot.time0 = simTime;
+  replayShot.time1 = simTime;
+  replayShot.steps = (long)(simTime / ephemeris.header->dt);
+  return 1;
 }
 
 //#==============================================================================
 //# * drawPlanet
 //#------------------------------------------------------------------------------
-//# this function outputs the planet and applies the texture to them
+//# this function outputs the planet and applies the texture to them. The mesh
+//# (or a point, for anything under a pixel) is chosen by renderSphere.
 //#==============================================================================
-void drawPlanet(int index, float x_pos, float y_pos, float z_pos)
+void drawPlanet(int index, double x_pos, double y_pos, double z_pos)
 {
-  glPushMatrix();
+  float red, green, blue;
   switch(index)
   {
     // Set up colors for planets
-    case SUN:    glColor3f(1.0, 0.7, 0.0);  break;
-    case MERCURY:  glColor3f(1.0, 0.9, 0.1);  break;
-    case VENUS:    glColor3f(1.0, 0.5, 0.1);  break;
-    case EARTH:    glColor3f(0.1, 8.0, 0.0);  break;
-    case MARS:    glColor3f(1.0, 0.0, 0.0);  break;
-    case JUPITER:  glColor3f(0.8, 0.3, 0.8);  break;
-    case SATURN:  glColor3f(1.0, 0.9, 0.7);  break;
-    case NEPTUNE:  glColor3f(0.2, 0.1, 1.0);  break;
-    case URANUS:  glColor3f(0.0, 0.8, 0.4);  break;
-    case PLUTO:    glColor3f(0.9, 0.9, 1.0);  break;
-  }
-  glTranslatef(x_pos*scale, y_pos*scale, z_pos*scale);  // move matrix to scaled positions
-  glutSolidSphere(objects[index].radius, 30, 30);      // draw planet
-  glPopMatrix();
+    case SUN:    red = 1.0; green = 0.7; blue = 0.0;  break;
+    case MERCURY:  red = 1.0; green = 0.9; blue = 0.1;  break;
+    case VENUS:    red = 1.0; green = 0.5; blue = 0.1;  break;
+    case EARTH:    red = 0.1; green = 8.0; blue = 0.0;  break;
+    case MARS:    red = 1.0; green = 0.0; blue = 0.0;  break;
+    case JUPITER:  red = 0.8; green = 0.3; blue = 0.8;  break;
+    case SATURN:  red = 1.0; green = 0.9; blue = 0.7;  break;
+    case NEPTUNE:  red = 0.2; green = 0.1; blue = 1.0;  break;
+    case URANUS:  red = 0.0; green = 0.8; blue = 0.4;  break;
+    case PLUTO:    red = 0.9; green = 0.9; blue = 1.0;  break;
+    default:       red = 0.6; green = 0.6; blue = 0.6;  break; // asteroids
+  }
+  // draw at the scaled position
+  renderSphere(x_pos*scale, y_pos*scale, z_pos*scale, displayRadius(index),
+               red, green, blue);
+}
+
+//#==============================================================================
+//# * displayRadius
+//#------------------------------------------------------------------------------
+//# Bodies are far too small to see at the system scale, so they are drawn
+//# 100 times larger than they are (the sun only 50 times, or it would swallow
+//# Mercury).
+//#==============================================================================
+double displayRadius(int index)
+{
+  return snapshot->radius[index] * scale * (index == SUN ? 50 : 100);
+}
+
+//#==============================================================================
+//# * bodyPosition
+//#------------------------------------------------------------------------------
+//# Position of a body at the time being drawn, in between the two states of
+//# the snapshot
+//#==============================================================================
+void bodyPosition(int index, double* x_pos, double* y_pos, double* z_pos)
+{
+  *x_pos = snapshot->x0[index] + (snapshot->x1[index] - snapshot->x0[index]) * alpha;
+  *y_pos = snapshot->y0[index] + (snapshot->y1[index] - snapshot->y0[index]) * alpha;
+  *z_pos = snapshot->z0[index] + (snapshot->z1[index] - snapshot->z0[index]) * alpha;
+}
+
+//#==============================================================================
+//# * drawParticles
+//#------------------------------------------------------------------------------
+//# Test particles are far too many and too small for spheres, so they are
+//# drawn as single points from one vertex array
+//#==============================================================================
+void drawParticles()
+{
+  const int count = snapshot->particleCount;
+  if(count == 0) return;
+  if(count > particleVertexCapacity)
+  {
+    if(particleVertices != NULL) alignedFree(particleVertices);
+    particleVertices = (float*)alignedAlloc(sizeof(float) * 3 * (unsigned long)count);
+    particleVertexCapacity = count;
+  }
+  const float a = (float)alpha, s = (float)scale;
+  for( int i = 0; i < count; i++)
+  {
+    particleVertices[3*i + 0] = (snapshot->px0[i] + (snapshot->px1[i] - snapshot->px0[i]) * a) * s;
+    particleVertices[3*i + 1] = (snapshot->py0[i] + (snapshot->py1[i] - snapshot->py0[i]) * a) * s;
+    particleVertices[3*i + 2] = (snapshot->pz0[i] + (snapshot->pz1[i] - snapshot->pz0[i]) * a) * s;
+  }
+  renderPoints(particleVertices, count, 1.0, 0.5, 0.5, 0.5);
+}
+
+//#==============================================================================
+//# * cameraOnActive
+//#------------------------------------------------------------------------------
+//# Points the camera at the active body
+//#==============================================================================
+void cameraOnActive()
+{
+  PROFILE_ZONE("camera");
+  double x, y, z;
+  bodyPosition(activeCamera, &x, &y, &z);
+  newcamera(displayRadius(activeCamera), x, y, z);
 }
 
 //#==============================================================================
@@ -294,7 +528,7 @@ void newcamera(double radius, double x_pos, double y_pos, double z_pos)
   glMatrixMode  ( GL_PROJECTION );
   glLoadIdentity  ( );
   // set perspective
-  gluPerspective  ( 30, (GLfloat)WIN_WIDTH / (GLfloat)WIN_HEIGHT, 0.01, 1000000 );
+  gluPerspective  ( fovy, (GLfloat)WIN_WIDTH / (GLfloat)WIN_HEIGHT, 0.01, 1000000 );
   // Load modelview matrix
   glMatrixMode  ( GL_MODELVIEW );
   glLoadIdentity  ( );
@@ -322,102 +556,161 @@ void reshape (int width, int height)
   gluPerspective( 0, (GLfloat)width / (GLfloat)height, 0.1, 1000000 );
   glMatrixMode(GL_MODELVIEW); // Load Modelview patrix
   glLoadIdentity();
-  newcamera(
-    objects[activeCamera].radius,
-    objects[activeCamera].x,
-    objects[activeCamera].y,
-    objects[activeCamera].z
-  );
+  cameraOnActive();
   glutPostRedisplay(); // marks window to be repainted
 }
 
 //#==============================================================================
-//# * calculate
+//# * display
 //#------------------------------------------------------------------------------
-//# Calculates the required positions of the planets, then outputs them.
+//# Draws the latest state published by the physics thread. Nothing here
+//# steps the physics; positions are interpolated so that motion stays smooth
+//# whatever the frame rate.
 //#==============================================================================
-void calculate()
+void display()
 {
-  double interval        = 86400 * speedFactor;  // the interval for calculation (1 day)
+  PROFILE_ZONE("frame");
+  if(options.replay != NULL)
+  {
+    alpha = replayAdvance(clockSeconds());              // recorded state
+  }
+  else if(options.ephemeris != NULL)
+  {
+    alpha = ephemerisAdvance(clockSeconds());           // fitted state
+  }
+  else
+  {
+    snapshot = simulationAcquire(&simulation);          // newest state
+    alpha    = snapshotAlpha(snapshot, clockSeconds(), &simTime);
+  }
+  if(activeCamera >= snapshot->count) activeCamera = 0;
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear window.
-  newcamera(
-    objects[activeCamera].radius,
-    objects[activeCamera].x, // Recalculate veiw
-    objects[activeCamera].y,
-    objects[activeCamera].z
-  );
-  double Fx[10], Fy[10], Fz[10];            // Array of force vectors
-  float gravity_constant = 6.67E-11;          // Kepler's gravity constant
-  // Set the forces of all the planets to 0
-  for( int i = 0; i < 10 ; i++)
-  {
-    Fx[i] = 0;
-    Fy[i] = 0;
-    Fz[i] = 0;
-  }
-  for( int i = 0; i < 10 ; i++)
-  {
-    for( int j = 0; j < 10 ; j++)
+  cameraOnActive();                                     // Recalculate veiw
+  // Output the objects
+  renderBegin(fovy, WIN_HEIGHT);
+  {
+    PROFILE_ZONE("draw bodies");
+    for( int i = 0; i < snapshot->count ; i++)
     {
-      if(j!=i)  // if not itself (added to ensure no division by zero error)
-      {
-        // Calculate force in the x direction(Sum of all forces = GMm(x2-x1)/r^3)
-        Fx[i] += gravity_constant * objects[i].mass * objects[j].mass * (objects[j].x - objects[i].x)/
-          pow(sqrt(
-          pow((objects[j].x - objects[i].x),2) +
-          pow((objects[j].y - objects[i].y),2) +
-          pow((objects[j].z - objects[i].z),2)),
-          3);
-        // Calculate force in the y direction (Sum of all forces = GMm(x2-x1)/r^3)
-        Fy[i] +=gravity_constant * objects[i].mass * objects[j].mass * (objects[j].y - objects[i].y)/
-          pow(sqrt(
-          pow((objects[j].x - objects[i].x),2) +
-          pow((objects[j].y - objects[i].y),2) +
-          pow((objects[j].z - objects[i].z),2)),
-          3);
-        // Calculate force in the z direction (Sum of all forces = GMm(x2-x1)/r^3)
-        Fz[i] += gravity_constant * objects[i].mass * objects[j].mass * (objects[j].z - objects[i].z)/
-          pow(sqrt(
-          pow((objects[j].x - objects[i].x),2) +
-          pow((objects[j].y - objects[i].y),2) +
-          pow((objects[j].z - objects[i].z),2)),
-          3);
-      }
+      double x, y, z;
+      bodyPosition(i, &x, &y, &z);
+      drawPlanet(i, x, y, z);
     }
   }
-  time += interval;  // Increase time by the interval
-  // Loop for calculating acceleration, velocity, and position
-  for( int i = 0; i < 10 ; i++)
-  {
-    // calculate acceleration
-    objects[i].ddx   =  Fx[i] / objects[i].mass;
-    objects[i].ddy   =  Fy[i] / objects[i].mass;
-    objects[i].ddz   =  Fz[i] / objects[i].mass;
-    // calculate velocity
-    objects[i].dx  +=  objects[i].ddx  * interval;
-    objects[i].dy  +=  objects[i].ddy  * interval;
-    objects[i].dz  +=  objects[i].ddz  * interval;
-    // calculate position
-    objects[i].x  +=  objects[i].dx  * interval;
-    objects[i].y  +=  objects[i].dy  * interval;
-    objects[i].z  +=  objects[i].dz  * interval;
-    // Output the objects
-    drawPlanet(i, objects[i].x, objects[i].y, objects[i].z);
-  }
-  //output debug information
-  float days  = time/(60*60*24);    // create temporary variable for days
-  float years = days/365.25;      // create temporary variable for years
-  printf("%s%1.1f%s","Speed Multiplier: \t", speedFactor, "x\n");
-  printf("%s%6.3f\n","Time Elapsed (s): \t", time);
-  printf("%s%6.3f\n","Time Elapsed (d): \t", days);
-  printf("%s%3.3f\n","Time Elapsed (y): \t", years);
-  printf("%s%i \n",  "Active Camera   : \t", activeCamera);
-  printf("%s%1.1f  ","Scale Factor  : \t", zoomFactor);
+  {
+    PROFILE_ZONE("draw points");
+    renderEnd();                                        // sub-pixel bodies
+    drawParticles();
+  }
+  //output debug information (written out by the telemetry thread)
+  tagTelemetrySample sample;
+  double now    = clockSeconds();
+  sample.wall    = now;
+  sample.simTime = simTime;
+  sample.speed   = speedFactor;
+  sample.zoom    = zoomFactor;
+  sample.frame   = lastFrame > 0 ? now - lastFrame : 0;
+  sample.steps   = snapshot->steps;
+  sample.camera  = activeCamera;
+  sample.bodies  = snapshot->count;
+  lastFrame = now;
+  telemetryPush(&sample);
+  if(options.checkpoint != NULL)
+  {
+    tagCheckpointView view = { speedFactor, zoomFactor, yrot, activeCamera };
+    checkpointSetView(&view);                           // saved with the next checkpoint
+  }
+  if(options.hud) drawHud(&sample);
+  if(profilerHistograms()) drawZones();
   glutPostRedisplay();        // marks window to be repainted
+  PROFILE_ZONE("swap");
   glutSwapBuffers();          // performs a buffer swap
 }
 
+//#==============================================================================
+//# * drawHud
+//#------------------------------------------------------------------------------
+//# Draws the statistics in the top left corner of the window
+//#==============================================================================
+void drawHud(const tagTelemetrySample* sample)
+{
+  char lines[6][64];
+  double days = sample->simTime/(60*60*24);
+  snprintf(lines[0], sizeof(lines[0]), "Speed Multiplier: %1.1fx", sample->speed);
+  snprintf(lines[1], sizeof(lines[1]), "Time Elapsed (d): %6.1f", days);
+  snprintf(lines[2], sizeof(lines[2]), "Time Elapsed (y): %3.3f", days/365.25);
+  snprintf(lines[3], sizeof(lines[3]), "Active Camera   : %i", sample->camera);
+  snprintf(lines[4], sizeof(lines[4]), "Scale Factor    : %1.1f", sample->zoom);
+  snprintf(lines[5], sizeof(lines[5]), "Frame (ms)      : %4.1f", sample->frame * 1000);
+  drawLines(lines, 6, 0);
+}
+
+//#==============================================================================
+//# * drawZones
+//#------------------------------------------------------------------------------
+//# Draws the median and 99th percentile of each timing zone over the last
+//# second, below the statistics if they are shown
+//#==============================================================================
+void drawZones()
+{
+  tagProfilerStats stats[PROFILER_ZONES];
+  char lines[PROFILER_ZONES + 1][64];
+  int  count = profilerStats(stats, PROFILER_ZONES);
+  snprintf(lines[0], sizeof(lines[0]), "Zone (ms)           p50      p99");
+  for( int z = 0; z < count; z++)
+  {
+    snprintf(lines[z + 1], sizeof(lines[z + 1]), "%-16s %7.3f  %7.3f", stats[z].name,
+             stats[z].p50 * 1000, stats[z].p99 * 1000);
+  }
+  drawLines(lines, count + 1, options.hud ? 7 : 0);
+}
+
+//#==============================================================================
+//# * drawLines
+//#------------------------------------------------------------------------------
+//# Draws lines of text down the left of the window, starting "first" lines
+//# from the top
+//#==============================================================================
+void drawLines(const char lines[][64], int count, int first)
+{
+  // pixel coordinates, drawn over everything
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  glOrtho(0, WIN_WIDTH, 0, WIN_HEIGHT, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  glDisable(GL_DEPTH_TEST);
+
+  glColor3f(0.8, 0.8, 0.8);
+  for( int line = 0; line < count; line++)
+  {
+    glRasterPos2i(10, WIN_HEIGHT - 20 - 15 * (first + line));
+    for( const char* c = lines[line]; *c != '\0'; c++)
+    {
+      glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+    }
+  }
+
+  glEnable(GL_DEPTH_TEST);
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+}
+
+//#==============================================================================
+//# * toggleZones
+//#------------------------------------------------------------------------------
+//# Turns the zone histograms (and their lines in the window) on or off
+//#==============================================================================
+void toggleZones()
+{
+  profilerSetHistograms(!profilerHistograms());
+}
+
 //#==============================================================================
 //# * idle
 //#------------------------------------------------------------------------------
@@ -465,20 +758,19 @@ void special(int key, int x, int y)
     case GLUT_KEY_LEFT:
       if(activeCamera>0)
         {activeCamera--;}
-      else{activeCamera=9;}
+      else{activeCamera=snapshot->count-1;}
       break;
       //user_theta  += 0.1; break;
     // If Right arrow is pressed
     case GLUT_KEY_RIGHT:
-      if(activeCamera<9)
+      if(activeCamera<snapshot->count-1)
         {activeCamera++;}
       else{activeCamera=0;}
       break;
       //user_theta  -= 0.1; break;
   }
   //computeLocation();          // Compute camera location
-  newcamera(objects[activeCamera].radius, objects[activeCamera].x,
-        objects[activeCamera].y,    objects[activeCamera].z );
+  cameraOnActive();
   glutPostRedisplay();        // marks window to be repainted
 }
 
@@ -492,11 +784,29 @@ void keyboard(UCHAR key, int x, int y)
   // check for key that was pressed
   switch( key )
   {
-  // if q key was pressed
-  case 'q':  if(speedFactor < 2.0 )  speedFactor+=.1;  break;
+  // if q key was pressed (an ephemeris costs the same at any speed, so
+  // there it doubles, far past what stepping could keep up with)
+  case 'q':
+    if(options.ephemeris != NULL) { if(speedFactor < 65536) speedFactor*=2; }
+    else if(speedFactor < 2.0 )  speedFactor+=.1;
+    break;
   // if a key was pressed
-  case 'a':  if(speedFactor > 0.1 )  speedFactor-=.1;  break;
+  case 'a':
+    if(options.ephemeris != NULL) { if(speedFactor > 0.01 ) speedFactor/=2; }
+    else if(speedFactor > 0.1 )  speedFactor-=.1;
+    break;
+  // if h key was pressed
+  case 'h':  options.hud = !options.hud;  break;
+  // if p key was pressed
+#ifdef SOLAR_PROFILE
+  case 'p':  toggleZones();  break;
+#endif
+  // if [ or ] was pressed, jump a year back or on in a recording or ephemeris
+  case '[':  simTime -= 365.25*86400;  break;
+  case ']':  simTime += 365.25*86400;  break;
   }
+  // more steps per second, not bigger ones
+  simulationSetSpeed(&simulation, speedFactor);
 }
 
 //#==============================================================================
@@ -521,15 +831,56 @@ void mouseMotion( int x, int y )
 //#==============================================================================
 int main(int argc, char **argv)
 {
+  optionsDefault(&options);
+  if(!optionsParse(&options, argc, argv))
+  {
+    optionsUsage(argv[0]);
+    return 1;
+  }
+  if(!gravitySelectKernel(options.kernel))
+  {
+    fprintf(stderr, "this processor can't run the %s kernel\n",
+            gravityKernelName(options.kernel));
+    return 1;
+  }
+  physicsSelectSolver(options.solver, options.theta, options.multipole);
+  physicsSelectPrecision(options.precision);
+  physicsSetCollisions(options.collisions);
+  physicsSelectIntegrator(options.integrator, options.tolerance, options.eta);
+  threadPoolStart(options.threads);
+  if(options.headless)
+  {
+    return runHeadless(&options); // no window, no GL context
+  }
+  if(options.replay != NULL && !trajectoryOpen(&replay, options.replay))
+  {
+    return 1;
+  }
+
   glutInit(&argc, argv);          // Initialize GLUT with main's parameters
   glutInitDisplayMode( GLUT_DEPTH  | GLUT_DOUBLE | GLUT_RGB );
   glutInitWindowPosition( 50, 100 );    // Set up display window's position.
   glutInitWindowSize( WIN_WIDTH, WIN_HEIGHT ); // Initial window size
   glutCreateWindow( "Solar System" );          // Name window
 
+  if(!telemetryStart(options.telemetry, options.telemetryPath, options.telemetryRate))
+  {
+    fprintf(stderr, "--telemetry: can't open '%s'\n", options.telemetryPath);
+    return 1;
+  }
+#ifdef SOLAR_PROFILE
+  if(!profilerStart(options.trace))
+  {
+    fprintf(stderr, "--trace: can't write '%s'\n", options.trace);
+    return 1;
+  }
+  profilerNameThread("display");
+#endif
+
   init(); // initialize function
+  atexit( stopSimulation );      // stop the physics thread on the way out
 
-  glutDisplayFunc( calculate );  // Main draw function
+  glutDisplayFunc( display );    // Main draw function
   glutVisibilityFunc( visible ); // test if window is visible
   glutReshapeFunc( reshape );    // Text for window resize
   glutSpecialFunc( special );    // Get special keyboard input
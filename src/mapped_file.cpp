@@ -0,0 +1,97 @@
+/*
+#================================================================================
+# * Mapped File             Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# mmap (or MapViewOfFile) of a whole file
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "mapped_file.h"
+#include <string.h>       // Header File for memset
+#ifdef _WIN32
+# include <windows.h>     // Header File for CreateFileMapping
+#else
+# include <fcntl.h>       // Header File for open
+# include <sys/mman.h>    // Header File for mmap
+# include <sys/stat.h>    // Header File for fstat
+# include <unistd.h>      // Header File for close
+#endif
+
+//#==============================================================================
+//# * mappedFileOpen
+//#------------------------------------------------------------------------------
+//# Maps "path" for reading. Returns false if it can't be opened or mapped.
+//# An empty file opens fine with data NULL and size 0.
+//#==============================================================================
+bool mappedFileOpen(tagMappedFile* mapped, const char* path)
+{
+  memset(mapped, 0, sizeof(*mapped));
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if(file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(file, &size))
+  {
+    CloseHandle(file);
+    return false;
+  }
+  mapped->size = (unsigned long long)size.QuadPart;
+  mapped->file = file;
+  if(mapped->size == 0) return true;
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if(mapping == NULL)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  mapped->mapping = mapping;
+  mapped->data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(mapped->data == NULL)
+  {
+    mappedFileClose(mapped);
+    return false;
+  }
+#else
+  int file = open(path, O_RDONLY);
+  if(file < 0) return false;
+  struct stat info;
+  if(fstat(file, &info) != 0)
+  {
+    close(file);
+    return false;
+  }
+  mapped->size = (unsigned long long)info.st_size;
+  if(mapped->size > 0)
+  {
+    void* data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, file, 0);
+    if(data == MAP_FAILED)
+    {
+      close(file);
+      return false;
+    }
+    mapped->data = (const unsigned char*)data;
+  }
+  close(file);   // the mapping keeps the file alive
+#endif
+  return true;
+}
+
+//#==============================================================================
+//# * mappedFileClose
+//#------------------------------------------------------------------------------
+//# Unmaps the file. Safe to call on a closed (or zeroed) mapping.
+//#==============================================================================
+void mappedFileClose(tagMappedFile* mapped)
+{
+#ifdef _WIN32
+  if(mapped->data    != NULL) UnmapViewOfFile(mapped->data);
+  if(mapped->mapping != NULL) CloseHandle((HANDLE)mapped->mapping);
+  if(mapped->file    != NULL) CloseHandle((HANDLE)mapped->file);
+#else
+  if(mapped->data != NULL) munmap((void*)mapped->data, mapped->size);
+#endif
+  memset(mapped, 0, sizeof(*mapped));
+}
@@ -0,0 +1,32 @@
+/*
+#================================================================================
+# * Mapped File             Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Read-only memory mapping of a whole file, so large recordings and catalogs
+# can be read in place without copying them through read() first
+#================================================================================
+*/
+#ifndef SOLAR_MAPPED_FILE_H
+#define SOLAR_MAPPED_FILE_H
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagMappedFile
+typedef struct
+{
+  const unsigned char* data;   // first byte of the file (NULL if empty)
+  unsigned long long   size;   // bytes in the file
+  void*                file;   // Windows: file and mapping handles
+  void*                mapping;
+}tagMappedFile;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool mappedFileOpen  ( tagMappedFile* mapped, const char* path );
+void mappedFileClose ( tagMappedFile* mapped );
+
+#endif // SOLAR_MAPPED_FILE_H
@@ -0,0 +1,490 @@
+/*
+#================================================================================
+# * Octree                  Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Barnes-Hut tree build and walk
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "octree.h"
+#include "gravity.h"
+#include "thread_pool.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for realloc/free
+#include <string.h>       // Header File for memset/strcmp
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# * octreeCreate / octreeDestroy
+//#------------------------------------------------------------------------------
+//# Sets up an empty tree. Memory is kept between builds.
+//#==============================================================================
+void octreeCreate(tagOctree* tree, double theta, int multipole)
+{
+  memset(tree, 0, sizeof(*tree));
+  tree->theta     = theta;
+  tree->multipole = multipole;
+}
+
+void octreeDestroy(tagOctree* tree)
+{
+  free(tree->nodes);
+  free(tree->order);
+  free(tree->scratch);
+  free(tree->leaves);
+  free(tree->lists);
+  if(tree->sx != NULL)
+  {
+    alignedFree(tree->sx);  alignedFree(tree->sy);
+    alignedFree(tree->sz);  alignedFree(tree->sm);
+  }
+  memset(tree, 0, sizeof(*tree));
+}
+
+//#==============================================================================
+//# * allocateNodes
+//#------------------------------------------------------------------------------
+//# Reserves "count" consecutive nodes and returns the index of the first one.
+//# Node pointers are invalidated, so callers only hold on to indices.
+//#==============================================================================
+static int allocateNodes(tagOctree* tree, int count)
+{
+  if(tree->nodeCount + count > tree->nodeCapacity)
+  {
+    int capacity = tree->nodeCapacity * 2;
+    if(capacity < tree->nodeCount + count) capacity = tree->nodeCount + count + 64;
+    tree->nodes = (tagOctreeNode*)growMemory(tree->nodes,
+                    sizeof(tagOctreeNode) * (unsigned long)capacity);
+    tree->nodeCapacity = capacity;
+  }
+  int first = tree->nodeCount;
+  tree->nodeCount += count;
+  return first;
+}
+
+//#==============================================================================
+//# * addQuadrupole
+//#------------------------------------------------------------------------------
+//# Adds the quadrupole of mass m at offset (dx, dy, dz) from the centre of mass
+//#==============================================================================
+static void addQuadrupole(tagOctreeNode* node, double m,
+                          double dx, double dy, double dz)
+{
+  double r2 = dx*dx + dy*dy + dz*dz;
+  node->qxx += m * (3*dx*dx - r2);
+  node->qyy += m * (3*dy*dy - r2);
+  node->qzz += m * (3*dz*dz - r2);
+  node->qxy += m * 3*dx*dy;
+  node->qxz += m * 3*dx*dz;
+  node->qyz += m * 3*dy*dz;
+}
+
+//#==============================================================================
+//# * computeMoments
+//#------------------------------------------------------------------------------
+//# Fills in the mass, centre of mass, quadrupole and opening distance of a
+//# node whose children (if any) are already done.
+//#==============================================================================
+static void computeMoments(tagOctree* tree, const tagBodies* bodies, int index)
+{
+  tagOctreeNode* node = &tree->nodes[index];
+  double mass = 0, mx = 0, my = 0, mz = 0;
+
+  if(node->leaf)
+  {
+    for( int k = node->first; k < node->first + node->count; k++)
+    {
+      int j = tree->order[k];
+      mass += bodies->mass[j];
+      mx   += bodies->mass[j] * bodies->x[j];
+      my   += bodies->mass[j] * bodies->y[j];
+      mz   += bodies->mass[j] * bodies->z[j];
+    }
+  }
+  else
+  {
+    for( int c = node->first; c < node->first + node->count; c++)
+    {
+      const tagOctreeNode* child = &tree->nodes[c];
+      mass += child->mass;
+      mx   += child->mass * child->mx;
+      my   += child->mass * child->my;
+      mz   += child->mass * child->mz;
+    }
+  }
+
+  node->mass = mass;
+  if(mass > 0)
+  {
+    node->mx = mx / mass;  node->my = my / mass;  node->mz = mz / mass;
+  }
+  else
+  {
+    node->mx = node->cx;   node->my = node->cy;   node->mz = node->cz;
+  }
+
+  node->qxx = node->qyy = node->qzz = node->qxy = node->qxz = node->qyz = 0;
+  if(tree->multipole == OCTREE_QUADRUPOLE)
+  {
+    if(node->leaf)
+    {
+      for( int k = node->first; k < node->first + node->count; k++)
+      {
+        int j = tree->order[k];
+        addQuadrupole(node, bodies->mass[j], bodies->x[j] - node->mx,
+                      bodies->y[j] - node->my, bodies->z[j] - node->mz);
+      }
+    }
+    else
+    {
+      // parallel axis theorem: the child's own moment plus its offset
+      for( int c = node->first; c < node->first + node->count; c++)
+      {
+        const tagOctreeNode* child = &tree->nodes[c];
+        node->qxx += child->qxx;  node->qyy += child->qyy;  node->qzz += child->qzz;
+        node->qxy += child->qxy;  node->qxz += child->qxz;  node->qyz += child->qyz;
+        addQuadrupole(node, child->mass, child->mx - node->mx,
+                      child->my - node->my, child->mz - node->mz);
+      }
+    }
+  }
+
+  // Barnes' criterion: open when closer than size/theta plus how far the
+  // centre of mass sits from the middle of the cube.
+  double ox = node->mx - node->cx, oy = node->my - node->cy, oz = node->mz - node->cz;
+  double open = 2 * node->half / tree->theta + sqrt(ox*ox + oy*oy + oz*oz);
+  node->open2 = open * open;
+}
+
+//#==============================================================================
+//# * addLeaf
+//#------------------------------------------------------------------------------
+//# Records a finished leaf: remembers its index, copies its bodies into the
+//# sorted arrays and measures the box they fit in
+//#==============================================================================
+static void addLeaf(tagOctree* tree, const tagBodies* bodies, int index)
+{
+  if(tree->leafCount == tree->leafCapacity)
+  {
+    tree->leafCapacity = tree->leafCapacity * 2 + 64;
+    tree->leaves = (int*)growMemory(tree->leaves,
+                     sizeof(int) * (unsigned long)tree->leafCapacity);
+  }
+  tree->leaves[tree->leafCount++] = index;
+
+  tagOctreeNode* node = &tree->nodes[index];
+  node->lox = node->hix = node->cx;
+  node->loy = node->hiy = node->cy;
+  node->loz = node->hiz = node->cz;
+  for( int k = node->first; k < node->first + node->count; k++)
+  {
+    int j = tree->order[k];
+    tree->sx[k] = bodies->x[j];
+    tree->sy[k] = bodies->y[j];
+    tree->sz[k] = bodies->z[j];
+    tree->sm[k] = bodies->mass[j];
+    if(k == node->first)
+    {
+      node->lox = node->hix = tree->sx[k];
+      node->loy = node->hiy = tree->sy[k];
+      node->loz = node->hiz = tree->sz[k];
+    }
+    node->lox = tree->sx[k] < node->lox ? tree->sx[k] : node->lox;
+    node->hix = tree->sx[k] > node->hix ? tree->sx[k] : node->hix;
+    node->loy = tree->sy[k] < node->loy ? tree->sy[k] : node->loy;
+    node->hiy = tree->sy[k] > node->hiy ? tree->sy[k] : node->hiy;
+    node->loz = tree->sz[k] < node->loz ? tree->sz[k] : node->loz;
+    node->hiz = tree->sz[k] > node->hiz ? tree->sz[k] : node->hiz;
+  }
+}
+
+//#==============================================================================
+//# * octantOf
+//#------------------------------------------------------------------------------
+//# Which of the eight octants around (cx, cy, cz) body j is in (bit 0 for x,
+//# bit 1 for y, bit 2 for z)
+//#==============================================================================
+static inline int octantOf(const tagBodies* bodies, int j,
+                           double cx, double cy, double cz)
+{
+  return (bodies->x[j] >= cx) | (bodies->y[j] >= cy) << 1 | (bodies->z[j] >= cz) << 2;
+}
+
+//#==============================================================================
+//# * buildNode
+//#------------------------------------------------------------------------------
+//# Splits order[begin, end) among the octants of a node, recursing until each
+//# leaf is small enough
+//#==============================================================================
+static void buildNode(tagOctree* tree, const tagBodies* bodies, int index,
+                      int begin, int end, int depth)
+{
+  tagOctreeNode* node = &tree->nodes[index];
+  if(end - begin <= OCTREE_LEAF_SIZE || depth >= OCTREE_MAX_DEPTH)
+  {
+    node->leaf  = 1;
+    node->first = begin;
+    node->count = end - begin;
+    computeMoments(tree, bodies, index);
+    addLeaf(tree, bodies, index);
+    return;
+  }
+
+  const double cx = node->cx, cy = node->cy, cz = node->cz;
+  const double half = node->half * 0.5;
+  int counts[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  for( int k = begin; k < end; k++)
+  {
+    int j = tree->order[k];
+    counts[octantOf(bodies, j, cx, cy, cz)]++;
+  }
+
+  // counting sort of the range by octant, through the scratch buffer
+  int offsets[8], children = 0;
+  for( int o = 0, offset = begin; o < 8; o++)
+  {
+    offsets[o] = offset;
+    offset    += counts[o];
+    if(counts[o] > 0) children++;
+  }
+  for( int k = begin; k < end; k++)
+  {
+    int j = tree->order[k];
+    tree->scratch[offsets[octantOf(bodies, j, cx, cy, cz)]++] = j;
+  }
+  memcpy(tree->order + begin, tree->scratch + begin,
+         sizeof(int) * (unsigned long)(end - begin));
+
+  int first = allocateNodes(tree, children);
+  node = &tree->nodes[index];   // nodes may have moved
+  node->leaf  = 0;
+  node->first = first;
+  node->count = children;
+
+  int child = first, start = begin;
+  for( int o = 0; o < 8; o++)
+  {
+    if(counts[o] == 0) continue;
+    tagOctreeNode* c = &tree->nodes[child];
+    c->cx   = cx + ((o & 1) ? half : -half);
+    c->cy   = cy + ((o & 2) ? half : -half);
+    c->cz   = cz + ((o & 4) ? half : -half);
+    c->half = half;
+    buildNode(tree, bodies, child, start, start + counts[o], depth + 1);
+    start += counts[o];
+    child++;
+  }
+  computeMoments(tree, bodies, index);
+}
+
+//#==============================================================================
+//# * octreeBuild
+//#------------------------------------------------------------------------------
+//# Rebuilds the tree around the current positions of the bodies
+//#==============================================================================
+void octreeBuild(tagOctree* tree, const tagBodies* bodies)
+{
+  const int count = bodies->count;
+  if(count > tree->bodyCapacity)
+  {
+    tree->order   = (int*)growMemory(tree->order,   sizeof(int) * (unsigned long)count);
+    tree->scratch = (int*)growMemory(tree->scratch, sizeof(int) * (unsigned long)count);
+    if(tree->sx != NULL)
+    {
+      alignedFree(tree->sx);  alignedFree(tree->sy);
+      alignedFree(tree->sz);  alignedFree(tree->sm);
+    }
+    tree->sx = (double*)alignedAlloc(sizeof(double) * (unsigned long)count);
+    tree->sy = (double*)alignedAlloc(sizeof(double) * (unsigned long)count);
+    tree->sz = (double*)alignedAlloc(sizeof(double) * (unsigned long)count);
+    tree->sm = (double*)alignedAlloc(sizeof(double) * (unsigned long)count);
+    tree->bodyCapacity = count;
+  }
+  for( int i = 0; i < count; i++) tree->order[i] = i;
+
+  // the root is the smallest cube around every body
+  double lo[3] = { 0, 0, 0 }, hi[3] = { 0, 0, 0 };
+  if(count > 0)
+  {
+    lo[0] = hi[0] = bodies->x[0];
+    lo[1] = hi[1] = bodies->y[0];
+    lo[2] = hi[2] = bodies->z[0];
+  }
+  for( int i = 1; i < count; i++)
+  {
+    lo[0] = bodies->x[i] < lo[0] ? bodies->x[i] : lo[0];
+    hi[0] = bodies->x[i] > hi[0] ? bodies->x[i] : hi[0];
+    lo[1] = bodies->y[i] < lo[1] ? bodies->y[i] : lo[1];
+    hi[1] = bodies->y[i] > hi[1] ? bodies->y[i] : hi[1];
+    lo[2] = bodies->z[i] < lo[2] ? bodies->z[i] : lo[2];
+    hi[2] = bodies->z[i] > hi[2] ? bodies->z[i] : hi[2];
+  }
+  double half = 0;
+  for( int a = 0; a < 3; a++)
+  {
+    if((hi[a] - lo[a]) * 0.5 > half) half = (hi[a] - lo[a]) * 0.5;
+  }
+
+  tree->nodeCount = 0;
+  tree->leafCount = 0;
+  int root = allocateNodes(tree, 1);
+  tree->nodes[root].cx   = (lo[0] + hi[0]) * 0.5;
+  tree->nodes[root].cy   = (lo[1] + hi[1]) * 0.5;
+  tree->nodes[root].cz   = (lo[2] + hi[2]) * 0.5;
+  tree->nodes[root].half = half * (1 + 1E-9) + 1;   // keep edges inside
+  buildNode(tree, bodies, root, 0, count, 0);
+
+  // a leaf's walk lists each node at most once, so nodeCount bounds both lists
+  long long lists = 2LL * tree->nodeCount * threadPoolSize();
+  if(lists > tree->listCapacity)
+  {
+    tree->lists = (int*)growMemory(tree->lists, sizeof(int) * (unsigned long)lists);
+    tree->listCapacity = (int)lists;
+  }
+}
+
+//#==============================================================================
+//# * boxDistance2
+//#------------------------------------------------------------------------------
+//# Squared distance from a point to the nearest part of a leaf's box (zero if
+//# the point is inside it)
+//#==============================================================================
+static inline double boxDistance2(const tagOctreeNode* leaf,
+                                  double x, double y, double z)
+{
+  double dx = x < leaf->lox ? leaf->lox - x : (x > leaf->hix ? x - leaf->hix : 0);
+  double dy = y < leaf->loy ? leaf->loy - y : (y > leaf->hiy ? y - leaf->hiy : 0);
+  double dz = z < leaf->loz ? leaf->loz - z : (z > leaf->hiz ? z - leaf->hiz : 0);
+  return dx*dx + dy*dy + dz*dz;
+}
+
+//#==============================================================================
+//# * octreeAccelerations
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of the bodies in leaves [leafBegin, leafEnd). The tree is
+//# walked once per leaf: a node is used as a whole if it is far enough away
+//# from every point of the leaf's box, so the list of nodes and nearby bodies
+//# that comes out of the walk is valid for all of the leaf's bodies. The
+//# lists are the calling pool thread's pair from octreeBuild, so the pool
+//# must not be resized between the build and the walk.
+//#==============================================================================
+void octreeAccelerations(const tagOctree* tree, tagBodies* bodies,
+                         int leafBegin, int leafEnd)
+{
+  const tagOctreeNode* nodes = tree->nodes;
+  const double G = gravity_constant;
+  const bool quadrupole = tree->multipole == OCTREE_QUADRUPOLE;
+  const double* sx = tree->sx;
+  const double* sy = tree->sy;
+  const double* sz = tree->sz;
+  const double* sm = tree->sm;
+  int stack[8 * OCTREE_MAX_DEPTH + 8];
+
+  int* far  = tree->lists + 2L * tree->nodeCount * threadPoolWorker();
+  int* near = far + tree->nodeCount;
+
+  for( int l = leafBegin; l < leafEnd; l++)
+  {
+    const tagOctreeNode* leaf = &nodes[tree->leaves[l]];
+    int farCount = 0, nearCount = 0, top = 0;
+    stack[top++] = 0;
+
+    // build the interaction lists for this leaf
+    while(top > 0)
+    {
+      int index = stack[--top];
+      const tagOctreeNode* node = &nodes[index];
+      if(node->mass == 0) continue;
+
+      if(boxDistance2(leaf, node->mx, node->my, node->mz) > node->open2)
+      {
+        far[farCount++] = index;
+      }
+      else if(node->leaf)
+      {
+        near[nearCount++] = index;
+      }
+      else
+      {
+        for( int c = node->first; c < node->first + node->count; c++)
+        {
+          stack[top++] = c;
+        }
+      }
+    }
+
+    // then apply them to every body of the leaf
+    for( int k = leaf->first; k < leaf->first + leaf->count; k++)
+    {
+      const double xi = sx[k], yi = sy[k], zi = sz[k];
+      double axi = 0, ayi = 0, azi = 0;
+
+      for( int f = 0; f < farCount; f++)
+      {
+        // far away: pull of the total mass at the centre of mass
+        const tagOctreeNode* node = &nodes[far[f]];
+        double dx = node->mx - xi, dy = node->my - yi, dz = node->mz - zi;
+        double r2 = dx*dx + dy*dy + dz*dz;
+        double inv_r  = 1.0 / sqrt(r2);
+        double inv_r3 = inv_r * inv_r * inv_r;
+        double s = G * node->mass * inv_r3;
+        axi += dx * s;  ayi += dy * s;  azi += dz * s;
+        if(quadrupole)
+        {
+          // a = G (Q r / r^5 - 5/2 (r.Q.r) r / r^7), r from the centre of mass
+          double rx = -dx, ry = -dy, rz = -dz;
+          double qrx = node->qxx*rx + node->qxy*ry + node->qxz*rz;
+          double qry = node->qxy*rx + node->qyy*ry + node->qyz*rz;
+          double qrz = node->qxz*rx + node->qyz*ry + node->qzz*rz;
+          double rqr = rx*qrx + ry*qry + rz*qrz;
+          double inv_r5 = inv_r3 * inv_r * inv_r;
+          double inv_r7 = inv_r5 * inv_r * inv_r;
+          axi += G * (qrx * inv_r5 - 2.5 * rqr * rx * inv_r7);
+          ayi += G * (qry * inv_r5 - 2.5 * rqr * ry * inv_r7);
+          azi += G * (qrz * inv_r5 - 2.5 * rqr * rz * inv_r7);
+        }
+      }
+
+      for( int n = 0; n < nearCount; n++)
+      {
+        // close by: sum the bodies of the leaf one by one
+        const tagOctreeNode* node = &nodes[near[n]];
+        const int end = node->first + node->count;
+        for( int m = node->first; m < end; m++)
+        {
+          if(m == k) continue;
+          double dx = sx[m] - xi, dy = sy[m] - yi, dz = sz[m] - zi;
+          double r2 = dx*dx + dy*dy + dz*dz;
+          double inv_r = 1.0 / sqrt(r2);
+          double s = G * sm[m] * inv_r * inv_r * inv_r;
+          axi += dx * s;  ayi += dy * s;  azi += dz * s;
+        }
+      }
+
+      int i = tree->order[k];
+      bodies->ax[i] = axi;
+      bodies->ay[i] = ayi;
+      bodies->az[i] = azi;
+    }
+  }
+}
+
+//#==============================================================================
+//# * octreeMultipoleName / octreeParseMultipole
+//#------------------------------------------------------------------------------
+//# Converts between multipole orders and the names used on the command line.
+//# Parsing returns -1 for a name it doesn't know.
+//#==============================================================================
+const char* octreeMultipoleName(int multipole)
+{
+  return multipole == OCTREE_QUADRUPOLE ? "quadrupole" : "monopole";
+}
+
+int octreeParseMultipole(const char* name)
+{
+  if(strcmp(name, "monopole")   == 0) return OCTREE_MONOPOLE;
+  if(strcmp(name, "quadrupole") == 0) return OCTREE_QUADRUPOLE;
+  return -1;
+}
@@ -0,0 +1,85 @@
+/*
+#================================================================================
+# * Octree                  Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Barnes-Hut tree. Space is split into cubes of eight octants until each cube
+# holds only a few bodies; distant cubes are then treated as a single body (or
+# a body plus a quadrupole correction) so the cost per step is O(N log N)
+# instead of O(N^2). The tree is walked once per leaf rather than once per
+# body, and the resulting interaction list is shared by the leaf's bodies.
+#================================================================================
+*/
+#ifndef SOLAR_OCTREE_H
+#define SOLAR_OCTREE_H
+
+#include "bodies.h"
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define OCTREE_LEAF_SIZE 16   // most bodies kept in a leaf before splitting
+#define OCTREE_MAX_DEPTH 48   // stop splitting (coincident bodies)
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of multipole orders
+enum
+{
+  OCTREE_MONOPOLE = 0,   // centre of mass only
+  OCTREE_QUADRUPOLE      // centre of mass plus the quadrupole moment
+};
+
+// tagOctreeNode
+typedef struct
+{
+  double cx, cy, cz, half;  // centre and half width of the cube
+  double mx, my, mz, mass;  // centre of mass and total mass
+  double qxx, qyy, qzz;     // traceless quadrupole moment about the centre
+  double qxy, qxz, qyz;     //   of mass (only filled in for OCTREE_QUADRUPOLE)
+  double open2;             // open the node when closer than sqrt(open2)
+  double lox, loy, loz;     // tight box around the bodies (leaves only)
+  double hix, hiy, hiz;
+  int    first;             // first child node, or first entry of order[]
+  int    count;             // number of children, or bodies in a leaf
+  int    leaf;              // does this node hold bodies directly?
+}tagOctreeNode;
+
+// tagOctree
+typedef struct
+{
+  tagOctreeNode* nodes;     // nodes[0] is the root
+  int            nodeCount;
+  int            nodeCapacity;
+  int*           order;     // body indices, grouped so each node is a range
+  int*           scratch;   // partition buffer
+  double*        sx;        // positions and masses copied in order[] order
+  double*        sy;        //   so that leaves are contiguous
+  double*        sz;
+  double*        sm;
+  int            bodyCapacity;
+  int*           leaves;    // index of every leaf node
+  int            leafCount;
+  int            leafCapacity;
+  int*           lists;     // far and near list for each pool thread
+  int            listCapacity;
+  double         theta;     // opening angle
+  int            multipole; // OCTREE_MONOPOLE or OCTREE_QUADRUPOLE
+}tagOctree;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void octreeCreate        ( tagOctree* tree, double theta, int multipole );
+void octreeDestroy       ( tagOctree* tree );
+void octreeBuild         ( tagOctree* tree, const tagBodies* bodies );
+void octreeAccelerations ( const tagOctree* tree, tagBodies* bodies,
+                           int leafBegin, int leafEnd );
+
+const char* octreeMultipoleName  ( int multipole );
+int         octreeParseMultipole ( const char* name );
+
+#endif // SOLAR_OCTREE_H
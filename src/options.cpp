@@ -0,0 +1,624 @@
+/*
+#================================================================================
+# * Options                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Command line parsing for the simulator
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "options.h"
+#include "gravity.h"
+#include "physics.h"
+#include "octree.h"
+#include "integrator.h"
+#include "telemetry.h"
+#include "precision.h"
+#include "trajectory.h"
+#include "ephemeris.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for strtol/strtod
+#include <string.h>       // Header File for strcmp
+#include <math.h>         // Header File for floor
+
+//#==============================================================================
+//# * parseLong / parseDouble / parseString
+//#------------------------------------------------------------------------------
+//# Reads the value following an option, failing if it is missing or malformed
+//#==============================================================================
+static bool parseLong(int argc, char** argv, int* i, long* out)
+{
+  if(*i + 1 >= argc)
+  {
+    fprintf(stderr, "%s: missing value\n", argv[*i]);
+    return false;
+  }
+  char* end = NULL;
+  *out = strtol(argv[*i + 1], &end, 10);
+  if(end == argv[*i + 1] || *end != '\0')
+  {
+    fprintf(stderr, "%s: '%s' is not an integer\n", argv[*i], argv[*i + 1]);
+    return false;
+  }
+  ++*i;
+  return true;
+}
+
+static bool parseDouble(int argc, char** argv, int* i, double* out)
+{
+  if(*i + 1 >= argc)
+  {
+    fprintf(stderr, "%s: missing value\n", argv[*i]);
+    return false;
+  }
+  char* end = NULL;
+  *out = strtod(argv[*i + 1], &end);
+  if(end == argv[*i + 1] || *end != '\0')
+  {
+    fprintf(stderr, "%s: '%s' is not a number\n", argv[*i], argv[*i + 1]);
+    return false;
+  }
+  ++*i;
+  return true;
+}
+
+static bool parseString(int argc, char** argv, int* i, const char** out)
+{
+  if(*i + 1 >= argc)
+  {
+    fprintf(stderr, "%s: missing value\n", argv[*i]);
+    return false;
+  }
+  *out = argv[++*i];
+  return true;
+}
+
+//#==============================================================================
+//# * optionsDefault
+//#------------------------------------------------------------------------------
+//# Same behaviour as before there were any options: a window, one day per step
+//#==============================================================================
+void optionsDefault(tagOptions* options)
+{
+  options->headless = false;
+  options->steps    = 36525;   // one hundred years of days
+  options->dt       = 86400;   // the interval for calculation (1 day)
+  options->belt     = 0;
+  options->particles = 0;
+  options->kernel   = GRAVITY_KERNEL_AUTO;
+  options->precision = PRECISION_NATIVE;
+  options->solver   = SOLVER_DIRECT;
+  options->theta    = 0.5;
+  options->multipole = OCTREE_QUADRUPOLE;
+  options->accuracy = false;
+  options->threads  = 0;
+  options->rate     = 60;
+  options->integrator = INTEGRATOR_EULER;
+  options->tolerance  = 1E-10;
+  options->eta        = BLOCK_ETA;
+  options->telemetry     = TELEMETRY_STDOUT;
+  options->telemetryPath = NULL;
+  options->telemetryRate = 4;
+  options->hud           = false;
+  options->record        = NULL;
+  options->recordEvery   = 1;
+  options->recordFormat  = TRAJECTORY_F32;
+  options->replay        = NULL;
+  options->checkpoint      = NULL;
+  options->checkpointEvery = 3653;   // ten years of days
+  options->resume          = false;
+  options->catalogCount    = 0;
+  options->massiveAbove    = 0;
+  options->saveCatalog     = NULL;
+  options->ephemeris       = NULL;
+  options->ephemerisDays   = 16;
+  options->ephemerisDegree = 12;
+  options->at              = -1;
+  options->ensemble        = 0;
+  options->ensembleSigma   = 1000;
+  options->trace           = NULL;
+  options->collisions      = false;
+  options->share           = NULL;
+}
+
+//#==============================================================================
+//# * optionsParse
+//#------------------------------------------------------------------------------
+//# Fills in the options from the command line. Returns false (after printing
+//# why) if something could not be understood.
+//#==============================================================================
+bool optionsParse(tagOptions* options, int argc, char** argv)
+{
+  for( int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    if(strncmp(arg, "--", 2) != 0) continue; // leave it for GLUT
+
+    if(strcmp(arg, "--headless") == 0)
+    {
+      options->headless = true;
+    }
+    else if(strcmp(arg, "--steps") == 0)
+    {
+      if(!parseLong(argc, argv, &i, &options->steps)) return false;
+      if(options->steps < 0)
+      {
+        fprintf(stderr, "--steps: must not be negative\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--dt") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->dt)) return false;
+      if(!(options->dt > 0))
+      {
+        fprintf(stderr, "--dt: must be greater than zero\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--belt") == 0)
+    {
+      long belt = 0;
+      if(!parseLong(argc, argv, &i, &belt)) return false;
+      if(belt < 0 || belt > 100000000)
+      {
+        fprintf(stderr, "--belt: must be between 0 and 100000000\n");
+        return false;
+      }
+      options->belt = (int)belt;
+    }
+    else if(strcmp(arg, "--particles") == 0)
+    {
+      long particles = 0;
+      if(!parseLong(argc, argv, &i, &particles)) return false;
+      if(particles < 0 || particles > 100000000)
+      {
+        fprintf(stderr, "--particles: must be between 0 and 100000000\n");
+        return false;
+      }
+      options->particles = (int)particles;
+    }
+    else if(strcmp(arg, "--kernel") == 0)
+    {
+      const char* name = NULL;
+      if(!parseString(argc, argv, &i, &name)) return false;
+      options->kernel = gravityParseKernel(name);
+      if(options->kernel < 0)
+      {
+        fprintf(stderr, "--kernel: unknown kernel '%s'\n", name);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--precision") == 0)
+    {
+      const char* name = NULL;
+      if(!parseString(argc, argv, &i, &name)) return false;
+      options->precision = precisionParse(name);
+      if(options->precision < 0)
+      {
+        fprintf(stderr, "--precision: unknown precision '%s'\n", name);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--solver") == 0)
+    {
+      const char* name = NULL;
+      if(!parseString(argc, argv, &i, &name)) return false;
+      options->solver = physicsParseSolver(name);
+      if(options->solver < 0)
+      {
+        fprintf(stderr, "--solver: unknown solver '%s'\n", name);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--theta") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->theta)) return false;
+      if(!(options->theta > 0 && options->theta <= 1))
+      {
+        fprintf(stderr, "--theta: must be greater than 0 and at most 1\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--multipole") == 0)
+    {
+      const char* name = NULL;
+      if(!parseString(argc, argv, &i, &name)) return false;
+      options->multipole = octreeParseMultipole(name);
+      if(options->multipole < 0)
+      {
+        fprintf(stderr, "--multipole: unknown order '%s'\n", name);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--accuracy-report") == 0)
+    {
+      options->accuracy = true;
+      options->headless = true;
+    }
+    else if(strcmp(arg, "--threads") == 0)
+    {
+      long threads = 0;
+      if(!parseLong(argc, argv, &i, &threads)) return false;
+      if(threads < 0 || threads > 1024)
+      {
+        fprintf(stderr, "--threads: must be between 0 and 1024\n");
+        return false;
+      }
+      options->threads = (int)threads;
+    }
+    else if(strcmp(arg, "--rate") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->rate)) return false;
+      if(!(options->rate > 0))
+      {
+        fprintf(stderr, "--rate: must be greater than zero\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--integrator") == 0)
+    {
+      const char* name = NULL;
+      if(!parseString(argc, argv, &i, &name)) return false;
+      options->integrator = integratorParse(name);
+      if(options->integrator < 0)
+      {
+        fprintf(stderr, "--integrator: unknown integrator '%s'\n", name);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--tolerance") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->tolerance)) return false;
+      if(!(options->tolerance > 0 && options->tolerance < 1))
+      {
+        fprintf(stderr, "--tolerance: must be greater than 0 and less than 1\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--eta") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->eta)) return false;
+      if(!(options->eta > 0 && options->eta <= 1))
+      {
+        fprintf(stderr, "--eta: must be greater than 0 and at most 1\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--telemetry") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->telemetryPath)) return false;
+      options->telemetry = telemetryParseSink(options->telemetryPath);
+    }
+    else if(strcmp(arg, "--telemetry-rate") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->telemetryRate)) return false;
+      if(!(options->telemetryRate > 0 && options->telemetryRate <= 1000))
+      {
+        fprintf(stderr, "--telemetry-rate: must be greater than 0 and at most 1000\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--hud") == 0)
+    {
+      options->hud = true;
+    }
+    else if(strcmp(arg, "--record") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->record)) return false;
+    }
+    else if(strcmp(arg, "--record-every") == 0)
+    {
+      long every = 0;
+      if(!parseLong(argc, argv, &i, &every)) return false;
+      if(every < 1 || every > 1000000)
+      {
+        fprintf(stderr, "--record-every: must be between 1 and 1000000\n");
+        return false;
+      }
+      options->recordEvery = (int)every;
+    }
+    else if(strcmp(arg, "--record-format") == 0)
+    {
+      const char* name = NULL;
+      if(!parseString(argc, argv, &i, &name)) return false;
+      options->recordFormat = trajectoryParseFormat(name);
+      if(options->recordFormat < 0)
+      {
+        fprintf(stderr, "--record-format: unknown format '%s'\n", name);
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--replay") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->replay)) return false;
+    }
+    else if(strcmp(arg, "--checkpoint") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->checkpoint)) return false;
+    }
+    else if(strcmp(arg, "--checkpoint-every") == 0)
+    {
+      if(!parseLong(argc, argv, &i, &options->checkpointEvery)) return false;
+      if(options->checkpointEvery < 1)
+      {
+        fprintf(stderr, "--checkpoint-every: must be at least 1\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--resume") == 0)
+    {
+      options->resume = true;
+    }
+    else if(strcmp(arg, "--catalog") == 0)
+    {
+      const char* path = NULL;
+      if(!parseString(argc, argv, &i, &path)) return false;
+      if(options->catalogCount == OPTIONS_CATALOGS)
+      {
+        fprintf(stderr, "--catalog: at most %d catalogs\n", OPTIONS_CATALOGS);
+        return false;
+      }
+      options->catalogs[options->catalogCount++] = path;
+    }
+    else if(strcmp(arg, "--massive-above") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->massiveAbove)) return false;
+      if(!(options->massiveAbove >= 0))
+      {
+        fprintf(stderr, "--massive-above: must not be negative\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--save-catalog") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->saveCatalog)) return false;
+    }
+    else if(strcmp(arg, "--ephemeris") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->ephemeris)) return false;
+    }
+    else if(strcmp(arg, "--ephemeris-days") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->ephemerisDays)) return false;
+      if(!(options->ephemerisDays > 0))
+      {
+        fprintf(stderr, "--ephemeris-days: must be greater than zero\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--ephemeris-degree") == 0)
+    {
+      long degree = 0;
+      if(!parseLong(argc, argv, &i, &degree)) return false;
+      if(degree < 1 || degree > EPHEMERIS_MAX_DEGREE)
+      {
+        fprintf(stderr, "--ephemeris-degree: must be between 1 and %d\n", EPHEMERIS_MAX_DEGREE);
+        return false;
+      }
+      options->ephemerisDegree = (int)degree;
+    }
+    else if(strcmp(arg, "--ensemble") == 0)
+    {
+      long copies = 0;
+      if(!parseLong(argc, argv, &i, &copies)) return false;
+      if(copies < 1 || copies > 1000000)
+      {
+        fprintf(stderr, "--ensemble: must be between 1 and 1000000\n");
+        return false;
+      }
+      options->ensemble = (int)copies;
+      options->headless = true;
+    }
+    else if(strcmp(arg, "--ensemble-sigma") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->ensembleSigma)) return false;
+      if(!(options->ensembleSigma >= 0))
+      {
+        fprintf(stderr, "--ensemble-sigma: must not be negative\n");
+        return false;
+      }
+    }
+    else if(strcmp(arg, "--collisions") == 0)
+    {
+      options->collisions = true;
+    }
+    else if(strcmp(arg, "--share") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->share)) return false;
+#ifdef _WIN32
+      fprintf(stderr, "--share: needs POSIX shared memory, which this platform doesn't have\n");
+      return false;
+#endif
+    }
+    else if(strcmp(arg, "--trace") == 0)
+    {
+      if(!parseString(argc, argv, &i, &options->trace)) return false;
+#ifndef SOLAR_PROFILE
+      fprintf(stderr, "--trace: this build has no timing zones (configure with -DSOLAR_PROFILE=ON)\n");
+      return false;
+#endif
+    }
+    else if(strcmp(arg, "--at") == 0)
+    {
+      if(!parseDouble(argc, argv, &i, &options->at)) return false;
+      if(!(options->at >= 0))
+      {
+        fprintf(stderr, "--at: must not be negative\n");
+        return false;
+      }
+    }
+    else
+    {
+      fprintf(stderr, "unknown option '%s'\n", arg);
+      return false;
+    }
+  }
+  if(options->record != NULL && options->replay != NULL)
+  {
+    fprintf(stderr, "--record and --replay can't be used together\n");
+    return false;
+  }
+  if(options->resume && options->checkpoint == NULL)
+  {
+    fprintf(stderr, "--resume: needs --checkpoint FILE to resume from\n");
+    return false;
+  }
+  if(options->checkpoint != NULL && (options->replay != NULL || options->accuracy))
+  {
+    fprintf(stderr, "--checkpoint: only applies when the physics is running\n");
+    return false;
+  }
+  if(options->ephemeris != NULL && (options->record != NULL || options->replay != NULL ||
+                                    options->checkpoint != NULL || options->accuracy))
+  {
+    fprintf(stderr, "--ephemeris: can't be used with --record, --replay, --checkpoint "
+                    "or --accuracy-report\n");
+    return false;
+  }
+  if(options->ensemble > 0 && (options->record != NULL || options->replay != NULL ||
+                                options->checkpoint != NULL || options->ephemeris != NULL ||
+                                options->accuracy || options->solver == SOLVER_TREE ||
+                                options->particles > 0))
+  {
+    fprintf(stderr, "--ensemble: sums every pair directly and keeps no files, so can't be used "
+                    "with --record, --replay, --checkpoint, --ephemeris, --accuracy-report, "
+                    "--solver tree or --particles\n");
+    return false;
+  }
+  if(options->precision != PRECISION_NATIVE &&
+     (options->solver == SOLVER_TREE || options->integrator == INTEGRATOR_BLOCK ||
+      options->ensemble > 0 || options->ephemeris != NULL))
+  {
+    fprintf(stderr, "--precision: only applies to the direct sum, so can't be used with "
+                    "--solver tree, --integrator block, --ensemble or --ephemeris\n");
+    return false;
+  }
+  if(options->integrator == INTEGRATOR_BLOCK && options->solver == SOLVER_TREE)
+  {
+    fprintf(stderr, "--integrator block: always sums directly, so can't be used with "
+                    "--solver tree\n");
+    return false;
+  }
+  if(options->collisions && (options->ensemble > 0 || options->ephemeris != NULL))
+  {
+    fprintf(stderr, "--collisions: needs a fixed set of bodies, so can't be used with "
+                    "--ensemble or --ephemeris\n");
+    return false;
+  }
+  if(options->share != NULL && (options->replay != NULL || options->ephemeris != NULL ||
+                                options->ensemble > 0 || options->accuracy))
+  {
+    fprintf(stderr, "--share: publishes the physics steps, so can't be used with --replay, "
+                    "--ephemeris, --ensemble or --accuracy-report\n");
+    return false;
+  }
+  if(options->at >= 0 && options->ephemeris == NULL)
+  {
+    fprintf(stderr, "--at: needs --ephemeris FILE to look the positions up in\n");
+    return false;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * optionsEphemerisSteps
+//#------------------------------------------------------------------------------
+//# Steps in each fitted ephemeris interval: --ephemeris-days rounded to whole
+//# steps of --dt, and never fewer than there are coefficients to fit
+//#==============================================================================
+int optionsEphemerisSteps(const tagOptions* options)
+{
+  double steps = floor(options->ephemerisDays * 86400 / options->dt + 0.5);
+  if(steps < options->ephemerisDegree) steps = options->ephemerisDegree;
+  return steps > 1000000 ? 1000000 : (int)steps;
+}
+
+//#==============================================================================
+//# * optionsUsage
+//#------------------------------------------------------------------------------
+//# Prints the list of options
+//#==============================================================================
+void optionsUsage(const char* program)
+{
+  fprintf(stderr,
+    "usage: %s [--headless] [--steps N] [--dt S] [--belt N] [--particles N]\n"
+    "          [--kernel auto|scalar|avx2|avx512]\n"
+    "          [--precision native|double|float|double-float]\n"
+    "          [--solver direct|tree] [--theta T] [--multipole monopole|quadrupole]\n"
+    "          [--accuracy-report] [--threads N] [--rate D]\n"
+    "          [--integrator euler|leapfrog|yoshida4|yoshida6|dopri|block]\n"
+    "          [--tolerance E] [--eta E]\n"
+    "          [--telemetry none|stdout|FILE] [--telemetry-rate HZ] [--hud]\n"
+    "          [--record FILE] [--record-every N] [--record-format f32|f16]\n"
+    "          [--replay FILE] [--checkpoint FILE] [--checkpoint-every N] [--resume]\n"
+    "          [--catalog FILE] [--massive-above KG] [--save-catalog FILE]\n"
+    "          [--ephemeris FILE] [--ephemeris-days D] [--ephemeris-degree N] [--at DAY]\n"
+    "          [--ensemble K] [--ensemble-sigma M] [--collisions] [--share NAME]\n"
+    "          [--trace FILE]\n"
+    "\n"
+    "  --headless         run the simulation without a window and report steps/s\n"
+    "  --steps N          number of steps to run in headless mode (default 36525)\n"
+    "  --dt S             size of each step in seconds (default 86400)\n"
+    "  --rate D           simulated days per second in the window (default 60)\n"
+    "  --belt N           add N asteroid belt bodies to the ten planets\n"
+    "  --particles N      add N massless test particles to the asteroid belt\n"
+    "  --kernel K         gravity kernel to use (default: the fastest supported)\n"
+    "  --precision P      scalar type of the direct force sum: native (the\n"
+    "                     kernel above, default), or the templated double,\n"
+    "                     float or double-float kernels\n"
+    "  --solver S         direct (every pair) or tree (Barnes-Hut), default direct\n"
+    "  --theta T          Barnes-Hut opening angle, 0 < T <= 1 (default 0.5)\n"
+    "  --multipole M      Barnes-Hut expansion order (default quadrupole)\n"
+    "  --accuracy-report  compare tree accelerations against direct summation\n"
+    "  --threads N        physics threads (default 0: one per hardware thread)\n"
+    "  --integrator I     how bodies are advanced each step (default euler)\n"
+    "  --tolerance E      relative error per sub-step for dopri (default 1e-10)\n"
+    "  --eta E            time step accuracy of block, smaller is finer (default 0.02)\n"
+    "  --telemetry T      where window statistics go: none, stdout (the newest)\n"
+    "                     or a file name (every frame, as CSV). Default stdout\n"
+    "  --telemetry-rate HZ\n"
+    "                     how often statistics are written (default 4)\n"
+    "  --hud              draw the statistics in the window\n"
+    "  --record FILE      write the bodies' positions and velocities to FILE\n"
+    "  --record-every N   keep one frame every N steps (default 1)\n"
+    "  --record-format F  f32 or f16 (half the size, coarser), default f32\n"
+    "  --replay FILE      play back a recording instead of simulating; with\n"
+    "                     --headless, describe it\n"
+    "  --checkpoint FILE  save the whole run to FILE every so often and at the end\n"
+    "  --checkpoint-every N\n"
+    "                     steps between checkpoints (default 3653)\n"
+    "  --resume           carry on from the --checkpoint file; --steps is the\n"
+    "                     total to reach, and dt, solver and integrator come\n"
+    "                     from the file\n"
+    "  --catalog FILE     start from a CSV or packed catalog instead of the\n"
+    "                     built-in sun and planets (more than one are loaded\n"
+    "                     in order, one after the other)\n"
+    "  --massive-above KG catalog rows this mass or lighter become test\n"
+    "                     particles (default 0: only massless ones)\n"
+    "  --save-catalog FILE\n"
+    "                     write the starting bodies and particles as a packed\n"
+    "                     catalog, which loads much faster than CSV\n"
+    "  --ephemeris FILE   integrate --steps steps once, fit them with Chebyshev\n"
+    "                     series and keep them in FILE (reused while the\n"
+    "                     bodies, dt and integrator match); the window then\n"
+    "                     draws from it at any speed and time\n"
+    "  --ephemeris-days D days covered by each fitted interval (default 16)\n"
+    "  --ephemeris-degree N\n"
+    "                     degree of the fitted series (default 12)\n"
+    "  --at DAY           with --headless, print every body's position and\n"
+    "                     velocity DAY days after the start\n"
+    "  --ensemble K       integrate K copies of the bodies side by side, all but\n"
+    "                     the first nudged at random, and report how they\n"
+    "                     spread apart (implies --headless)\n"
+    "  --ensemble-sigma M scatter of the copies' starting positions along each\n"
+    "                     axis, in meters (default 1000)\n"
+    "  --collisions       merge bodies that overlap after a step, conserving\n"
+    "                     mass and momentum\n"
+    "  --share NAME       publish every step to the shared memory segment NAME\n"
+    "                     for other processes (see shared_state.h)\n"
+    "  --trace FILE       write every timing zone to FILE as a Chrome trace\n"
+    "                     (chrome://tracing or ui.perfetto.dev)\n",
+    program);
+}
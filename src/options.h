@@ -0,0 +1,76 @@
+/*
+#================================================================================
+# * Options                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Command line options. Anything that doesn't start with "--" is left alone so
+# that GLUT can still pick up its own arguments (-display, -geometry, ...)
+#================================================================================
+*/
+#ifndef SOLAR_OPTIONS_H
+#define SOLAR_OPTIONS_H
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define OPTIONS_CATALOGS 8   // --catalog can be given this many times
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagOptions
+typedef struct
+{
+  bool   headless;   // run without a window or GL context
+  long   steps;      // number of steps to run in headless mode
+  double dt;         // step size (seconds) in headless mode
+  int    belt;       // number of asteroid belt bodies to add to the planets
+  int    particles;  // number of massless test particles to add
+  int    kernel;     // gravity kernel (GRAVITY_KERNEL_*)
+  int    precision;  // scalar type of the direct force sum (PRECISION_*)
+  int    solver;     // force solver (SOLVER_*)
+  double theta;      // Barnes-Hut opening angle
+  int    multipole;  // Barnes-Hut multipole order (OCTREE_*)
+  bool   accuracy;   // report tree accuracy against direct summation
+  int    threads;    // physics threads (0 = one per hardware thread)
+  double rate;       // simulated days per real second in the window at 1x
+  int    integrator; // how bodies are advanced (INTEGRATOR_*)
+  double tolerance;  // relative error per sub-step for INTEGRATOR_DOPRI
+  double eta;        // time step accuracy parameter for INTEGRATOR_BLOCK
+  int    telemetry;  // where the window's statistics go (TELEMETRY_*)
+  const char* telemetryPath; // file for TELEMETRY_FILE
+  double telemetryRate;      // statistics written per second
+  bool   hud;        // draw the statistics in the window
+  const char* record;        // trajectory file to write (NULL for none)
+  int    recordEvery;        // physics steps per recorded frame
+  int    recordFormat;       // how recorded values are stored (TRAJECTORY_*)
+  const char* replay;        // trajectory file to play back instead of simulating
+  const char* checkpoint;    // where the run is saved (NULL for nowhere)
+  long   checkpointEvery;    // steps between checkpoints
+  bool   resume;             // carry on from the checkpoint instead of 2011
+  const char* catalogs[OPTIONS_CATALOGS]; // initial conditions to load instead of 2011's
+  int    catalogCount;       // in the order given
+  double massiveAbove;       // catalog rows at or below this mass (kg) are test particles
+  const char* saveCatalog;   // where to write the starting state as a packed catalog
+  const char* ephemeris;     // Chebyshev cache to build or reuse and draw from
+  double ephemerisDays;      // days covered by each fitted interval
+  int    ephemerisDegree;    // degree of every fitted series
+  double at;                 // headless: day to print positions at (< 0 for none)
+  int    ensemble;           // perturbed copies to integrate together (0 for none)
+  double ensembleSigma;      // scatter of their starting positions (m)
+  const char* trace;         // Chrome trace of the timing zones (NULL for none)
+  bool   collisions;         // merge bodies that overlap after a step
+  const char* share;         // shared memory segment steps are published to (NULL for none)
+}tagOptions;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void optionsDefault        ( tagOptions* options );
+bool optionsParse          ( tagOptions* options, int argc, char** argv );
+void optionsUsage          ( const char* program );
+int  optionsEphemerisSteps ( const tagOptions* options );
+
+#endif // SOLAR_OPTIONS_H
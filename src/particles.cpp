@@ -0,0 +1,332 @@
+/*
+#================================================================================
+# * Particles               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Massless test particles moved by the massive bodies
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "particles.h"
+#include "gravity.h"
+#include "thread_pool.h"
+#include <math.h>         // Header File for the math library
+#include <string.h>       // Header File for memcpy/memset
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define PARTICLES_X86 1
+# include <immintrin.h>   // Header File for the AVX intrinsics
+#endif
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define PARTICLES_GRAIN 1024   // particles per parallel chunk
+
+// A range sets the accelerations of particles [begin, end) from every source
+typedef void (*ParticleRange)( tagParticles* particles, const tagBodies* sources,
+                               int begin, int end );
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagParticleTask - what the parallel loops need to know
+typedef struct
+{
+  tagParticles*    particles;
+  const tagBodies* sources;
+  double           interval;
+  ParticleRange    range;
+}tagParticleTask;
+
+//#==============================================================================
+//# * rangeScalar
+//#------------------------------------------------------------------------------
+//# Plain C++ version: one particle at a time against every source
+//#==============================================================================
+static void rangeScalar(tagParticles* particles, const tagBodies* sources,
+                        int begin, int end)
+{
+  const double* sx = sources->x;
+  const double* sy = sources->y;
+  const double* sz = sources->z;
+  const double* sm = sources->mass;
+  const int count  = sources->count;
+
+  for( int i = begin; i < end; i++)
+  {
+    const double xi = particles->x[i], yi = particles->y[i], zi = particles->z[i];
+    double axi = 0, ayi = 0, azi = 0;
+    for( int j = 0; j < count; j++)
+    {
+      double dx = sx[j] - xi;
+      double dy = sy[j] - yi;
+      double dz = sz[j] - zi;
+      double r2 = dx*dx + dy*dy + dz*dz;
+      double inv_r = 1.0 / sqrt(r2);
+      double s = gravity_constant * sm[j] * inv_r * inv_r * inv_r;
+      axi += dx * s;
+      ayi += dy * s;
+      azi += dz * s;
+    }
+    particles->ax[i] = axi;
+    particles->ay[i] = ayi;
+    particles->az[i] = azi;
+  }
+}
+
+#ifdef PARTICLES_X86
+//#==============================================================================
+//# * rangeAvx2
+//#------------------------------------------------------------------------------
+//# Four particles at a time, each source broadcast to all four. Sources are
+//# few and stay in L1, the particles stream through once.
+//#==============================================================================
+__attribute__((target("avx2,fma")))
+static void rangeAvx2(tagParticles* particles, const tagBodies* sources,
+                      int begin, int end)
+{
+  const double* sx = sources->x;
+  const double* sy = sources->y;
+  const double* sz = sources->z;
+  const double* sm = sources->mass;
+  const int count  = sources->count;
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  int i = begin;
+  for( ; i + 4 <= end; i += 4)
+  {
+    const __m256d xi = _mm256_loadu_pd(particles->x + i);
+    const __m256d yi = _mm256_loadu_pd(particles->y + i);
+    const __m256d zi = _mm256_loadu_pd(particles->z + i);
+    __m256d axi = _mm256_setzero_pd();
+    __m256d ayi = _mm256_setzero_pd();
+    __m256d azi = _mm256_setzero_pd();
+    for( int j = 0; j < count; j++)
+    {
+      __m256d dx = _mm256_sub_pd(_mm256_set1_pd(sx[j]), xi);
+      __m256d dy = _mm256_sub_pd(_mm256_set1_pd(sy[j]), yi);
+      __m256d dz = _mm256_sub_pd(_mm256_set1_pd(sz[j]), zi);
+      __m256d r2 = _mm256_fmadd_pd(dz, dz, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dx, dx)));
+      __m256d inv_r  = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+      __m256d inv_r3 = _mm256_mul_pd(_mm256_mul_pd(inv_r, inv_r), inv_r);
+      __m256d s = _mm256_mul_pd(_mm256_set1_pd(gravity_constant * sm[j]), inv_r3);
+      axi = _mm256_fmadd_pd(dx, s, axi);
+      ayi = _mm256_fmadd_pd(dy, s, ayi);
+      azi = _mm256_fmadd_pd(dz, s, azi);
+    }
+    _mm256_storeu_pd(particles->ax + i, axi);
+    _mm256_storeu_pd(particles->ay + i, ayi);
+    _mm256_storeu_pd(particles->az + i, azi);
+  }
+
+  if(i < end) rangeScalar(particles, sources, i, end);  // leftovers
+}
+
+//#==============================================================================
+//# * rangeAvx512
+//#------------------------------------------------------------------------------
+//# Eight particles at a time, with the same reciprocal square root estimate
+//# and Newton-Raphson steps as the massive kernel
+//#==============================================================================
+__attribute__((target("avx512f")))
+static void rangeAvx512(tagParticles* particles, const tagBodies* sources,
+                        int begin, int end)
+{
+  const double* sx = sources->x;
+  const double* sy = sources->y;
+  const double* sz = sources->z;
+  const double* sm = sources->mass;
+  const int count  = sources->count;
+  const __m512d half  = _mm512_set1_pd(0.5);
+  const __m512d three = _mm512_set1_pd(1.5);
+
+  int i = begin;
+  for( ; i + 8 <= end; i += 8)
+  {
+    const __m512d xi = _mm512_loadu_pd(particles->x + i);
+    const __m512d yi = _mm512_loadu_pd(particles->y + i);
+    const __m512d zi = _mm512_loadu_pd(particles->z + i);
+    __m512d axi = _mm512_setzero_pd();
+    __m512d ayi = _mm512_setzero_pd();
+    __m512d azi = _mm512_setzero_pd();
+    for( int j = 0; j < count; j++)
+    {
+      __m512d dx = _mm512_sub_pd(_mm512_set1_pd(sx[j]), xi);
+      __m512d dy = _mm512_sub_pd(_mm512_set1_pd(sy[j]), yi);
+      __m512d dz = _mm512_sub_pd(_mm512_set1_pd(sz[j]), zi);
+      __m512d r2 = _mm512_fmadd_pd(dz, dz, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dx, dx)));
+      __m512d hr2   = _mm512_mul_pd(half, r2);
+      __m512d inv_r = _mm512_rsqrt14_pd(r2);
+      inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(hr2, _mm512_mul_pd(inv_r, inv_r), three));
+      inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(hr2, _mm512_mul_pd(inv_r, inv_r), three));
+      __m512d inv_r3 = _mm512_mul_pd(_mm512_mul_pd(inv_r, inv_r), inv_r);
+      __m512d s = _mm512_mul_pd(_mm512_set1_pd(gravity_constant * sm[j]), inv_r3);
+      axi = _mm512_fmadd_pd(dx, s, axi);
+      ayi = _mm512_fmadd_pd(dy, s, ayi);
+      azi = _mm512_fmadd_pd(dz, s, azi);
+    }
+    _mm512_storeu_pd(particles->ax + i, axi);
+    _mm512_storeu_pd(particles->ay + i, ayi);
+    _mm512_storeu_pd(particles->az + i, azi);
+  }
+
+  if(i < end) rangeScalar(particles, sources, i, end);  // leftovers
+}
+#endif // PARTICLES_X86
+
+//#==============================================================================
+//# * activeRange
+//#------------------------------------------------------------------------------
+//# The range kernel matching the gravity kernel in use
+//#==============================================================================
+static ParticleRange activeRange()
+{
+  switch(gravityKernel())
+  {
+#ifdef PARTICLES_X86
+    case GRAVITY_KERNEL_AVX2:   return rangeAvx2;
+    case GRAVITY_KERNEL_AVX512: return rangeAvx512;
+#endif
+  }
+  return rangeScalar;
+}
+
+//#==============================================================================
+//# * accelerationTask / kickDriftTask / accelerationKickTask
+//#------------------------------------------------------------------------------
+//# Thread pool tasks. A step is a half kick with the old accelerations and a
+//# drift, then new accelerations from the advanced massive bodies and the
+//# other half kick (kick-drift-kick leapfrog). Each task makes one pass over
+//# its particles.
+//#==============================================================================
+static void accelerationTask(void* context, int begin, int end)
+{
+  tagParticleTask* task = (tagParticleTask*)context;
+  task->range(task->particles, task->sources, begin, end);
+}
+
+static void kickDriftTask(void* context, int begin, int end)
+{
+  tagParticleTask* task = (tagParticleTask*)context;
+  tagParticles* p = task->particles;
+  const double h  = task->interval;
+  const double k  = task->interval * 0.5;
+  for( int i = begin; i < end; i++)
+  {
+    p->vx[i] += p->ax[i] * k;   p->x[i] += p->vx[i] * h;
+    p->vy[i] += p->ay[i] * k;   p->y[i] += p->vy[i] * h;
+    p->vz[i] += p->az[i] * k;   p->z[i] += p->vz[i] * h;
+  }
+}
+
+static void accelerationKickTask(void* context, int begin, int end)
+{
+  tagParticleTask* task = (tagParticleTask*)context;
+  tagParticles* p = task->particles;
+  const double k  = task->interval * 0.5;
+  task->range(p, task->sources, begin, end);
+  for( int i = begin; i < end; i++)
+  {
+    p->vx[i] += p->ax[i] * k;
+    p->vy[i] += p->ay[i] * k;
+    p->vz[i] += p->az[i] * k;
+  }
+}
+
+//#==============================================================================
+//# * particlesCreate / particlesDestroy / particlesReserve
+//#------------------------------------------------------------------------------
+//# Storage, laid out like tagBodies. Reserving keeps existing particles.
+//#==============================================================================
+void particlesCreate(tagParticles* particles, int capacity)
+{
+  memset(particles, 0, sizeof(*particles));
+  particlesReserve(particles, capacity > 0 ? capacity : 1);
+}
+
+void particlesDestroy(tagParticles* particles)
+{
+  double** arrays[] = { &particles->x,  &particles->y,  &particles->z,
+                        &particles->vx, &particles->vy, &particles->vz,
+                        &particles->ax, &particles->ay, &particles->az };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    if(*arrays[i] != NULL) alignedFree(*arrays[i]);
+    *arrays[i] = NULL;
+  }
+  particles->count    = 0;
+  particles->capacity = 0;
+  particles->fresh    = false;
+}
+
+void particlesReserve(tagParticles* particles, int capacity)
+{
+  if(capacity <= particles->capacity) return;
+
+  double** arrays[] = { &particles->x,  &particles->y,  &particles->z,
+                        &particles->vx, &particles->vy, &particles->vz,
+                        &particles->ax, &particles->ay, &particles->az };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    double* grown = (double*)alignedAlloc(sizeof(double) * (unsigned long)capacity);
+    if(*arrays[i] != NULL)
+    {
+      memcpy(grown, *arrays[i], sizeof(double) * (unsigned long)particles->count);
+      alignedFree(*arrays[i]);
+    }
+    *arrays[i] = grown;
+  }
+  particles->capacity = capacity;
+}
+
+//#==============================================================================
+//# * particlesAdd
+//#------------------------------------------------------------------------------
+//# Appends a particle, growing the arrays if needed. Returns its index.
+//#==============================================================================
+int particlesAdd(tagParticles* particles, double x,  double y,  double z,
+                                          double vx, double vy, double vz)
+{
+  if(particles->count == particles->capacity)
+  {
+    particlesReserve(particles, particles->capacity * 2);
+  }
+  int i = particles->count++;
+  particles->x[i]  = x;   particles->y[i]  = y;   particles->z[i]  = z;
+  particles->vx[i] = vx;  particles->vy[i] = vy;  particles->vz[i] = vz;
+  particles->ax[i] = 0;   particles->ay[i] = 0;   particles->az[i] = 0;
+  particles->fresh = false;
+  return i;
+}
+
+//#==============================================================================
+//# * particlesAccelerations
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of every particle from the sources as they are now
+//#==============================================================================
+void particlesAccelerations(tagParticles* particles, const tagBodies* sources)
+{
+  tagParticleTask task = { particles, sources, 0, activeRange() };
+  threadPoolFor(particles->count, PARTICLES_GRAIN, accelerationTask, &task);
+  particles->fresh = true;
+}
+
+//#==============================================================================
+//# * particlesStep
+//#------------------------------------------------------------------------------
+//# Advances every particle by one interval. "sources" must already have been
+//# advanced to the end of the interval, and the particles' accelerations must
+//# belong to the sources at the start of it (particlesAccelerations, or the
+//# previous step).
+//#==============================================================================
+void particlesStep(tagParticles* particles, const tagBodies* sources, double interval)
+{
+  tagParticleTask task = { particles, sources, interval, activeRange() };
+  threadPoolFor(particles->count, PARTICLES_GRAIN, kickDriftTask, &task);
+  threadPoolFor(particles->count, PARTICLES_GRAIN, accelerationKickTask, &task);
+  particles->fresh = true;
+}
@@ -0,0 +1,53 @@
+/*
+#================================================================================
+# * Particles               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Massless test particles (asteroids, comets, probes). They are pulled by the
+# massive bodies but pull on nothing themselves, so a step costs
+# O(massive x particles) rather than O(N^2) and hundreds of thousands of them
+# can ride along with the planets. The massive bodies are always advanced
+# first; the particles then read them without changing them.
+#================================================================================
+*/
+#ifndef SOLAR_PARTICLES_H
+#define SOLAR_PARTICLES_H
+
+#include "bodies.h"
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagParticles
+typedef struct
+{
+  double* x;         // x component of position
+  double* y;         // y component of position
+  double* z;         // z component of position
+  double* vx;        // x component of velocity
+  double* vy;        // y component of velocity
+  double* vz;        // z component of velocity
+  double* ax;        // x component of acceleration at the current positions
+  double* ay;        // y component of acceleration at the current positions
+  double* az;        // z component of acceleration at the current positions
+  int     count;     // number of particles in use
+  int     capacity;  // number of particles the arrays can hold
+  bool    fresh;     // ax/ay/az belong to the current positions
+}tagParticles;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void particlesCreate  ( tagParticles* particles, int capacity );
+void particlesDestroy ( tagParticles* particles );
+void particlesReserve ( tagParticles* particles, int capacity );
+int  particlesAdd     ( tagParticles* particles,
+                        double x,  double y,  double z,
+                        double vx, double vy, double vz );
+
+void particlesAccelerations ( tagParticles* particles, const tagBodies* sources );
+void particlesStep          ( tagParticles* particles, const tagBodies* sources,
+                              double interval );
+
+#endif // SOLAR_PARTICLES_H
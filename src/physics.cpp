@@ -0,0 +1,289 @@
+/*
+#================================================================================
+# * Physics                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Newtonian gravity step shared by the window and the headless runner
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "physics.h"
+#include "gravity.h"
+#include "precision.h"
+#include "octree.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include <math.h>         // Header File for the math library
+#include <string.h>       // Header File for strcmp
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static int       activeSolver = SOLVER_DIRECT;
+static int       activePrecision = PRECISION_NATIVE;
+static tagOctree tree;                // reused between steps by SOLVER_TREE
+static bool      treeCreated  = false;
+static tagIntegrator integrator;      // INTEGRATOR_EULER until selected
+static tagParticles* particles = NULL; // test particles carried along, if any
+static tagTrajectoryWriter* recorder = NULL; // where steps are recorded, if anywhere
+static tagPublisher* publisher = NULL; // where steps are shared, if anywhere
+static tagCollisions collisions;      // overlapping bodies merged after each step
+static bool      colliding = false;
+
+//#==============================================================================
+//# * treeTask
+//#------------------------------------------------------------------------------
+//# Thread pool task: a range of tree leaves
+//#==============================================================================
+static void treeTask(void* context, int begin, int end)
+{
+  octreeAccelerations(&tree, (tagBodies*)context, begin, end);
+}
+
+//#==============================================================================
+//# * physicsSelectSolver
+//#------------------------------------------------------------------------------
+//# Chooses how accelerations are worked out from now on. theta and multipole
+//# only matter for SOLVER_TREE.
+//#==============================================================================
+void physicsSelectSolver(int solver, double theta, int multipole)
+{
+  activeSolver = solver;
+  if(treeCreated) octreeDestroy(&tree);
+  octreeCreate(&tree, theta, multipole);
+  treeCreated = true;
+}
+
+int physicsSolver()
+{
+  return activeSolver;
+}
+
+const tagOctree* physicsTree()
+{
+  return treeCreated ? &tree : NULL;
+}
+
+//#==============================================================================
+//# * physicsSelectPrecision
+//#------------------------------------------------------------------------------
+//# Chooses the scalar type of the direct sum from now on (PRECISION_*)
+//#==============================================================================
+void physicsSelectPrecision(int precision)
+{
+  activePrecision = precision;
+}
+
+int physicsPrecision()
+{
+  return activePrecision;
+}
+
+//#==============================================================================
+//# * physicsAccelerations
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of every body with the selected solver
+//#==============================================================================
+void physicsAccelerations(tagBodies* bodies)
+{
+  PROFILE_ZONE("forces");
+  if(activeSolver == SOLVER_TREE)
+  {
+    if(!treeCreated) physicsSelectSolver(SOLVER_TREE, 0.5, OCTREE_QUADRUPOLE);
+    {
+      PROFILE_ZONE("tree build");
+      octreeBuild(&tree, bodies);   // bodies have moved since the last step
+    }
+    threadPoolFor(tree.leafCount, 16, treeTask, bodies);
+  }
+  else if(activePrecision != PRECISION_NATIVE)
+  {
+    precisionAccelerations(bodies, activePrecision);
+  }
+  else
+  {
+    gravityAccelerations(bodies);  // sets ax/ay/az from every pair
+  }
+}
+
+//#==============================================================================
+//# * physicsSelectIntegrator
+//#------------------------------------------------------------------------------
+//# Chooses how the bodies are advanced from now on. tolerance only matters
+//# for INTEGRATOR_DOPRI and eta for INTEGRATOR_BLOCK.
+//#==============================================================================
+void physicsSelectIntegrator(int type, double tolerance, double eta)
+{
+  integratorDestroy(&integrator);
+  integratorCreate(&integrator, type, tolerance, eta);
+}
+
+tagIntegrator* physicsIntegrator()
+{
+  return &integrator;
+}
+
+//#==============================================================================
+//# * physicsAttachParticles
+//#------------------------------------------------------------------------------
+//# Test particles to advance along with the bodies on every step (NULL for
+//# none). They still belong to the caller.
+//#==============================================================================
+void physicsAttachParticles(tagParticles* attached)
+{
+  particles = attached;
+  if(particles != NULL) particles->fresh = false;
+}
+
+tagParticles* physicsParticles()
+{
+  return particles;
+}
+
+//#==============================================================================
+//# * physicsAttachRecorder
+//#------------------------------------------------------------------------------
+//# Recording that is handed the bodies after every step (NULL for none)
+//#==============================================================================
+void physicsAttachRecorder(tagTrajectoryWriter* attached)
+{
+  recorder = attached;
+}
+
+//#==============================================================================
+//# * physicsAttachPublisher
+//#------------------------------------------------------------------------------
+//# Shared memory segment every step is published to (NULL for none)
+//#==============================================================================
+void physicsAttachPublisher(tagPublisher* attached)
+{
+  publisher = attached;
+}
+
+//#==============================================================================
+//# * physicsSetCollisions
+//#------------------------------------------------------------------------------
+//# Whether bodies that overlap after a step are merged into one
+//#==============================================================================
+void physicsSetCollisions(bool enabled)
+{
+  if(enabled && !colliding) collisionsCreate(&collisions);
+  if(!enabled && colliding) collisionsDestroy(&collisions);
+  colliding = enabled;
+}
+
+const tagCollisions* physicsCollisions()
+{
+  return colliding ? &collisions : NULL;
+}
+
+//#==============================================================================
+//# * physicsStep
+//#------------------------------------------------------------------------------
+//# Advances every body by one interval (in seconds) using the sum of the
+//# gravitational forces from every other body. Bodies that then overlap are
+//# merged, and test particles follow once the bodies have got to the end of
+//# the interval. Returns false if the integrator gave up part way through,
+//# in which case nothing else is done.
+//#==============================================================================
+bool physicsStep(tagBodies* bodies, double interval)
+{
+  PROFILE_ZONE("step");
+  bool carry = particles != NULL && particles->count > 0;
+  if(carry && !particles->fresh) particlesAccelerations(particles, bodies);
+
+  {
+    PROFILE_ZONE("integrate");
+    if(!integratorStep(&integrator, bodies, interval)) return false;
+  }
+
+  if(colliding)
+  {
+    PROFILE_ZONE("collisions");
+    if(collisionsStep(&collisions, bodies) > 0)
+    {
+      integratorReset(&integrator);      // accelerations and block levels are stale
+      if(recorder != NULL) trajectoryRemap(recorder, collisions.remap);
+    }
+  }
+
+  if(carry)
+  {
+    PROFILE_ZONE("particles");
+    particlesStep(particles, bodies, interval);
+  }
+  if(recorder != NULL)
+  {
+    PROFILE_ZONE("record");
+    trajectoryRecord(recorder, bodies);
+  }
+  if(publisher != NULL)
+  {
+    PROFILE_ZONE("publish");
+    publisherWrite(publisher, bodies, interval);
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * physicsEnergy
+//#------------------------------------------------------------------------------
+//# Total kinetic plus potential energy, by direct summation (O(N^2)). Only
+//# for diagnostics, so it is kept serial and simple.
+//#==============================================================================
+double physicsEnergy(const tagBodies* bodies)
+{
+  double kinetic = 0, potential = 0;
+  for( int i = 0; i < bodies->count; i++)
+  {
+    double v2 = bodies->vx[i]*bodies->vx[i] + bodies->vy[i]*bodies->vy[i] +
+                bodies->vz[i]*bodies->vz[i];
+    kinetic += 0.5 * bodies->mass[i] * v2;
+    for( int j = i + 1; j < bodies->count; j++)
+    {
+      double dx = bodies->x[j] - bodies->x[i];
+      double dy = bodies->y[j] - bodies->y[i];
+      double dz = bodies->z[j] - bodies->z[i];
+      potential -= gravity_constant * bodies->mass[i] * bodies->mass[j] /
+                   sqrt(dx*dx + dy*dy + dz*dz);
+    }
+  }
+  return kinetic + potential;
+}
+
+//#==============================================================================
+//# * physicsAngularMomentum
+//#------------------------------------------------------------------------------
+//# Total angular momentum about the origin, sum of m (r x v), into L[3]
+//#==============================================================================
+void physicsAngularMomentum(const tagBodies* bodies, double L[3])
+{
+  L[0] = L[1] = L[2] = 0;
+  for( int i = 0; i < bodies->count; i++)
+  {
+    double m = bodies->mass[i];
+    L[0] += m * (bodies->y[i] * bodies->vz[i] - bodies->z[i] * bodies->vy[i]);
+    L[1] += m * (bodies->z[i] * bodies->vx[i] - bodies->x[i] * bodies->vz[i]);
+    L[2] += m * (bodies->x[i] * bodies->vy[i] - bodies->y[i] * bodies->vx[i]);
+  }
+}
+
+//#==============================================================================
+//# * physicsSolverName / physicsParseSolver
+//#------------------------------------------------------------------------------
+//# Converts between solvers and the names used on the command line. Parsing
+//# returns -1 for a name it doesn't know.
+//#==============================================================================
+const char* physicsSolverName(int solver)
+{
+  return solver == SOLVER_TREE ? "tree" : "direct";
+}
+
+int physicsParseSolver(const char* name)
+{
+  if(strcmp(name, "direct") == 0) return SOLVER_DIRECT;
+  if(strcmp(name, "tree")   == 0) return SOLVER_TREE;
+  return -1;
+}
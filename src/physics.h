@@ -0,0 +1,57 @@
+/*
+#================================================================================
+# * Physics                 Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# The N-body step, kept free of any OpenGL/GLUT calls so that it can be driven
+# either by the display callback or by the headless batch runner.
+#================================================================================
+*/
+#ifndef SOLAR_PHYSICS_H
+#define SOLAR_PHYSICS_H
+
+#include "bodies.h"
+#include "integrator.h"
+#include "octree.h"
+#include "particles.h"
+#include "trajectory.h"
+#include "collisions.h"
+#include "publisher.h"
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of force solvers
+enum
+{
+  SOLVER_DIRECT = 0,   // every pair, exactly (O(N^2))
+  SOLVER_TREE          // Barnes-Hut octree (O(N log N))
+};
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void   physicsSelectSolver  ( int solver, double theta, int multipole );
+int    physicsSolver        ( );
+const tagOctree* physicsTree ( );
+void   physicsSelectPrecision ( int precision );
+int    physicsPrecision     ( );
+void   physicsAccelerations ( tagBodies* bodies );
+bool   physicsStep          ( tagBodies* bodies, double interval );
+double physicsEnergy        ( const tagBodies* bodies );
+void   physicsAngularMomentum ( const tagBodies* bodies, double L[3] );
+
+void           physicsSelectIntegrator ( int type, double tolerance, double eta );
+tagIntegrator* physicsIntegrator       ( );
+void           physicsAttachParticles  ( tagParticles* particles );
+tagParticles*  physicsParticles        ( );
+void           physicsAttachRecorder   ( tagTrajectoryWriter* recorder );
+void           physicsAttachPublisher  ( tagPublisher* publisher );
+void           physicsSetCollisions    ( bool enabled );
+const tagCollisions* physicsCollisions ( );
+
+const char* physicsSolverName  ( int solver );
+int         physicsParseSolver ( const char* name );
+
+#endif // SOLAR_PHYSICS_H
@@ -0,0 +1,337 @@
+/*
+#================================================================================
+# * Precision               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# The instantiations of the templated force sums, float lane kernels for
+# large counts, and picking between them
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "precision.h"
+#include "solar_system.h"
+#include "thread_pool.h"
+#include <string.h>       // Header File for strcmp
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define PRECISION_X86 1
+# include <immintrin.h>   // Header File for the AVX intrinsics
+#endif
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define PRECISION_FLUSH 16   // float lane steps summed before adding to double
+
+// tagFloatBodies - float copies of the positions and G*m, for the lanes
+typedef struct
+{
+  float* x;
+  float* y;
+  float* z;
+  float* gm;
+  int    capacity;
+}tagFloatBodies;
+
+// tagRowJob - what the thread pool tasks need
+typedef struct
+{
+  tagBodies*            bodies;
+  const tagFloatBodies* lanes;
+}tagRowJob;
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static tagFloatBodies lanes = { NULL, NULL, NULL, NULL, 0 };
+
+#ifdef PRECISION_X86
+//#==============================================================================
+//# * rowsFloatAvx2
+//#------------------------------------------------------------------------------
+//# Eight pairs at a time in float, from a 12-bit reciprocal square root
+//# estimate and one Newton-Raphson step. Each row's eight partial sums are
+//# added to double accumulators every PRECISION_FLUSH steps. The pair with
+//# itself (r2 = 0) is masked out, and G*m is multiplied in before the last
+//# 1/r^2 so that nothing becomes subnormal.
+//#==============================================================================
+__attribute__((target("avx2,fma")))
+static void rowsFloatAvx2(tagBodies* bodies, const tagFloatBodies* lanes, int begin, int end)
+{
+  const int count = bodies->count;
+  const __m256 zero  = _mm256_setzero_ps();
+  const __m256 half  = _mm256_set1_ps(0.5f);
+  const __m256 three = _mm256_set1_ps(1.5f);
+  for( int i = begin; i < end; i++)
+  {
+    const __m256 xi = _mm256_set1_ps(lanes->x[i]);
+    const __m256 yi = _mm256_set1_ps(lanes->y[i]);
+    const __m256 zi = _mm256_set1_ps(lanes->z[i]);
+    __m256d sum[6] = { _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(),
+                       _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd() };
+    int j = 0;
+    while(j + 8 <= count)
+    {
+      __m256 axi = zero, ayi = zero, azi = zero;
+      for( int step = 0; step < PRECISION_FLUSH && j + 8 <= count; step++, j += 8)
+      {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(lanes->x + j), xi);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(lanes->y + j), yi);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(lanes->z + j), zi);
+        __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+        __m256 inv_r = _mm256_rsqrt_ps(r2);
+        inv_r = _mm256_mul_ps(inv_r, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2),
+                                                      _mm256_mul_ps(inv_r, inv_r), three));
+        inv_r = _mm256_and_ps(inv_r, _mm256_cmp_ps(r2, zero, _CMP_NEQ_OQ));
+        __m256 s = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(lanes->gm + j), inv_r),
+                                 _mm256_mul_ps(inv_r, inv_r));
+        axi = _mm256_fmadd_ps(dx, s, axi);
+        ayi = _mm256_fmadd_ps(dy, s, ayi);
+        azi = _mm256_fmadd_ps(dz, s, azi);
+      }
+      sum[0] = _mm256_add_pd(sum[0], _mm256_cvtps_pd(_mm256_castps256_ps128(axi)));
+      sum[1] = _mm256_add_pd(sum[1], _mm256_cvtps_pd(_mm256_extractf128_ps(axi, 1)));
+      sum[2] = _mm256_add_pd(sum[2], _mm256_cvtps_pd(_mm256_castps256_ps128(ayi)));
+      sum[3] = _mm256_add_pd(sum[3], _mm256_cvtps_pd(_mm256_extractf128_ps(ayi, 1)));
+      sum[4] = _mm256_add_pd(sum[4], _mm256_cvtps_pd(_mm256_castps256_ps128(azi)));
+      sum[5] = _mm256_add_pd(sum[5], _mm256_cvtps_pd(_mm256_extractf128_ps(azi, 1)));
+    }
+    double total[3], l[4];
+    for( int axis = 0; axis < 3; axis++)
+    {
+      _mm256_storeu_pd(l, _mm256_add_pd(sum[2*axis], sum[2*axis + 1]));
+      total[axis] = (l[0] + l[1]) + (l[2] + l[3]);
+    }
+    for( ; j < count; j++)                    // leftovers
+    {
+      if(j == i) continue;
+      float dx = lanes->x[j] - lanes->x[i];
+      float dy = lanes->y[j] - lanes->y[i];
+      float dz = lanes->z[j] - lanes->z[i];
+      float inv_r = 1.0f / sqrtf(dx*dx + dy*dy + dz*dz);
+      float s = lanes->gm[j] * inv_r * (inv_r * inv_r);
+      total[0] += dx * s;
+      total[1] += dy * s;
+      total[2] += dz * s;
+    }
+    bodies->ax[i] = total[0];
+    bodies->ay[i] = total[1];
+    bodies->az[i] = total[2];
+  }
+}
+
+//#==============================================================================
+//# * rowsFloatAvx512
+//#------------------------------------------------------------------------------
+//# Sixteen pairs at a time, from the 14-bit estimate and one Newton-Raphson
+//# step. The last few bodies of each row go through masked loads, with their
+//# G*m read as 0.
+//#==============================================================================
+__attribute__((target("avx512f")))
+static void rowsFloatAvx512(tagBodies* bodies, const tagFloatBodies* lanes, int begin, int end)
+{
+  const int count = bodies->count;
+  const __m512 zero  = _mm512_setzero_ps();
+  const __m512 half  = _mm512_set1_ps(0.5f);
+  const __m512 three = _mm512_set1_ps(1.5f);
+  for( int i = begin; i < end; i++)
+  {
+    const __m512 xi = _mm512_set1_ps(lanes->x[i]);
+    const __m512 yi = _mm512_set1_ps(lanes->y[i]);
+    const __m512 zi = _mm512_set1_ps(lanes->z[i]);
+    __m512d sum[6] = { _mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd(),
+                       _mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd() };
+    int j = 0;
+    while(j < count)
+    {
+      __m512 axi = zero, ayi = zero, azi = zero;
+      for( int step = 0; step < PRECISION_FLUSH && j < count; step++, j += 16)
+      {
+        __mmask16 in = count - j >= 16 ? (__mmask16)0xFFFF
+                                       : (__mmask16)((1u << (count - j)) - 1);
+        __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(in, lanes->x + j), xi);
+        __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(in, lanes->y + j), yi);
+        __m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(in, lanes->z + j), zi);
+        __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+        __m512 inv_r = _mm512_rsqrt14_ps(r2);
+        inv_r = _mm512_mul_ps(inv_r, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2),
+                                                      _mm512_mul_ps(inv_r, inv_r), three));
+        inv_r = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(r2, zero, _CMP_NEQ_OQ), inv_r);
+        __m512 s = _mm512_mul_ps(_mm512_mul_ps(_mm512_maskz_loadu_ps(in, lanes->gm + j), inv_r),
+                                 _mm512_mul_ps(inv_r, inv_r));
+        axi = _mm512_fmadd_ps(dx, s, axi);
+        ayi = _mm512_fmadd_ps(dy, s, ayi);
+        azi = _mm512_fmadd_ps(dz, s, azi);
+      }
+      const __m512 partial[3] = { axi, ayi, azi };
+      for( int axis = 0; axis < 3; axis++)
+      {
+        __m256 low  = _mm512_castps512_ps256(partial[axis]);
+        __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(partial[axis]), 1));
+        sum[2*axis]     = _mm512_add_pd(sum[2*axis],     _mm512_cvtps_pd(low));
+        sum[2*axis + 1] = _mm512_add_pd(sum[2*axis + 1], _mm512_cvtps_pd(high));
+      }
+    }
+    bodies->ax[i] = _mm512_reduce_add_pd(_mm512_add_pd(sum[0], sum[1]));
+    bodies->ay[i] = _mm512_reduce_add_pd(_mm512_add_pd(sum[2], sum[3]));
+    bodies->az[i] = _mm512_reduce_add_pd(_mm512_add_pd(sum[4], sum[5]));
+  }
+}
+#endif // PRECISION_X86
+
+//#==============================================================================
+//# * prepareLanes
+//#------------------------------------------------------------------------------
+//# Rounds the positions and G*m to float for the lane kernels. The positions
+//# are taken from the centre of mass first, so that a system far from the
+//# origin keeps as many digits as one around it. Differences are then formed
+//# in float, so unlike precisionRows a close pair far out loses digits: at
+//# 3 AU a position is rounded by up to 16 km.
+//#==============================================================================
+static void prepareLanes(const tagBodies* bodies)
+{
+  const int count = bodies->count;
+  if(count > lanes.capacity)
+  {
+    if(lanes.x != NULL)
+    {
+      alignedFree(lanes.x);
+      alignedFree(lanes.y);
+      alignedFree(lanes.z);
+      alignedFree(lanes.gm);
+    }
+    unsigned long size = sizeof(float) * (unsigned long)count;
+    lanes.x  = (float*)alignedAlloc(size);
+    lanes.y  = (float*)alignedAlloc(size);
+    lanes.z  = (float*)alignedAlloc(size);
+    lanes.gm = (float*)alignedAlloc(size);
+    lanes.capacity = count;
+  }
+  double total = 0, cx = 0, cy = 0, cz = 0;
+  for( int i = 0; i < count; i++)
+  {
+    total += bodies->mass[i];
+    cx    += bodies->mass[i] * bodies->x[i];
+    cy    += bodies->mass[i] * bodies->y[i];
+    cz    += bodies->mass[i] * bodies->z[i];
+  }
+  if(total > 0)
+  {
+    cx /= total;
+    cy /= total;
+    cz /= total;
+  }
+  for( int i = 0; i < count; i++)
+  {
+    lanes.x[i]  = (float)(bodies->x[i] - cx);
+    lanes.y[i]  = (float)(bodies->y[i] - cy);
+    lanes.z[i]  = (float)(bodies->z[i] - cz);
+    lanes.gm[i] = (float)(gravity_constant * bodies->mass[i]);
+  }
+}
+
+//#==============================================================================
+//# * rowTask
+//#------------------------------------------------------------------------------
+//# Thread pool tasks, one per scalar type (float uses the widest lanes the
+//# gravity kernel in use allows)
+//#==============================================================================
+static void rowTaskFloat(void* context, int begin, int end)
+{
+  const tagRowJob* job = (const tagRowJob*)context;
+  switch(gravityKernel())
+  {
+#ifdef PRECISION_X86
+    case GRAVITY_KERNEL_AVX512: rowsFloatAvx512(job->bodies, job->lanes, begin, end); break;
+    case GRAVITY_KERNEL_AVX2:   rowsFloatAvx2(job->bodies, job->lanes, begin, end);   break;
+#endif
+    default:                    precisionRows<float>(job->bodies, begin, end);        break;
+  }
+}
+
+static void rowTaskDouble(void* context, int begin, int end)
+{
+  precisionRows<double>(((const tagRowJob*)context)->bodies, begin, end);
+}
+
+static void rowTaskDoubleFloat(void* context, int begin, int end)
+{
+  precisionRows<tagDoubleFloat>(((const tagRowJob*)context)->bodies, begin, end);
+}
+
+//#==============================================================================
+//# * precisionFixed
+//#------------------------------------------------------------------------------
+//# Whether there is a kernel compiled for exactly "count" bodies
+//#==============================================================================
+bool precisionFixed(int count)
+{
+  return count == SOLAR_SYSTEM_BODIES;
+}
+
+//#==============================================================================
+//# * precisionAccelerations
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of every body from every other body in the given precision
+//# (not PRECISION_NATIVE, which is gravityAccelerations)
+//#==============================================================================
+void precisionAccelerations(tagBodies* bodies, int precision)
+{
+  if(precisionFixed(bodies->count))
+  {
+    switch(precision)
+    {
+      case PRECISION_FLOAT:        precisionPairs<float,  SOLAR_SYSTEM_BODIES>(bodies); break;
+      case PRECISION_DOUBLE_FLOAT:
+        precisionPairs<tagDoubleFloat, SOLAR_SYSTEM_BODIES>(bodies);
+        break;
+      default:                     precisionPairs<double, SOLAR_SYSTEM_BODIES>(bodies); break;
+    }
+    return;
+  }
+
+  tagRowJob job = { bodies, &lanes };
+  switch(precision)
+  {
+    case PRECISION_FLOAT:
+      prepareLanes(bodies);
+      threadPoolFor(bodies->count, 64, rowTaskFloat, &job);
+      break;
+    case PRECISION_DOUBLE_FLOAT:
+      threadPoolFor(bodies->count, 16, rowTaskDoubleFloat, &job);
+      break;
+    default:
+      threadPoolFor(bodies->count, 64, rowTaskDouble, &job);
+      break;
+  }
+}
+
+//#==============================================================================
+//# * precisionName / precisionParse
+//#------------------------------------------------------------------------------
+//# Converts between precisions and the names used on the command line.
+//# Parsing returns -1 for a name it doesn't know.
+//#==============================================================================
+const char* precisionName(int precision)
+{
+  switch(precision)
+  {
+    case PRECISION_NATIVE:       return "native";
+    case PRECISION_DOUBLE:       return "double";
+    case PRECISION_FLOAT:        return "float";
+    case PRECISION_DOUBLE_FLOAT: return "double-float";
+  }
+  return "unknown";
+}
+
+int precisionParse(const char* name)
+{
+  for( int precision = 0; precision < PRECISION_COUNT; precision++)
+  {
+    if(strcmp(name, precisionName(precision)) == 0) return precision;
+  }
+  return -1;
+}
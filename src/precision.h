@@ -0,0 +1,215 @@
+/*
+#================================================================================
+# * Precision               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Direct force sums templated on the scalar type the pair arithmetic runs in:
+# float, double, or double-float (an unevaluated sum of two floats, good to
+# about 44 bits with nothing but float operations). Positions stay double and
+# every pair's pull is added to double accumulators, so only the per pair
+# arithmetic changes.
+#
+# The body count can be fixed at compile time too. The sun and planets then
+# get a kernel whose loops the compiler unrolls completely. Large float runs
+# use AVX2 / AVX-512 float lanes instead. These are the exception to the
+# above: they round positions (taken from the centre of mass) to float and
+# subtract in float, so close pairs far from the centre keep fewer digits.
+#================================================================================
+*/
+#ifndef SOLAR_PRECISION_H
+#define SOLAR_PRECISION_H
+
+#include "bodies.h"
+#include "gravity.h"
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of precisions
+enum
+{
+  PRECISION_NATIVE = 0,     // the runtime-selected double kernels of gravity.cpp
+  PRECISION_DOUBLE,
+  PRECISION_FLOAT,
+  PRECISION_DOUBLE_FLOAT,
+  PRECISION_COUNT
+};
+
+// tagDoubleFloat - hi + lo, with |lo| at most half an ulp of hi. The error-free
+// sums and products below must not be contracted into fused multiply-adds,
+// so precision.cpp is built with -ffp-contract=off.
+struct tagDoubleFloat
+{
+  float hi;
+  float lo;
+
+  tagDoubleFloat() : hi(0), lo(0) {}
+  tagDoubleFloat(float hi, float lo) : hi(hi), lo(lo) {}
+  tagDoubleFloat(double value) : hi((float)value), lo((float)(value - (float)value)) {}
+  explicit operator double() const { return (double)hi + (double)lo; }
+};
+
+//#==============================================================================
+//# * Double-float arithmetic
+//#------------------------------------------------------------------------------
+//# Knuth's two-sum and Dekker's two-product give the rounding error of a
+//# float sum or product exactly; the operators carry it along in lo.
+//#==============================================================================
+inline tagDoubleFloat precisionQuickTwoSum(float a, float b)
+{
+  float s = a + b;
+  return tagDoubleFloat(s, b - (s - a));
+}
+
+inline tagDoubleFloat precisionTwoSum(float a, float b)
+{
+  float s  = a + b;
+  float bb = s - a;
+  return tagDoubleFloat(s, (a - (s - bb)) + (b - bb));
+}
+
+inline tagDoubleFloat precisionTwoProduct(float a, float b)
+{
+  const float split = 4097.0f;   // 2^12 + 1 splits a float into two 12-bit halves
+  float p  = a * b;
+  float ta = split * a, ah = ta - (ta - a), al = a - ah;
+  float tb = split * b, bh = tb - (tb - b), bl = b - bh;
+  return tagDoubleFloat(p, ((ah * bh - p) + ah * bl + al * bh) + al * bl);
+}
+
+inline tagDoubleFloat operator+(tagDoubleFloat a, tagDoubleFloat b)
+{
+  tagDoubleFloat s = precisionTwoSum(a.hi, b.hi);
+  return precisionQuickTwoSum(s.hi, s.lo + (a.lo + b.lo));
+}
+
+inline tagDoubleFloat operator-(tagDoubleFloat a, tagDoubleFloat b)
+{
+  return a + tagDoubleFloat(-b.hi, -b.lo);
+}
+
+inline tagDoubleFloat operator*(tagDoubleFloat a, tagDoubleFloat b)
+{
+  tagDoubleFloat p = precisionTwoProduct(a.hi, b.hi);
+  return precisionQuickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+inline tagDoubleFloat operator/(tagDoubleFloat a, tagDoubleFloat b)
+{
+  float q1 = a.hi / b.hi;                    // first guess, then correct it once
+  tagDoubleFloat r = a - b * tagDoubleFloat(q1, 0.0f);
+  return precisionQuickTwoSum(q1, r.hi / b.hi);
+}
+
+inline tagDoubleFloat precisionSqrt(tagDoubleFloat a)
+{
+  if(a.hi <= 0) return tagDoubleFloat(0.0f, 0.0f);
+  float x = sqrtf(a.hi);                     // one Newton step from the float root
+  tagDoubleFloat x2 = precisionTwoProduct(x, x);
+  return precisionQuickTwoSum(x, ((a.hi - x2.hi) - x2.lo + a.lo) * (0.5f / x));
+}
+
+inline tagDoubleFloat precisionInverseSqrt(tagDoubleFloat a)
+{
+  float y = 1.0f / sqrtf(a.hi);              // one Newton step: y + y(1 - a y^2)/2
+  tagDoubleFloat residual = tagDoubleFloat(1.0f, 0.0f) - a * precisionTwoProduct(y, y);
+  return precisionQuickTwoSum(y, y * 0.5f * residual.hi);
+}
+
+inline float  precisionSqrt(float a)  { return sqrtf(a); }
+inline double precisionSqrt(double a) { return sqrt(a); }
+inline float  precisionInverseSqrt(float a)  { return 1.0f / sqrtf(a); }
+inline double precisionInverseSqrt(double a) { return 1.0 / sqrt(a); }
+
+//#==============================================================================
+//# * precisionPairs
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of the first N bodies, visiting each pair once and applying
+//# it to both. With N known to the compiler both loops unroll completely.
+//#==============================================================================
+template<typename Real, int N>
+void precisionPairs(tagBodies* bodies)
+{
+  static_assert(N > 1, "a fixed count needs at least two bodies");
+  const double* x    = bodies->x;
+  const double* y    = bodies->y;
+  const double* z    = bodies->z;
+  const double* mass = bodies->mass;
+  double ax[N] = {}, ay[N] = {}, az[N] = {};
+  Real   gm[N];
+  for( int i = 0; i < N; i++) gm[i] = Real(gravity_constant * mass[i]);
+
+  for( int i = 0; i < N; i++)
+  {
+    for( int j = i + 1; j < N; j++)
+    {
+      Real dx = Real(x[j] - x[i]);             // exact in double, then rounded
+      Real dy = Real(y[j] - y[i]);
+      Real dz = Real(z[j] - z[i]);
+      Real r2 = dx*dx + dy*dy + dz*dz;
+      Real inv_r  = precisionInverseSqrt(r2);
+      Real inv_r2 = inv_r * inv_r;
+      Real sj = gm[j] * inv_r * inv_r2;        // never forming 1/r^3, which is
+      Real si = gm[i] * inv_r * inv_r2;        // subnormal in float past 5 AU
+      ax[i] += (double)(dx * sj);   ax[j] -= (double)(dx * si);
+      ay[i] += (double)(dy * sj);   ay[j] -= (double)(dy * si);
+      az[i] += (double)(dz * sj);   az[j] -= (double)(dz * si);
+    }
+  }
+  for( int i = 0; i < N; i++)
+  {
+    bodies->ax[i] = ax[i];
+    bodies->ay[i] = ay[i];
+    bodies->az[i] = az[i];
+  }
+}
+
+//#==============================================================================
+//# * precisionRows
+//#------------------------------------------------------------------------------
+//# Sets ax/ay/az of bodies [begin, end) from every other body. Each row is
+//# summed on its own, so rows can be shared between threads and the result
+//# doesn't depend on how.
+//#==============================================================================
+template<typename Real>
+void precisionRows(tagBodies* bodies, int begin, int end)
+{
+  const double* x    = bodies->x;
+  const double* y    = bodies->y;
+  const double* z    = bodies->z;
+  const double* mass = bodies->mass;
+  const int count = bodies->count;
+  for( int i = begin; i < end; i++)
+  {
+    const double xi = x[i], yi = y[i], zi = z[i];
+    double axi = 0, ayi = 0, azi = 0;
+    for( int j = 0; j < count; j++)
+    {
+      if(j == i) continue;
+      Real dx = Real(x[j] - xi);
+      Real dy = Real(y[j] - yi);
+      Real dz = Real(z[j] - zi);
+      Real r2 = dx*dx + dy*dy + dz*dz;
+      Real inv_r = precisionInverseSqrt(r2);
+      Real s = Real(gravity_constant * mass[j]) * inv_r * (inv_r * inv_r);
+      axi += (double)(dx * s);
+      ayi += (double)(dy * s);
+      azi += (double)(dz * s);
+    }
+    bodies->ax[i] = axi;
+    bodies->ay[i] = ayi;
+    bodies->az[i] = azi;
+  }
+}
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void        precisionAccelerations ( tagBodies* bodies, int precision );
+bool        precisionFixed         ( int count );
+const char* precisionName          ( int precision );
+int         precisionParse         ( const char* name );
+
+#endif // SOLAR_PRECISION_H
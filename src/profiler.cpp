@@ -0,0 +1,412 @@
+/*
+#================================================================================
+# * Profiler                Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Per thread event rings, the thread that drains them, the trace writer and
+# the zone histograms
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "profiler.h"
+#include <stdio.h>              // Header File for the standard library
+#include <stdlib.h>             // Header File for atexit
+#include <string.h>             // Header File for strncpy
+#include <atomic>               // Header File for std::atomic
+#include <chrono>               // Header File for std::chrono
+#include <condition_variable>   // Header File for std::condition_variable
+#include <mutex>                // Header File for std::mutex
+#include <thread>               // Header File for std::thread
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define PROFILER_DRAIN 0.05     // seconds between drains
+
+// tagProfilerEvent
+typedef struct
+{
+  unsigned long long start;     // steady clock (ns)
+  unsigned long long duration;  // ns
+  int                zone;
+}tagProfilerEvent;
+
+// tagProfilerBuffer - one thread's ring. Never freed: the drain thread may
+// still be reading it after the thread that filled it has gone.
+struct tagProfilerBuffer
+{
+  tagProfilerEvent ring[PROFILER_RING];
+  std::atomic<unsigned long> head;   // next slot the thread fills
+  std::atomic<unsigned long> tail;   // next slot the drain thread empties
+  int  id;                           // "tid" in the trace
+  char name[32];                     // set by profilerNameThread
+};
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static tagProfilerBuffer*  buffers[PROFILER_THREADS];
+static std::atomic<int>    bufferCount(0);
+static thread_local tagProfilerBuffer* localBuffer = NULL;
+static thread_local bool   localTried = false;   // stop asking once they've run out
+
+static const char*         zoneNames[PROFILER_ZONES];
+static int                 zoneCount = 0;
+static std::mutex          registryMutex;        // zones and buffers being added
+
+static std::atomic<bool>   listening(false);     // anyone wanting events at all
+static std::atomic<bool>   histograms(false);
+static std::atomic<long>   dropped(0);
+
+static FILE*               trace      = NULL;
+static bool                traceFirst = true;    // no comma before the first event
+static unsigned long long  epoch      = 0;       // trace time zero (ns)
+
+// histograms, only touched by the drain thread and (under statsMutex) readers
+static long                current[PROFILER_ZONES][PROFILER_BUCKETS];
+static long                last[PROFILER_ZONES][PROFILER_BUCKETS];
+static long                total[PROFILER_ZONES][PROFILER_BUCKETS];
+static std::mutex          statsMutex;
+
+static std::thread             drainer;
+static std::mutex              drainMutex;      // only for sleeping on
+static std::condition_variable drainWake;
+static bool                    stopping = false;
+
+//#==============================================================================
+//# * now
+//#------------------------------------------------------------------------------
+//# Steady clock in ns; never 0, which profilerBegin uses for "not timing"
+//#==============================================================================
+static unsigned long long now()
+{
+  return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count() + 1;
+}
+
+//#==============================================================================
+//# * bucketOf / bucketValue
+//#------------------------------------------------------------------------------
+//# Histogram buckets are four to each power of two, so any duration is known
+//# to within about 12%. Value is the middle of a bucket, in ns.
+//#==============================================================================
+static int bucketOf(unsigned long long ns)
+{
+  if(ns < 4) return (int)ns;
+  int top = 2;
+  while((ns >> (top + 1)) != 0) top++;
+  int bucket = top * 4 + (int)((ns >> (top - 2)) & 3);
+  return bucket < PROFILER_BUCKETS ? bucket : PROFILER_BUCKETS - 1;
+}
+
+static double bucketValue(int bucket)
+{
+  if(bucket < 4) return bucket;
+  int top = bucket / 4;
+  double width = (double)(1ULL << (top - 2));
+  return (4 + bucket % 4) * width + width * 0.5;
+}
+
+//#==============================================================================
+//# * percentile
+//#------------------------------------------------------------------------------
+//# The duration (s) that fraction "p" of a histogram's events took at most
+//#==============================================================================
+static double percentile(const long* histogram, long count, double p)
+{
+  if(count == 0) return 0;
+  long wanted = (long)(p * count + 0.5), seen = 0;
+  if(wanted < 1) wanted = 1;
+  for( int b = 0; b < PROFILER_BUCKETS; b++)
+  {
+    seen += histogram[b];
+    if(seen >= wanted) return bucketValue(b) * 1E-9;
+  }
+  return bucketValue(PROFILER_BUCKETS - 1) * 1E-9;
+}
+
+//#==============================================================================
+//# * drain
+//#------------------------------------------------------------------------------
+//# Empties every thread's ring into the trace and the histograms. The trace
+//# is only written from here, so statsMutex is just held for the counting.
+//#==============================================================================
+static void drain()
+{
+  const bool counting = histograms.load(std::memory_order_relaxed);
+  const int  threads  = bufferCount.load(std::memory_order_acquire);
+  for( int t = 0; t < threads; t++)
+  {
+    tagProfilerBuffer* buffer = buffers[t];
+    unsigned long first = buffer->tail.load(std::memory_order_relaxed);
+    unsigned long end   = buffer->head.load(std::memory_order_acquire);
+    for( unsigned long i = first; i < end && trace != NULL; i++)
+    {
+      const tagProfilerEvent* event = &buffer->ring[i & (PROFILER_RING - 1)];
+      fprintf(trace, "%s{\"name\":\"%s\",\"cat\":\"solar\",\"ph\":\"X\",\"pid\":1,"
+                     "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+              traceFirst ? "" : ",\n", zoneNames[event->zone], buffer->id,
+              (event->start - epoch) * 1E-3, event->duration * 1E-3);
+      traceFirst = false;
+    }
+    if(counting)
+    {
+      std::lock_guard<std::mutex> lock(statsMutex);
+      for( unsigned long i = first; i < end; i++)
+      {
+        const tagProfilerEvent* event = &buffer->ring[i & (PROFILER_RING - 1)];
+        int bucket = bucketOf(event->duration);
+        current[event->zone][bucket]++;
+        total[event->zone][bucket]++;
+      }
+    }
+    buffer->tail.store(end, std::memory_order_release);
+  }
+}
+
+//#==============================================================================
+//# * drainMain
+//#------------------------------------------------------------------------------
+//# Background thread: drains the rings every PROFILER_DRAIN seconds and
+//# starts a new histogram window every PROFILER_WINDOW, until told to stop
+//#==============================================================================
+static void drainMain()
+{
+  unsigned long long windowStart = now();
+  std::unique_lock<std::mutex> lock(drainMutex);
+  while(!stopping)
+  {
+    drainWake.wait_for(lock, std::chrono::duration<double>(PROFILER_DRAIN));
+    lock.unlock();
+    drain();
+    unsigned long long time = now();
+    if(time - windowStart >= (unsigned long long)(PROFILER_WINDOW * 1E9))
+    {
+      std::lock_guard<std::mutex> stats(statsMutex);
+      memcpy(last, current, sizeof(last));
+      memset(current, 0, sizeof(current));
+      windowStart = time;
+    }
+    lock.lock();
+  }
+  lock.unlock();
+  drain();
+}
+
+//#==============================================================================
+//# * profilerStart
+//#------------------------------------------------------------------------------
+//# Starts draining the zones, writing every event to a Chrome trace at
+//# "tracePath" (NULL for no trace, only the histograms when they're turned
+//# on). Returns false if the trace can't be written.
+//#==============================================================================
+bool profilerStart(const char* tracePath)
+{
+  static bool registered = false;
+  profilerStop();
+
+  if(tracePath != NULL)
+  {
+    trace = fopen(tracePath, "w");
+    if(trace == NULL) return false;
+    fprintf(trace, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    traceFirst = true;
+  }
+  epoch    = now();
+  stopping = false;
+  memset(current, 0, sizeof(current));
+  memset(last,    0, sizeof(last));
+  memset(total,   0, sizeof(total));
+  drainer = std::thread(drainMain);
+  listening.store(trace != NULL || histograms.load());
+
+  if(!registered)
+  {
+    atexit(profilerStop);
+    registered = true;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * profilerStop
+//#------------------------------------------------------------------------------
+//# Drains what is left, names the threads and finishes off the trace
+//#==============================================================================
+void profilerStop()
+{
+  listening.store(false);
+  if(drainer.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(drainMutex);
+      stopping = true;
+    }
+    drainWake.notify_one();
+    drainer.join();
+  }
+  if(trace != NULL)
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for( int t = 0; t < bufferCount.load(); t++)
+    {
+      fprintf(trace, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                     "\"args\":{\"name\":\"%s\"}}", traceFirst ? "" : ",\n",
+              buffers[t]->id, buffers[t]->name);
+      traceFirst = false;
+    }
+    fprintf(trace, "\n]}\n");
+    fclose(trace);
+    trace = NULL;
+  }
+}
+
+//#==============================================================================
+//# * profilerZone
+//#------------------------------------------------------------------------------
+//# Registers a zone name (a string literal, kept as it is) once per call site
+//# and returns its number, or -1 once there are PROFILER_ZONES of them.
+//# Sites with the same name share a zone.
+//#==============================================================================
+int profilerZone(const char* name)
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for( int z = 0; z < zoneCount; z++)
+  {
+    if(strcmp(zoneNames[z], name) == 0) return z;
+  }
+  if(zoneCount == PROFILER_ZONES) return -1;
+  zoneNames[zoneCount] = name;
+  return zoneCount++;
+}
+
+//#==============================================================================
+//# * attach
+//#------------------------------------------------------------------------------
+//# The calling thread's ring, made on first use (NULL if they've run out)
+//#==============================================================================
+static tagProfilerBuffer* attach()
+{
+  if(localBuffer != NULL || localTried) return localBuffer;
+  localTried = true;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  int count = bufferCount.load();
+  if(count == PROFILER_THREADS) return NULL;
+
+  tagProfilerBuffer* buffer = new tagProfilerBuffer;
+  buffer->head.store(0);
+  buffer->tail.store(0);
+  buffer->id = count + 1;
+  snprintf(buffer->name, sizeof(buffer->name), "thread %d", buffer->id);
+  buffers[count] = buffer;
+  bufferCount.store(count + 1, std::memory_order_release);
+  localBuffer = buffer;
+  return buffer;
+}
+
+//#==============================================================================
+//# * profilerNameThread
+//#------------------------------------------------------------------------------
+//# What the calling thread is called in the trace. Without timing zones there
+//# is no trace, so no ring is set up for it.
+//#==============================================================================
+void profilerNameThread(const char* name)
+{
+#ifdef SOLAR_PROFILE
+  tagProfilerBuffer* buffer = attach();
+  if(buffer == NULL) return;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+#else
+  (void)name;
+#endif
+}
+
+//#==============================================================================
+//# * profilerSetHistograms / profilerHistograms
+//#------------------------------------------------------------------------------
+//# Turns the p50 / p99 histograms on or off while running
+//#==============================================================================
+void profilerSetHistograms(bool enabled)
+{
+  histograms.store(enabled);
+  listening.store(enabled || trace != NULL);
+}
+
+bool profilerHistograms()
+{
+  return histograms.load();
+}
+
+//#==============================================================================
+//# * profilerStats
+//#------------------------------------------------------------------------------
+//# Fills in up to "max" zones' timings, in the order the zones were first
+//# reached, and returns how many. Zones never timed are left out.
+//#==============================================================================
+int profilerStats(tagProfilerStats* stats, int max)
+{
+  int zones;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    zones = zoneCount;
+  }
+  std::lock_guard<std::mutex> lock(statsMutex);
+  int filled = 0;
+  for( int z = 0; z < zones && filled < max; z++)
+  {
+    long count = 0, totalCount = 0;
+    for( int b = 0; b < PROFILER_BUCKETS; b++)
+    {
+      count      += last[z][b];
+      totalCount += total[z][b];
+    }
+    if(totalCount == 0) continue;
+    tagProfilerStats* zone = &stats[filled++];
+    zone->name       = zoneNames[z];
+    zone->count      = count;
+    zone->p50        = percentile(last[z], count, 0.50);
+    zone->p99        = percentile(last[z], count, 0.99);
+    zone->totalCount = totalCount;
+    zone->totalP50   = percentile(total[z], totalCount, 0.50);
+    zone->totalP99   = percentile(total[z], totalCount, 0.99);
+  }
+  return filled;
+}
+
+long profilerDropped()
+{
+  return dropped.load(std::memory_order_relaxed);
+}
+
+//#==============================================================================
+//# * profilerBegin / profilerEnd
+//#------------------------------------------------------------------------------
+//# The hot path. Begin is 0 unless something is listening; End queues the
+//# event on the thread's own ring without ever blocking.
+//#==============================================================================
+unsigned long long profilerBegin()
+{
+  return listening.load(std::memory_order_relaxed) ? now() : 0;
+}
+
+void profilerEnd(int zone, unsigned long long start)
+{
+  unsigned long long end = now();
+  tagProfilerBuffer* buffer = attach();
+  if(buffer == NULL || zone < 0) return;
+  unsigned long next = buffer->head.load(std::memory_order_relaxed);
+  if(next - buffer->tail.load(std::memory_order_acquire) >= PROFILER_RING)
+  {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  tagProfilerEvent* event = &buffer->ring[next & (PROFILER_RING - 1)];
+  event->start    = start;
+  event->duration = end - start;
+  event->zone     = zone;
+  buffer->head.store(next + 1, std::memory_order_release);
+}
@@ -0,0 +1,80 @@
+/*
+#================================================================================
+# * Profiler                Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Scoped timing zones. PROFILE_ZONE("name") at the top of a block times the
+# rest of the block. Each thread pushes its events into a lock-free single
+# producer / single consumer ring of its own; a background thread drains the
+# rings, writing the events to a Chrome / Perfetto trace (chrome://tracing,
+# ui.perfetto.dev) and adding them to per zone histograms for p50 / p99.
+#
+# Zones cost one call and a flag check when nothing is listening, and
+# nothing at all in a build configured with -DSOLAR_PROFILE=OFF. A full ring
+# drops events (counted) rather than waiting.
+#================================================================================
+*/
+#ifndef SOLAR_PROFILER_H
+#define SOLAR_PROFILER_H
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define PROFILER_ZONES   32     // distinct zones
+#define PROFILER_THREADS 64     // threads that can record
+#define PROFILER_RING    8192   // events each thread's ring holds (a power of two)
+#define PROFILER_BUCKETS 192    // histogram buckets, four per doubling of ns
+#define PROFILER_WINDOW  1.0    // seconds each rolling histogram covers
+
+#ifdef SOLAR_PROFILE
+# define PROFILE_JOIN2(a, b) a##b
+# define PROFILE_JOIN(a, b)  PROFILE_JOIN2(a, b)
+# define PROFILE_ZONE(name)                                                       \
+    static const int PROFILE_JOIN(profileZone, __LINE__) = profilerZone(name);    \
+    tagProfilerScope PROFILE_JOIN(profileScope, __LINE__)(PROFILE_JOIN(profileZone, __LINE__))
+#else
+# define PROFILE_ZONE(name)
+#endif
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagProfilerStats - one zone's timings
+typedef struct
+{
+  const char* name;
+  long   count;        // events in the last whole window
+  double p50;          // median duration in that window (s)
+  double p99;          // 99th percentile in that window (s)
+  long   totalCount;   // events since the profiler started
+  double totalP50;     // over all of them
+  double totalP99;
+}tagProfilerStats;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool profilerStart          ( const char* tracePath );
+void profilerStop           ( );
+int  profilerZone           ( const char* name );
+void profilerNameThread     ( const char* name );
+void profilerSetHistograms  ( bool enabled );
+bool profilerHistograms     ( );
+int  profilerStats          ( tagProfilerStats* stats, int max );
+long profilerDropped        ( );
+
+unsigned long long profilerBegin ( );
+void               profilerEnd   ( int zone, unsigned long long start );
+
+// tagProfilerScope - times from construction to the end of the scope
+struct tagProfilerScope
+{
+  int zone;
+  unsigned long long start;   // 0 if nothing was listening at the start
+  tagProfilerScope(int zone) : zone(zone), start(profilerBegin()) {}
+  ~tagProfilerScope() { if(start != 0) profilerEnd(zone, start); }
+};
+
+#endif // SOLAR_PROFILER_H
@@ -0,0 +1,146 @@
+/*
+#================================================================================
+# * Publisher               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Seqlock ring of steps in POSIX shared memory
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "publisher.h"
+#include <stdio.h>        // Header File for snprintf
+#include <string.h>       // Header File for memcpy/memset
+#ifndef _WIN32
+# include <fcntl.h>       // Header File for O_CREAT
+# include <sys/mman.h>    // Header File for shm_open/mmap
+# include <unistd.h>      // Header File for ftruncate/getpid
+#endif
+
+static_assert(sizeof(tagSharedHeader) == 64, "the segment header is 64 bytes");
+static_assert(sizeof(tagSharedSlot)   == 64, "a slot header is 64 bytes");
+
+//#==============================================================================
+//# * slotAt
+//#------------------------------------------------------------------------------
+//# The slot holding publication "index" (counting from zero)
+//#==============================================================================
+static tagSharedSlot* slotAt(tagSharedHeader* header, uint64_t index)
+{
+  unsigned char* first = (unsigned char*)(header + 1);
+  return (tagSharedSlot*)(first + (index % header->slots) * header->slotBytes);
+}
+
+//#==============================================================================
+//# * publisherCreate
+//#------------------------------------------------------------------------------
+//# Creates the segment "name" with room for "capacity" bodies a step. A
+//# segment left behind by an earlier run is unlinked first, so readers still
+//# holding it aren't cut off. "time" and "steps" are where the bodies are up
+//# to. Returns false if shared memory can't be had.
+//#==============================================================================
+bool publisherCreate(tagPublisher* publisher, const char* name, int capacity,
+                     double dt, double time, long steps)
+{
+  memset(publisher, 0, sizeof(*publisher));
+#ifdef _WIN32
+  (void)name; (void)capacity; (void)dt; (void)time; (void)steps;
+  return false;           // POSIX shared memory only
+#else
+  snprintf(publisher->name, sizeof(publisher->name), "%s%s", name[0] == '/' ? "" : "/", name);
+  uint64_t slotBytes = sizeof(tagSharedSlot)
+                     + sizeof(double) * SHARED_STATE_ARRAYS * (uint64_t)capacity;
+  slotBytes = (slotBytes + 63) & ~(uint64_t)63;   // every slot on its own cache lines
+  unsigned long size = (unsigned long)(sizeof(tagSharedHeader) + SHARED_STATE_SLOTS * slotBytes);
+
+  shm_unlink(publisher->name);
+  int file = shm_open(publisher->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if(file < 0) return false;
+  if(ftruncate(file, (off_t)size) != 0)
+  {
+    close(file);
+    shm_unlink(publisher->name);
+    return false;
+  }
+  void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  close(file);            // the mapping keeps the segment alive
+  if(data == MAP_FAILED)
+  {
+    shm_unlink(publisher->name);
+    return false;
+  }
+
+  tagSharedHeader* header = (tagSharedHeader*)data;   // already zero filled
+  header->version   = SHARED_STATE_VERSION;
+  header->slots     = SHARED_STATE_SLOTS;
+  header->capacity  = (uint32_t)capacity;
+  header->slotBytes = slotBytes;
+  header->dt        = dt;
+  header->writer    = (int32_t)getpid();
+  __atomic_store_n(&header->magic, SHARED_STATE_MAGIC, __ATOMIC_RELEASE);   // last
+  publisher->header = header;
+  publisher->size   = size;
+  publisher->time   = time;
+  publisher->steps  = steps;
+  return true;
+#endif
+}
+
+//#==============================================================================
+//# * publisherWrite
+//#------------------------------------------------------------------------------
+//# Publishes the bodies as they are after a step of "interval" seconds. The
+//# slot's sequence goes odd before anything in it changes and even again
+//# after, and only then is the step counted as published.
+//#==============================================================================
+void publisherWrite(tagPublisher* publisher, const tagBodies* bodies, double interval)
+{
+  publisher->time += interval;
+  publisher->steps++;
+  tagSharedHeader* header = publisher->header;
+  if(header == NULL) return;
+  if((uint32_t)bodies->count > header->capacity)
+  {
+    publisher->skipped++;
+    return;
+  }
+
+  const uint64_t published = header->published;   // only ever written here
+  tagSharedSlot* slot = slotAt(header, published);
+  const uint64_t sequence = slot->sequence;
+  __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->step  = (uint64_t)publisher->steps;
+  slot->time  = publisher->time;
+  slot->count = bodies->count;
+  const double* from[] = { bodies->x, bodies->y, bodies->z, bodies->vx, bodies->vy, bodies->vz,
+                           bodies->mass, bodies->radius };
+  const unsigned long size = sizeof(double) * (unsigned long)bodies->count;
+  for( int a = 0; a < SHARED_STATE_ARRAYS; a++)
+  {
+    memcpy((double*)sharedStateArray(slot, header->capacity, a), from[a], size);
+  }
+
+  __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&header->published, published + 1, __ATOMIC_RELEASE);
+}
+
+//#==============================================================================
+//# * publisherClose
+//#------------------------------------------------------------------------------
+//# Marks the segment closed for readers still attached and removes its name.
+//# Safe to call on a closed (or zeroed) publisher.
+//#==============================================================================
+void publisherClose(tagPublisher* publisher)
+{
+#ifndef _WIN32
+  if(publisher->header != NULL)
+  {
+    __atomic_store_n(&publisher->header->closed, 1u, __ATOMIC_RELEASE);
+    munmap(publisher->header, publisher->size);
+    shm_unlink(publisher->name);
+  }
+#endif
+  memset(publisher, 0, sizeof(*publisher));
+}
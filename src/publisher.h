@@ -0,0 +1,41 @@
+/*
+#================================================================================
+# * Publisher               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Writer side of --share: copies every step into a POSIX shared memory
+# segment (laid out in shared_state.h) for other processes to read in place.
+# Publishing is a handful of memcpys and never waits for a reader; a reader
+# that falls behind just sees the newest step when it next looks.
+#================================================================================
+*/
+#ifndef SOLAR_PUBLISHER_H
+#define SOLAR_PUBLISHER_H
+
+#include "bodies.h"
+#include "shared_state.h"
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagPublisher
+typedef struct
+{
+  tagSharedHeader* header;   // the mapped segment (NULL when closed)
+  unsigned long    size;     // bytes mapped
+  char             name[256];// segment name, with the leading '/'
+  double           time;     // simulated time of the next step published
+  long             steps;    // steps taken by then
+  long             skipped;  // steps with more bodies than a slot holds
+}tagPublisher;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool publisherCreate ( tagPublisher* publisher, const char* name, int capacity,
+                       double dt, double time, long steps );
+void publisherWrite  ( tagPublisher* publisher, const tagBodies* bodies, double interval );
+void publisherClose  ( tagPublisher* publisher );
+
+#endif // SOLAR_PUBLISHER_H
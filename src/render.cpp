@@ -0,0 +1,229 @@
+/*
+#================================================================================
+# * Render                  Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Cached sphere meshes, level of detail and point batching
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "render.h"
+#include "bodies.h"
+#include "profiler.h"
+#include <GL/gl.h>        // Header File for the OpenGL Library
+#include <math.h>         // Header File for the math library
+#include <string.h>       // Header File for memset
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define RENDER_PI 3.14159265358979323846
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagPointBatch - points of one size waiting to be drawn
+typedef struct
+{
+  float* points;     // x y z r g b of each point
+  int    count;
+  int    capacity;
+}tagPointBatch;
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// constants:
+
+// slices and stacks of each level, and the largest on-screen radius (pixels)
+// it is used for. The finest level matches the old glutSolidSphere(r, 30, 30).
+static const int   lodSlices[RENDER_LODS] = { 12, 20, 30 };
+static const int   lodStacks[RENDER_LODS] = {  8, 14, 30 };
+static const float lodPixels[RENDER_LODS] = { 24, 64, 1E30f };
+
+// statics:
+static GLuint lists = 0;             // first of RENDER_LODS display lists
+static double modelview[16];         // camera transform for the frame
+static double pixelsPerUnit = 1;     // screen radius of 1 unit at distance 1
+static tagRenderStats stats;
+static tagPointBatch  batches[RENDER_POINT_SIZES];   // by diameter - 1
+
+//#==============================================================================
+//# * buildSphere
+//#------------------------------------------------------------------------------
+//# Emits a unit sphere as one triangle strip per stack, with normals so that
+//# it can be lit
+//#==============================================================================
+static void buildSphere(int slices, int stacks)
+{
+  for( int stack = 0; stack < stacks; stack++)
+  {
+    double phi0 = RENDER_PI * stack / stacks - RENDER_PI * 0.5;
+    double phi1 = RENDER_PI * (stack + 1) / stacks - RENDER_PI * 0.5;
+    glBegin(GL_TRIANGLE_STRIP);
+    for( int slice = 0; slice <= slices; slice++)
+    {
+      double theta = 2.0 * RENDER_PI * (slice % slices) / slices;
+      double c = cos(theta), s = sin(theta);
+      double x1 = c * cos(phi1), y1 = s * cos(phi1), z1 = sin(phi1);
+      double x0 = c * cos(phi0), y0 = s * cos(phi0), z0 = sin(phi0);
+      glNormal3d(x1, y1, z1);  glVertex3d(x1, y1, z1);
+      glNormal3d(x0, y0, z0);  glVertex3d(x0, y0, z0);
+    }
+    glEnd();
+  }
+}
+
+//#==============================================================================
+//# * renderInit
+//#------------------------------------------------------------------------------
+//# Tessellates the spheres. Needs a current GL context.
+//#==============================================================================
+void renderInit()
+{
+  if(lists != 0) return;
+  PROFILE_ZONE("sphere meshes");
+  lists = glGenLists(RENDER_LODS);
+  for( int lod = 0; lod < RENDER_LODS; lod++)
+  {
+    glNewList(lists + lod, GL_COMPILE);
+    buildSphere(lodSlices[lod], lodStacks[lod]);
+    glEndList();
+  }
+}
+
+//#==============================================================================
+//# * renderBegin
+//#------------------------------------------------------------------------------
+//# Starts a frame. The modelview matrix must already hold the camera; fovy
+//# (degrees) and the viewport height turn sizes into pixels.
+//#==============================================================================
+void renderBegin(double fovy, int viewportHeight)
+{
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+  pixelsPerUnit = viewportHeight * 0.5 / tan(fovy * 0.5 * RENDER_PI / 180.0);
+  memset(&stats, 0, sizeof(stats));
+  for( int size = 0; size < RENDER_POINT_SIZES; size++) batches[size].count = 0;
+}
+
+//#==============================================================================
+//# * batchAdd
+//#------------------------------------------------------------------------------
+//# Queues a point, growing the batch if needed
+//#==============================================================================
+static void batchAdd(tagPointBatch* batch, float x, float y, float z,
+                     float red, float green, float blue)
+{
+  if(batch->count == batch->capacity)
+  {
+    int capacity = batch->capacity > 0 ? batch->capacity * 2 : 1024;
+    float* grown = (float*)alignedAlloc(sizeof(float) * 6 * (unsigned long)capacity);
+    if(batch->points != NULL)
+    {
+      memcpy(grown, batch->points, sizeof(float) * 6 * (unsigned long)batch->count);
+      alignedFree(batch->points);
+    }
+    batch->points   = grown;
+    batch->capacity = capacity;
+  }
+  float* point = batch->points + 6 * batch->count++;
+  point[0] = x;    point[1] = y;      point[2] = z;
+  point[3] = red;  point[4] = green;  point[5] = blue;
+}
+
+//#==============================================================================
+//# * renderSphere
+//#------------------------------------------------------------------------------
+//# Draws a sphere at (x, y, z) in world units, or queues a point for it if it
+//# would only be a few pixels across
+//#==============================================================================
+void renderSphere(float x, float y, float z, float radius,
+                  float red, float green, float blue)
+{
+  // distance in front of the camera
+  double depth = -(modelview[2] * x + modelview[6] * y + modelview[10] * z + modelview[14]);
+  if(depth <= 0) return;                        // behind the camera
+  double pixels = radius * pixelsPerUnit / depth;
+
+  // unlit, a small sphere is just a disc, which a round point draws exactly.
+  // Compared before rounding: close up, pixels is far beyond what an int holds.
+  if(pixels * 2.0 + 0.5 < RENDER_POINT_SIZES + 1)
+  {
+    int diameter = (int)(pixels * 2.0 + 0.5);
+    batchAdd(&batches[diameter > 1 ? diameter - 1 : 0], x, y, z, red, green, blue);
+    stats.points++;
+    return;
+  }
+
+  int lod = 0;
+  while(lod < RENDER_LODS - 1 && pixels > lodPixels[lod]) lod++;
+  stats.spheres[lod]++;
+
+  glColor3f(red, green, blue);
+  glPushMatrix();
+  glTranslatef(x, y, z);
+  glScalef(radius, radius, radius);
+  glCallList(lists + lod);
+  glPopMatrix();
+  stats.calls++;
+}
+
+//#==============================================================================
+//# * renderEnd
+//#------------------------------------------------------------------------------
+//# Draws every queued point, one call per point size
+//#==============================================================================
+void renderEnd()
+{
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  for( int size = 0; size < RENDER_POINT_SIZES; size++)
+  {
+    tagPointBatch* batch = &batches[size];
+    if(batch->count == 0) continue;
+    if(size > 0) glEnable(GL_POINT_SMOOTH);
+    glPointSize((float)(size + 1));
+    glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), batch->points);
+    glColorPointer(3, GL_FLOAT, 6 * sizeof(float), batch->points + 3);
+    glDrawArrays(GL_POINTS, 0, batch->count);
+    if(size > 0) glDisable(GL_POINT_SMOOTH);
+    batch->count = 0;
+    stats.calls++;
+  }
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+//#==============================================================================
+//# * renderPoints
+//#------------------------------------------------------------------------------
+//# Draws "count" points (x y z each) of one colour in one call. Points wider
+//# than a pixel are smoothed so they come out round.
+//#==============================================================================
+void renderPoints(const float* vertices, int count, float size,
+                  float red, float green, float blue)
+{
+  if(count == 0) return;
+  if(size > 1) glEnable(GL_POINT_SMOOTH);
+  glColor3f(red, green, blue);
+  glPointSize(size);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, vertices);
+  glDrawArrays(GL_POINTS, 0, count);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  if(size > 1) glDisable(GL_POINT_SMOOTH);
+  stats.calls++;
+}
+
+//#==============================================================================
+//# * renderStats
+//#------------------------------------------------------------------------------
+//# Counts of what the last frame drew
+//#==============================================================================
+const tagRenderStats* renderStats()
+{
+  return &stats;
+}
@@ -0,0 +1,50 @@
+/*
+#================================================================================
+# * Render                  Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Drawing of the bodies. Sphere meshes are tessellated once into display
+# lists at a few levels of detail, and each body is drawn with the coarsest
+# one that still looks round at its size on screen. Bodies only a few pixels
+# across are not worth a mesh at all: they are collected into batches of
+# round points, one batch (and one draw call) per point size, which is what
+# keeps tens of thousands of bodies cheap. Only OpenGL 1.1 is used, so this
+# runs on anything down to Mesa's llvmpipe software renderer.
+#================================================================================
+*/
+#ifndef SOLAR_RENDER_H
+#define SOLAR_RENDER_H
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define RENDER_LODS        3    // number of sphere levels of detail
+#define RENDER_POINT_SIZES 16   // largest diameter (pixels) drawn as a point
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagRenderStats - what the last frame drew
+typedef struct
+{
+  int spheres[RENDER_LODS];   // bodies drawn with each level of detail
+  int points;                 // bodies drawn as points
+  int calls;                  // draw calls (display lists and batches)
+}tagRenderStats;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void renderInit   ( );
+void renderBegin  ( double fovy, int viewportHeight );
+void renderSphere ( float x, float y, float z, float radius,
+                    float red, float green, float blue );
+void renderEnd    ( );
+void renderPoints ( const float* vertices, int count, float size,
+                    float red, float green, float blue );
+
+const tagRenderStats* renderStats ( );
+
+#endif // SOLAR_RENDER_H
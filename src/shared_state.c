@@ -0,0 +1,209 @@
+/*
+#================================================================================
+# * Shared State            Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Reader side of the --share segment: maps it read-only and takes consistent
+# views or copies of the newest step without ever holding up the writer
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "shared_state.h"
+#include <stdio.h>        // Header File for snprintf
+#include <string.h>       // Header File for memcpy/memset
+#ifndef _WIN32
+# include <fcntl.h>       // Header File for O_RDONLY
+# include <sys/mman.h>    // Header File for shm_open/mmap
+# include <sys/stat.h>    // Header File for fstat
+# include <unistd.h>      // Header File for close
+# include <signal.h>      // Header File for kill
+# include <errno.h>       // Header File for errno
+#endif
+
+_Static_assert(sizeof(tagSharedHeader) == 64, "the segment header is 64 bytes");
+_Static_assert(sizeof(tagSharedSlot)   == 64, "a slot header is 64 bytes");
+
+//#==============================================================================
+//# * slotAt
+//#------------------------------------------------------------------------------
+//# The slot holding publication "index" (counting from zero)
+//#==============================================================================
+static const tagSharedSlot* slotAt(const tagSharedHeader* header, uint64_t index)
+{
+  const unsigned char* first = (const unsigned char*)(header + 1);
+  return (const tagSharedSlot*)(first + (index % header->slots) * header->slotBytes);
+}
+
+//#==============================================================================
+//# * sharedStateOpen
+//#------------------------------------------------------------------------------
+//# Maps the segment the simulator was given with --share NAME (with or
+//# without the leading '/'). Returns false if there is no such segment or it
+//# isn't one of ours.
+//#==============================================================================
+bool sharedStateOpen(tagSharedReader* reader, const char* name)
+{
+  memset(reader, 0, sizeof(*reader));
+#ifdef _WIN32
+  (void)name;
+  return false;           // POSIX shared memory only
+#else
+  char path[256];
+  snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+  int file = shm_open(path, O_RDONLY, 0);
+  if(file < 0) return false;
+  struct stat info;
+  if(fstat(file, &info) != 0 || (unsigned long long)info.st_size < sizeof(tagSharedHeader))
+  {
+    close(file);
+    return false;
+  }
+  void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0);
+  close(file);            // the mapping keeps the segment alive
+  if(data == MAP_FAILED) return false;
+
+  const tagSharedHeader* header = (const tagSharedHeader*)data;
+  unsigned long long needed = sizeof(tagSharedHeader)
+                            + (unsigned long long)header->slots * header->slotBytes;
+  if(header->magic != SHARED_STATE_MAGIC || header->version != SHARED_STATE_VERSION ||
+     header->slots == 0 || needed > (unsigned long long)info.st_size)
+  {
+    munmap(data, (size_t)info.st_size);
+    return false;
+  }
+  reader->header = header;
+  reader->size   = (unsigned long long)info.st_size;
+  return true;
+#endif
+}
+
+//#==============================================================================
+//# * sharedStateClose
+//#------------------------------------------------------------------------------
+//# Unmaps the segment. Safe to call on a closed (or zeroed) reader.
+//#==============================================================================
+void sharedStateClose(tagSharedReader* reader)
+{
+#ifndef _WIN32
+  if(reader->header != NULL) munmap((void*)reader->header, (size_t)reader->size);
+#endif
+  memset(reader, 0, sizeof(*reader));
+}
+
+//#==============================================================================
+//# * sharedStatePublished / sharedStateClosed
+//#------------------------------------------------------------------------------
+//# How many steps have been published, and whether any more will be. Cheap
+//# enough to poll.
+//#==============================================================================
+uint64_t sharedStatePublished(const tagSharedReader* reader)
+{
+  return __atomic_load_n(&reader->header->published, __ATOMIC_ACQUIRE);
+}
+
+bool sharedStateClosed(const tagSharedReader* reader)
+{
+  return __atomic_load_n(&reader->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+//#==============================================================================
+//# * sharedStateWriterAlive
+//#------------------------------------------------------------------------------
+//# Whether the simulator that made the segment is still running. One that
+//# was killed never sets "closed", so poll this too when waiting for steps.
+//#==============================================================================
+bool sharedStateWriterAlive(const tagSharedReader* reader)
+{
+#ifdef _WIN32
+  (void)reader;
+  return false;
+#else
+  return kill((pid_t)reader->header->writer, 0) == 0 || errno == EPERM;
+#endif
+}
+
+//#==============================================================================
+//# * sharedStateLatest
+//#------------------------------------------------------------------------------
+//# Points "view" at the newest complete step, in place. Read what's needed
+//# through it, then call sharedStateValid: if that says no, the writer reused
+//# the slot meanwhile and what was read must be thrown away. Returns false if
+//# nothing has been published yet, or if the newest slot was still being
+//# written after SHARED_STATE_RETRIES looks (a writer that died part way
+//# through leaves it that way: see sharedStateWriterAlive).
+//#==============================================================================
+bool sharedStateLatest(const tagSharedReader* reader, tagSharedView* view)
+{
+  const tagSharedHeader* header = reader->header;
+  const uint32_t capacity = header->capacity;
+  for( int attempt = 0; attempt < SHARED_STATE_RETRIES; attempt++)
+  {
+    uint64_t published = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+    if(published == 0) return false;
+    const tagSharedSlot* slot = slotAt(header, published - 1);
+    uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if(sequence & 1) continue;     // lapped already: being rewritten
+
+    view->sequence = sequence;
+    view->slot     = slot;
+    view->step     = slot->step;
+    view->time     = slot->time;
+    view->count    = slot->count;
+    view->x        = sharedStateArray(slot, capacity, SHARED_STATE_X);
+    view->y        = sharedStateArray(slot, capacity, SHARED_STATE_Y);
+    view->z        = sharedStateArray(slot, capacity, SHARED_STATE_Z);
+    view->vx       = sharedStateArray(slot, capacity, SHARED_STATE_VX);
+    view->vy       = sharedStateArray(slot, capacity, SHARED_STATE_VY);
+    view->vz       = sharedStateArray(slot, capacity, SHARED_STATE_VZ);
+    view->mass     = sharedStateArray(slot, capacity, SHARED_STATE_MASS);
+    view->radius   = sharedStateArray(slot, capacity, SHARED_STATE_RADIUS);
+    if(view->count < 0 || (uint32_t)view->count > capacity) view->count = 0;
+    if(sharedStateValid(reader, view)) return true;
+  }
+  return false;
+}
+
+//#==============================================================================
+//# * sharedStateValid
+//#------------------------------------------------------------------------------
+//# True if nothing read through "view" since sharedStateLatest can have been
+//# torn by the writer
+//#==============================================================================
+bool sharedStateValid(const tagSharedReader* reader, const tagSharedView* view)
+{
+  (void)reader;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&view->slot->sequence, __ATOMIC_RELAXED) == view->sequence;
+}
+
+//#==============================================================================
+//# * sharedStateRead
+//#------------------------------------------------------------------------------
+//# Copies the newest complete step into "frame". Returns false if nothing has
+//# been published yet, or if the writer kept lapping the copy (only likely
+//# with a great many bodies on a slow machine).
+//#==============================================================================
+bool sharedStateRead(const tagSharedReader* reader, tagSharedFrame* frame)
+{
+  for( int attempt = 0; attempt < SHARED_STATE_RETRIES; attempt++)
+  {
+    tagSharedView view;
+    if(!sharedStateLatest(reader, &view)) return false;
+    const size_t size = sizeof(double) * (size_t)view.count;
+    const double* from[] = { view.x, view.y, view.z, view.vx, view.vy, view.vz,
+                             view.mass, view.radius };
+    double* to[] = { frame->x, frame->y, frame->z, frame->vx, frame->vy, frame->vz,
+                     frame->mass, frame->radius };
+    for( int a = 0; a < SHARED_STATE_ARRAYS; a++)
+    {
+      if(to[a] != NULL) memcpy(to[a], from[a], size);
+    }
+    if(!sharedStateValid(reader, &view)) continue;
+    frame->step  = view.step;
+    frame->time  = view.time;
+    frame->count = view.count;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,154 @@
+/*
+#================================================================================
+# * Shared State            Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Layout of the shared memory segment --share publishes every step into, and
+# the reader library for other processes. Plain C, so plotters and analysis
+# tools can include it without the rest of the simulator.
+#
+# The segment is a header followed by a ring of slots, each holding one whole
+# step. The writer fills the slots in turn and never waits for a reader. A
+# slot's sequence is odd while it is being written and goes up by two each
+# time it is, so a reader notes the sequence, reads the slot in place and
+# checks the sequence again: if it changed, the writer came round the ring
+# while it was reading and it tries the newest slot again.
+#
+#   header     64 bytes (tagSharedHeader)
+#   slot 0     64 bytes (tagSharedSlot), then x, y, z, vx, vy, vz, mass and
+#              radius, "capacity" doubles each
+#   slot 1     at header + 64 + slotBytes, and so on for "slots" slots
+#
+# Values are in the machine's own byte order. Positions are meters, velocities
+# meters per second, masses kilograms, times seconds from the start.
+#================================================================================
+*/
+#ifndef SOLAR_SHARED_STATE_H
+#define SOLAR_SHARED_STATE_H
+
+#include <stdbool.h>      // Header File for bool in C
+#include <stdint.h>       // Header File for fixed width integers
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define SHARED_STATE_MAGIC   0x534C4F53u   // "SOLS"
+#define SHARED_STATE_VERSION 1
+#define SHARED_STATE_SLOTS   4    // steps in the ring
+#define SHARED_STATE_ARRAYS  8    // x, y, z, vx, vy, vz, mass, radius
+#define SHARED_STATE_RETRIES 64   // attempts at a consistent copy before giving up
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of the arrays after each slot header
+enum
+{
+  SHARED_STATE_X = 0,
+  SHARED_STATE_Y,
+  SHARED_STATE_Z,
+  SHARED_STATE_VX,
+  SHARED_STATE_VY,
+  SHARED_STATE_VZ,
+  SHARED_STATE_MASS,
+  SHARED_STATE_RADIUS
+};
+
+// tagSharedHeader - start of the segment
+typedef struct
+{
+  uint32_t magic;       // SHARED_STATE_MAGIC
+  uint32_t version;     // SHARED_STATE_VERSION
+  uint32_t slots;       // slots in the ring
+  uint32_t capacity;    // bodies each slot has room for
+  uint64_t slotBytes;   // from one slot to the next, header included
+  uint64_t published;   // steps published; the newest is in slot (published - 1) % slots
+  double   dt;          // simulated seconds per step
+  int32_t  writer;      // process id of the simulator
+  uint32_t closed;      // 1 once the simulator has stopped publishing
+  uint8_t  reserved[16];
+}tagSharedHeader;
+
+// tagSharedSlot - one published step
+typedef struct
+{
+  uint64_t sequence;    // odd while being written, up by two per write
+  uint64_t step;        // steps taken since the start
+  double   time;        // simulated time of the step (s)
+  int32_t  count;       // bodies in this step (the rest of the arrays is unused)
+  uint8_t  reserved[36];
+}tagSharedSlot;
+
+// tagSharedReader
+typedef struct
+{
+  const tagSharedHeader* header;   // the mapped segment (NULL when closed)
+  unsigned long long     size;     // bytes mapped
+}tagSharedReader;
+
+// tagSharedView - a step read in place. The pointers are into the segment,
+// so check sharedStateValid once done with them.
+typedef struct
+{
+  uint64_t      sequence;   // of the slot when the view was taken
+  uint64_t      step;
+  double        time;
+  int           count;
+  const double* x;
+  const double* y;
+  const double* z;
+  const double* vx;
+  const double* vy;
+  const double* vz;
+  const double* mass;
+  const double* radius;
+  const tagSharedSlot* slot;
+}tagSharedView;
+
+// tagSharedFrame - a step copied out. Each array must hold the segment's
+// capacity; any left NULL is skipped.
+typedef struct
+{
+  uint64_t step;
+  double   time;
+  int      count;
+  double*  x;
+  double*  y;
+  double*  z;
+  double*  vx;
+  double*  vy;
+  double*  vz;
+  double*  mass;
+  double*  radius;
+}tagSharedFrame;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool     sharedStateOpen      ( tagSharedReader* reader, const char* name );
+void     sharedStateClose     ( tagSharedReader* reader );
+uint64_t sharedStatePublished ( const tagSharedReader* reader );
+bool     sharedStateClosed    ( const tagSharedReader* reader );
+bool     sharedStateWriterAlive ( const tagSharedReader* reader );
+bool     sharedStateLatest    ( const tagSharedReader* reader, tagSharedView* view );
+bool     sharedStateValid     ( const tagSharedReader* reader, const tagSharedView* view );
+bool     sharedStateRead      ( const tagSharedReader* reader, tagSharedFrame* frame );
+
+// One of the SHARED_STATE_* arrays of a slot
+static inline const double* sharedStateArray(const tagSharedSlot* slot, uint32_t capacity,
+                                             int array)
+{
+  return (const double*)(slot + 1) + (uint64_t)capacity * (uint64_t)array;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SOLAR_SHARED_STATE_H
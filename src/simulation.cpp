@@ -0,0 +1,298 @@
+/*
+#================================================================================
+# * Simulation              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Fixed-step physics thread feeding the display through a triple buffer
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "simulation.h"
+#include "physics.h"
+#include "clock.h"
+#include "profiler.h"
+#include <string.h>       // Header File for memcpy/memset
+#include <chrono>         // Header File for std::chrono
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define SIMULATION_BATCH 0.008  // longest (real) time spent stepping before
+                                // publishing a snapshot, in seconds
+#define SIMULATION_LAG   0.25   // most real time the physics may fall behind
+                                // before the extra time is dropped
+
+//#==============================================================================
+//# * snapshotReserve / snapshotFree
+//#------------------------------------------------------------------------------
+//# Sizes the arrays of a snapshot
+//#==============================================================================
+static void snapshotReserve(tagSnapshot* snapshot, int capacity)
+{
+  if(capacity <= snapshot->capacity) return;
+  double** arrays[] = { &snapshot->x0, &snapshot->y0, &snapshot->z0,
+                        &snapshot->x1, &snapshot->y1, &snapshot->z1,
+                        &snapshot->radius };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    if(*arrays[i] != NULL) alignedFree(*arrays[i]);
+    *arrays[i] = (double*)alignedAlloc(sizeof(double) * (unsigned long)capacity);
+  }
+  snapshot->capacity = capacity;
+}
+
+static void snapshotReserveParticles(tagSnapshot* snapshot, int capacity)
+{
+  if(capacity <= snapshot->particleCapacity) return;
+  float** arrays[] = { &snapshot->px0, &snapshot->py0, &snapshot->pz0,
+                       &snapshot->px1, &snapshot->py1, &snapshot->pz1 };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    if(*arrays[i] != NULL) alignedFree(*arrays[i]);
+    *arrays[i] = (float*)alignedAlloc(sizeof(float) * (unsigned long)capacity);
+  }
+  snapshot->particleCapacity = capacity;
+}
+
+static void snapshotFree(tagSnapshot* snapshot)
+{
+  double** arrays[] = { &snapshot->x0, &snapshot->y0, &snapshot->z0,
+                        &snapshot->x1, &snapshot->y1, &snapshot->z1,
+                        &snapshot->radius };
+  for( unsigned i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+  {
+    if(*arrays[i] != NULL) alignedFree(*arrays[i]);
+    *arrays[i] = NULL;
+  }
+  float** particleArrays[] = { &snapshot->px0, &snapshot->py0, &snapshot->pz0,
+                               &snapshot->px1, &snapshot->py1, &snapshot->pz1 };
+  for( unsigned i = 0; i < sizeof(particleArrays)/sizeof(particleArrays[0]); i++)
+  {
+    if(*particleArrays[i] != NULL) alignedFree(*particleArrays[i]);
+    *particleArrays[i] = NULL;
+  }
+  snapshot->capacity         = 0;
+  snapshot->particleCapacity = 0;
+}
+
+//#==============================================================================
+//# * snapshotTake
+//#------------------------------------------------------------------------------
+//# Copies the current positions into either half of a snapshot
+//#==============================================================================
+static void snapshotTakeParticles(tagSnapshot* snapshot, const tagParticles* particles,
+                                  bool after)
+{
+  const int count = particles != NULL ? particles->count : 0;
+  snapshotReserveParticles(snapshot, count);
+  float* x = after ? snapshot->px1 : snapshot->px0;
+  float* y = after ? snapshot->py1 : snapshot->py0;
+  float* z = after ? snapshot->pz1 : snapshot->pz0;
+  for( int i = 0; i < count; i++) x[i] = (float)particles->x[i];
+  for( int i = 0; i < count; i++) y[i] = (float)particles->y[i];
+  for( int i = 0; i < count; i++) z[i] = (float)particles->z[i];
+  if(after) snapshot->particleCount = count;
+}
+
+static void snapshotTake(tagSnapshot* snapshot, const tagBodies* bodies, bool after)
+{
+  PROFILE_ZONE("snapshot");
+  unsigned long size = sizeof(double) * (unsigned long)bodies->count;
+  snapshotReserve(snapshot, bodies->count);
+  memcpy(after ? snapshot->x1 : snapshot->x0, bodies->x, size);
+  memcpy(after ? snapshot->y1 : snapshot->y0, bodies->y, size);
+  memcpy(after ? snapshot->z1 : snapshot->z0, bodies->z, size);
+  if(after)
+  {
+    memcpy(snapshot->radius, bodies->radius, size);
+    snapshot->count = bodies->count;
+  }
+}
+
+//#==============================================================================
+//# * physicsThread
+//#------------------------------------------------------------------------------
+//# Accumulates the simulated time owed as real time passes and pays it off in
+//# steps of exactly dt, publishing after each batch
+//#==============================================================================
+static void physicsThread(tagSimulation* simulation)
+{
+  tagBodies* bodies = simulation->bodies;
+  const double dt   = simulation->dt;
+  double owed = 0;                       // simulated seconds not yet stepped
+  double last = clockSeconds();
+  profilerNameThread("physics");
+
+  while(simulation->running.load(std::memory_order_relaxed))
+  {
+    double now  = clockSeconds();
+    double rate = simulation->baseRate * simulation->speed.load(std::memory_order_relaxed);
+    owed += (now - last) * rate;
+    last  = now;
+    if(owed > SIMULATION_LAG * rate) owed = SIMULATION_LAG * rate;  // can't keep up
+
+    if(owed < dt)
+    {
+      // nothing due yet: sleep until the next step is (or a little before)
+      double wait = (dt - owed) / rate;
+      if(wait > 0.002) wait = 0.002;
+      std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+      continue;
+    }
+
+    tagSnapshot* snapshot = &simulation->snapshots[simulation->buffer.write];
+    double started = now;
+    do
+    {
+      snapshotTake(snapshot, bodies, false);
+      snapshotTakeParticles(snapshot, simulation->particles, false);
+      snapshot->time0 = simulation->time;
+      int before = bodies->count;
+      if(!physicsStep(bodies, dt))
+      {
+        simulation->running.store(false);   // the bodies stay as the integrator left them
+        break;
+      }
+      if(bodies->count != before)
+        snapshotTake(snapshot, bodies, false);   // merged: the old positions don't line up
+      simulation->time += dt;
+      simulation->steps++;
+      if(simulation->checkpointEvery > 0 &&
+         simulation->steps % simulation->checkpointEvery == 0)
+      {
+        simulation->checkpoint.time  = simulation->time;
+        simulation->checkpoint.steps = simulation->steps;
+        checkpointSave(&simulation->checkpoint, bodies);   // written in the background
+      }
+      owed -= dt;
+      now = clockSeconds();
+    } while(owed >= dt && now - started < SIMULATION_BATCH);
+
+    snapshotTake(snapshot, bodies, true);
+    snapshotTakeParticles(snapshot, simulation->particles, true);
+    snapshot->time1 = simulation->time;
+    snapshot->ahead = owed;
+    snapshot->wall  = now;
+    snapshot->rate  = rate;
+    snapshot->steps = simulation->steps;
+    tripleBufferPublish(&simulation->buffer);
+  }
+}
+
+//#==============================================================================
+//# * simulationStart
+//#------------------------------------------------------------------------------
+//# Publishes the initial state and starts the physics thread. "bodies" (and
+//# "particles", which physicsStep must already be carrying) belong to the
+//# physics thread until simulationStop. "time" and "steps" are where the
+//# bodies are up to: zero, unless they come from a checkpoint.
+//#==============================================================================
+void simulationStart(tagSimulation* simulation, tagBodies* bodies,
+                     tagParticles* particles, double time, long steps,
+                     double dt, double baseRate, double speed)
+{
+  simulation->bodies    = bodies;
+  simulation->particles = particles;
+  simulation->dt       = dt;
+  simulation->baseRate = baseRate;
+  simulation->time     = time;
+  simulation->steps    = steps;
+  simulation->speed.store(speed);
+  tripleBufferInit(&simulation->buffer);
+  for( int s = 0; s < 3; s++)
+  {
+    memset(&simulation->snapshots[s], 0, sizeof(tagSnapshot));
+    snapshotReserve(&simulation->snapshots[s], bodies->capacity);
+  }
+
+  // something to draw before the first step: the initial state, held still
+  tagSnapshot* first = &simulation->snapshots[simulation->buffer.write];
+  snapshotTake(first, bodies, false);
+  snapshotTake(first, bodies, true);
+  snapshotTakeParticles(first, particles, false);
+  snapshotTakeParticles(first, particles, true);
+  first->time0 = first->time1 = time;
+  first->ahead = 0;
+  first->wall  = clockSeconds();
+  first->rate  = 0;
+  first->steps = steps;
+  tripleBufferPublish(&simulation->buffer);
+
+  simulation->running.store(true);
+  simulation->thread = std::thread(physicsThread, simulation);
+}
+
+//#==============================================================================
+//# * simulationStop
+//#------------------------------------------------------------------------------
+//# Stops and joins the physics thread. "bodies" belongs to the caller again.
+//#==============================================================================
+void simulationStop(tagSimulation* simulation)
+{
+  if(!simulation->thread.joinable()) return;
+  simulation->running.store(false);
+  simulation->thread.join();
+  for( int s = 0; s < 3; s++) snapshotFree(&simulation->snapshots[s]);
+}
+
+//#==============================================================================
+//# * simulationSetSpeed
+//#------------------------------------------------------------------------------
+//# Changes how many steps are taken per real second (the step size is fixed)
+//#==============================================================================
+void simulationSetSpeed(tagSimulation* simulation, double speed)
+{
+  simulation->speed.store(speed, std::memory_order_relaxed);
+}
+
+//#==============================================================================
+//# * simulationCheckpoint
+//#------------------------------------------------------------------------------
+//# Has the physics thread save a checkpoint (see checkpointStart) every
+//# "every" steps, 0 for never. Call before simulationStart.
+//#==============================================================================
+void simulationCheckpoint(tagSimulation* simulation,
+                          const tagCheckpointState* settings, long every)
+{
+  simulation->checkpoint      = *settings;
+  simulation->checkpointEvery = every;
+}
+
+//#==============================================================================
+//# * simulationAcquire
+//#------------------------------------------------------------------------------
+//# Display side: the newest published snapshot. It stays valid (and
+//# unchanged) until the next call.
+//#==============================================================================
+const tagSnapshot* simulationAcquire(tagSimulation* simulation)
+{
+  tripleBufferAcquire(&simulation->buffer);
+  return &simulation->snapshots[simulation->buffer.read];
+}
+
+//#==============================================================================
+//# * snapshotAlpha
+//#------------------------------------------------------------------------------
+//# How far between the two states of a snapshot to draw at real time "now".
+//# The display runs one step behind the physics so that there is (almost)
+//# always a later state to interpolate towards. Also returns the simulated
+//# time being drawn.
+//#==============================================================================
+double snapshotAlpha(const tagSnapshot* snapshot, double now, double* renderTime)
+{
+  double span = snapshot->time1 - snapshot->time0;
+  if(span <= 0)
+  {
+    *renderTime = snapshot->time1;
+    return 1;
+  }
+  double target = snapshot->time1 + snapshot->ahead
+                + (now - snapshot->wall) * snapshot->rate - span;
+  double alpha  = (target - snapshot->time0) / span;
+  if(alpha < 0) alpha = 0;
+  if(alpha > 1) alpha = 1;
+  *renderTime = snapshot->time0 + alpha * span;
+  return alpha;
+}
@@ -0,0 +1,89 @@
+/*
+#================================================================================
+# * Simulation              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Runs the physics on its own thread for the window. The thread advances the
+# bodies in fixed steps of "dt" as real time passes (more steps per second
+# when the simulation is sped up, never bigger steps) and publishes each batch
+# through a triple buffer. The display only ever reads the latest published
+# snapshot and interpolates between the two states it holds, so drawing and
+# stepping run at whatever rate each can manage.
+#================================================================================
+*/
+#ifndef SOLAR_SIMULATION_H
+#define SOLAR_SIMULATION_H
+
+#include "bodies.h"
+#include "particles.h"
+#include "triple_buffer.h"
+#include "checkpoint.h"
+#include <atomic>         // Header File for std::atomic
+#include <thread>         // Header File for std::thread
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagSnapshot - the last two states of a batch of steps
+typedef struct
+{
+  double* x0;         // positions at time0 (before the last step)
+  double* y0;
+  double* z0;
+  double* x1;         // positions at time1 (after the last step)
+  double* y1;
+  double* z1;
+  double* radius;     // physical radius of each body (m)
+  int     count;      // number of bodies
+  int     capacity;   // number of bodies the arrays can hold
+  float*  px0;        // test particle positions at time0 (drawing only, so
+  float*  py0;        // single precision is plenty)
+  float*  pz0;
+  float*  px1;        // test particle positions at time1
+  float*  py1;
+  float*  pz1;
+  int     particleCount;
+  int     particleCapacity;
+  double  time0;      // simulated time (s) of the first state
+  double  time1;      // simulated time (s) of the second state
+  double  ahead;      // simulated time owed but not yet stepped when published
+  double  wall;       // clockSeconds() when published
+  double  rate;       // simulated seconds per real second when published
+  long    steps;      // steps taken since the start
+}tagSnapshot;
+
+// tagSimulation
+typedef struct
+{
+  tagBodies*          bodies;       // only touched by the physics thread
+  tagParticles*       particles;    // likewise (may be NULL)
+  double              dt;           // fixed step (s)
+  double              baseRate;     // simulated seconds per real second at 1x
+  double              time;         // simulated time (s) of "bodies"
+  long                steps;        // steps taken since the start
+  std::atomic<double> speed;        // multiplier of baseRate
+  std::atomic<bool>   running;
+  std::thread         thread;
+  tagTripleBuffer     buffer;
+  tagSnapshot         snapshots[3];
+  tagCheckpointState  checkpoint;   // settings saved with each checkpoint
+  long                checkpointEvery; // steps between checkpoints (0 for none)
+}tagSimulation;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void simulationStart      ( tagSimulation* simulation, tagBodies* bodies,
+                            tagParticles* particles, double time, long steps,
+                            double dt, double baseRate, double speed );
+void simulationStop       ( tagSimulation* simulation );
+void simulationSetSpeed   ( tagSimulation* simulation, double speed );
+void simulationCheckpoint ( tagSimulation* simulation,
+                            const tagCheckpointState* settings, long every );
+
+const tagSnapshot* simulationAcquire ( tagSimulation* simulation );
+double snapshotAlpha ( const tagSnapshot* snapshot, double now,
+                       double* renderTime );
+
+#endif // SOLAR_SIMULATION_H
@@ -0,0 +1,129 @@
+/*
+#================================================================================
+# * Solar System            Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Seed values for the sun and the nine planets (January 2011)
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "solar_system.h"
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# * solarSystemInit
+//#------------------------------------------------------------------------------
+//# Replaces the contents of "bodies" with the sun and the nine planets. The
+//# index of each body matches the planet enumeration.
+//#==============================================================================
+void solarSystemInit(tagBodies* bodies)
+{
+  bodies->count = 0;
+  bodiesReserve(bodies, SOLAR_SYSTEM_BODIES);
+
+  //                mass       radius     x             y             z
+  //                                      dx            dy            dz
+  // Sun
+  bodiesAdd(bodies, 1.99E+30,  695500000, 0,            0,            0,
+                                          0,            0,            0);
+  // Mercury
+  bodiesAdd(bodies, 3.34E+23,  2439700,  -20665696392, -59636889090, -29712844059,
+                                          3.66E+04,    -9.51E+03,    -8.88E+03);
+  // Venus
+  bodiesAdd(bodies, 4.87E+24,  6051800,  -1.07478E+11, -6401037913,   3920831085,
+                                          8.82E+02,    -3.19E+04,    -1.45E+04);
+  // Earth
+  bodiesAdd(bodies, 5.98E+24,  6378100,  -26516914541,  1.32754E+11,  57555479554,
+                                         -2.98E+04,    -4.78E+03,    -2.06E+03);
+  // Mars
+  bodiesAdd(bodies, 6.40e23,   3397000,   2.08092E+11,  1150108018,  -5098849339,
+                                          1.30E+03,     2.39E+04,     1.09E+04);
+  // Jupiter
+  bodiesAdd(bodies, 1.90E+27,  71492000,  5.94749E+11,  4.1426E+11,   1.63068E+11,
+                                         -7.89E+03,     1.02E+04,     4.54E+03);
+  // Saturn
+  bodiesAdd(bodies, 5.69E+26,  60268000,  9.48999E+11,  9.31359E+11,  3.4387E+11,
+                                         -7.44E+03,     6.12E+03,     2.85E+03);
+  // Uranus
+  bodiesAdd(bodies, 8.67E+25,  25559000,  2.17596E+12, -1.85516E+12, -8.43327E+11,
+                                          4.66E+03,     4.29E+03,     1.81E+03);
+  // Neptune
+  bodiesAdd(bodies, 1.03E+26,  24764000,  2.5472E+12,  -3.41681E+12, -1.46188E+12,
+                                          4.50E+03,     2.91E+03,     1.08E+03);
+  // Pluto
+  bodiesAdd(bodies, 6.58e23,   1180000,  -1.42071E+12, -4.20637E+12, -8.84208E+11,
+                                          5.28E+03,    -1.96E+03,    -2.19E+03);
+}
+
+//#==============================================================================
+//# * nextRandom
+//#------------------------------------------------------------------------------
+//# Small linear congruential generator so that belts are the same on every
+//# platform for the same seed. Returns a value in [0, 1).
+//#==============================================================================
+static double nextRandom(unsigned long long* state)
+{
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (double)(*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//#==============================================================================
+//# * beltOrbit
+//#------------------------------------------------------------------------------
+//# A random, roughly circular orbit about the sun between 2.2 and 3.2 AU (the
+//# main asteroid belt): position p and velocity v
+//#==============================================================================
+static void beltOrbit(unsigned long long* state, double p[3], double v[3])
+{
+  const double au     = 1.495978707E+11;   // astronomical unit (m)
+  const double sun_gm = 6.67E-11 * 1.99E+30;
+  const double two_pi = 6.283185307179586;
+
+  double distance = au * (2.2 + 1.0 * nextRandom(state));
+  double angle    = two_pi * nextRandom(state);
+  double tilt     = 0.1 * (nextRandom(state) - 0.5);   // a few degrees
+  double speed    = sqrt(sun_gm / distance);           // circular orbit
+  p[0] = distance * cos(angle);  p[1] = distance * sin(angle);  p[2] = distance * sin(tilt);
+  v[0] = -speed * sin(angle);    v[1] = speed * cos(angle);     v[2] = 0;
+}
+
+//#==============================================================================
+//# * solarSystemAddBelt
+//#------------------------------------------------------------------------------
+//# Appends "count" small bodies in the main asteroid belt. Used to exercise
+//# the simulation with far more than ten bodies.
+//#==============================================================================
+void solarSystemAddBelt(tagBodies* bodies, int count, unsigned long seed)
+{
+  unsigned long long state = seed;
+
+  bodiesReserve(bodies, bodies->count + count);
+  for( int i = 0; i < count; i++)
+  {
+    double p[3], v[3];
+    beltOrbit(&state, p, v);
+    double mass   = 1E+15 * (1.0 + 99.0 * nextRandom(&state));
+    double radius = 1000 * (1.0 + 9.0 * nextRandom(&state));
+
+    bodiesAdd(bodies, mass, radius, p[0], p[1], p[2], v[0], v[1], v[2]);
+  }
+}
+
+//#==============================================================================
+//# * solarSystemAddParticles
+//#------------------------------------------------------------------------------
+//# Appends "count" massless test particles in the main asteroid belt
+//#==============================================================================
+void solarSystemAddParticles(tagParticles* particles, int count, unsigned long seed)
+{
+  unsigned long long state = seed;
+
+  particlesReserve(particles, particles->count + count);
+  for( int i = 0; i < count; i++)
+  {
+    double p[3], v[3];
+    beltOrbit(&state, p, v);
+    particlesAdd(particles, p[0], p[1], p[2], v[0], v[1], v[2]);
+  }
+}
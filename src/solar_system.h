@@ -0,0 +1,35 @@
+/*
+#================================================================================
+# * Solar System            Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Seed values for the sun and the nine planets (January 2011), plus an
+# optional synthetic asteroid belt
+#================================================================================
+*/
+#ifndef SOLAR_SOLAR_SYSTEM_H
+#define SOLAR_SOLAR_SYSTEM_H
+
+#include "bodies.h"
+#include "particles.h"
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of planets
+enum
+{
+  SUN = 0,  MERCURY,  VENUS,  EARTH,   MARS,
+  JUPITER,  SATURN,  URANUS, NEPTUNE, PLUTO,
+  SOLAR_SYSTEM_BODIES
+};
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void solarSystemInit         ( tagBodies* bodies );
+void solarSystemAddBelt      ( tagBodies* bodies, int count, unsigned long seed );
+void solarSystemAddParticles ( tagParticles* particles, int count, unsigned long seed );
+
+#endif // SOLAR_SOLAR_SYSTEM_H
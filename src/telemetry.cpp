@@ -0,0 +1,202 @@
+/*
+#================================================================================
+# * Telemetry               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Lock-free statistics ring and the thread that writes it out
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "telemetry.h"
+#include <stdio.h>              // Header File for the standard library
+#include <stdlib.h>             // Header File for atexit
+#include <string.h>             // Header File for strcmp
+#include <atomic>               // Header File for std::atomic
+#include <chrono>               // Header File for std::chrono
+#include <condition_variable>   // Header File for std::condition_variable
+#include <mutex>                // Header File for std::mutex
+#include <thread>               // Header File for std::thread
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static tagTelemetrySample ring[TELEMETRY_RING];
+static std::atomic<unsigned long> head(0);     // next slot the display fills
+static std::atomic<unsigned long> tail(0);     // next slot the writer empties
+static std::atomic<long>          dropped(0);  // samples lost to a full ring
+
+static int                     activeSink = TELEMETRY_NONE;
+static FILE*                   output     = NULL;
+static double                  interval   = 0.25;   // seconds between drains
+static std::thread             writer;
+static std::mutex              writerMutex;          // only for sleeping on
+static std::condition_variable writerWake;
+static bool                    stopping   = false;
+
+//#==============================================================================
+//# * writeSample
+//#------------------------------------------------------------------------------
+//# Formats one sample for the sink
+//#==============================================================================
+static void writeSample(const tagTelemetrySample* sample)
+{
+  if(activeSink == TELEMETRY_FILE)
+  {
+    fprintf(output, "%.6f,%.3f,%.2f,%.2f,%.6f,%ld,%d,%d\n",
+            sample->wall, sample->simTime, sample->speed, sample->zoom,
+            sample->frame, sample->steps, sample->camera, sample->bodies);
+    return;
+  }
+  double days  = sample->simTime/(60*60*24);
+  double years = days/365.25;
+  fprintf(output, "%s%1.1f%s","Speed Multiplier: \t", sample->speed, "x\n");
+  fprintf(output, "%s%6.3f\n","Time Elapsed (s): \t", sample->simTime);
+  fprintf(output, "%s%6.3f\n","Time Elapsed (d): \t", days);
+  fprintf(output, "%s%3.3f\n","Time Elapsed (y): \t", years);
+  fprintf(output, "%s%i \n",  "Active Camera   : \t", sample->camera);
+  fprintf(output, "%s%1.1f\n","Scale Factor    : \t", sample->zoom);
+}
+
+//#==============================================================================
+//# * drain
+//#------------------------------------------------------------------------------
+//# Empties the ring. A file gets every sample; stdout only the newest, since
+//# a terminal scrolling past at frame rate is of no use to anyone.
+//#==============================================================================
+static void drain()
+{
+  unsigned long first = tail.load(std::memory_order_relaxed);
+  unsigned long last  = head.load(std::memory_order_acquire);
+  if(first == last) return;
+
+  if(activeSink == TELEMETRY_FILE)
+  {
+    for( unsigned long i = first; i < last; i++)
+    {
+      writeSample(&ring[i & (TELEMETRY_RING - 1)]);
+    }
+  }
+  else
+  {
+    writeSample(&ring[(last - 1) & (TELEMETRY_RING - 1)]);
+  }
+  tail.store(last, std::memory_order_release);
+  fflush(output);
+}
+
+//#==============================================================================
+//# * writerMain
+//#------------------------------------------------------------------------------
+//# Background thread: drains the ring every interval until told to stop,
+//# then once more so nothing pushed before telemetryStop is lost
+//#==============================================================================
+static void writerMain()
+{
+  std::unique_lock<std::mutex> lock(writerMutex);
+  while(!stopping)
+  {
+    writerWake.wait_for(lock, std::chrono::duration<double>(interval));
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+  lock.unlock();
+  drain();
+}
+
+//#==============================================================================
+//# * telemetryStart
+//#------------------------------------------------------------------------------
+//# Starts writing samples to the sink "rate" times a second. "path" is only
+//# used by TELEMETRY_FILE. Returns false if the file can't be opened.
+//#==============================================================================
+bool telemetryStart(int sink, const char* path, double rate)
+{
+  static bool registered = false;
+  telemetryStop();
+
+  if(sink == TELEMETRY_NONE) return true;
+  if(sink == TELEMETRY_FILE)
+  {
+    output = fopen(path, "w");
+    if(output == NULL) return false;
+    fprintf(output, "wall,time,speed,zoom,frame,steps,camera,bodies\n");
+  }
+  else
+  {
+    output = stdout;
+  }
+  activeSink = sink;
+  interval   = rate > 0 ? 1.0 / rate : 0.25;
+  stopping   = false;
+  head.store(0);
+  tail.store(0);
+  writer = std::thread(writerMain);
+
+  if(!registered)
+  {
+    atexit(telemetryStop);
+    registered = true;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * telemetryStop
+//#------------------------------------------------------------------------------
+//# Writes out what is left and stops the background thread
+//#==============================================================================
+void telemetryStop()
+{
+  if(writer.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(writerMutex);
+      stopping = true;
+    }
+    writerWake.notify_one();
+    writer.join();
+  }
+  if(output != NULL && output != stdout) fclose(output);
+  output     = NULL;
+  activeSink = TELEMETRY_NONE;
+}
+
+//#==============================================================================
+//# * telemetryPush
+//#------------------------------------------------------------------------------
+//# Display side: queues a sample without ever blocking. Returns false if it
+//# had to be dropped (no sink, or the writer has fallen a whole ring behind).
+//#==============================================================================
+bool telemetryPush(const tagTelemetrySample* sample)
+{
+  if(activeSink == TELEMETRY_NONE) return false;
+  unsigned long next = head.load(std::memory_order_relaxed);
+  if(next - tail.load(std::memory_order_acquire) >= TELEMETRY_RING)
+  {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  ring[next & (TELEMETRY_RING - 1)] = *sample;
+  head.store(next + 1, std::memory_order_release);
+  return true;
+}
+
+long telemetryDropped()
+{
+  return dropped.load(std::memory_order_relaxed);
+}
+
+//#==============================================================================
+//# * telemetryParseSink
+//#------------------------------------------------------------------------------
+//# "none" and "stdout" are sinks of their own; anything else is a file name
+//#==============================================================================
+int telemetryParseSink(const char* name)
+{
+  if(strcmp(name, "none")   == 0) return TELEMETRY_NONE;
+  if(strcmp(name, "stdout") == 0) return TELEMETRY_STDOUT;
+  return TELEMETRY_FILE;
+}
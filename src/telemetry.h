@@ -0,0 +1,57 @@
+/*
+#================================================================================
+# * Telemetry               Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Statistics from the display (speed, simulated time, camera, zoom) go into a
+# lock-free single producer / single consumer ring. A background thread
+# drains it a few times a second and does the actual writing, so the frame
+# that produced a sample never waits on a terminal or a disk. If the ring is
+# full the sample is dropped and counted rather than waited for.
+#================================================================================
+*/
+#ifndef SOLAR_TELEMETRY_H
+#define SOLAR_TELEMETRY_H
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define TELEMETRY_RING 1024   // samples the ring holds (a power of two)
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of places samples are written to
+enum
+{
+  TELEMETRY_NONE = 0,   // nowhere (the ring is not even filled)
+  TELEMETRY_STDOUT,     // the newest sample, in the old debug layout
+  TELEMETRY_FILE        // every sample, one comma separated line each
+};
+
+// tagTelemetrySample
+typedef struct
+{
+  double wall;      // clockSeconds() when taken
+  double simTime;   // simulated time being drawn (s)
+  double speed;     // speed multiplier
+  double zoom;      // camera zoom ("scale factor")
+  double frame;     // seconds the frame took
+  long   steps;     // physics steps taken
+  int    camera;    // body the camera is on
+  int    bodies;    // bodies being drawn
+}tagTelemetrySample;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool telemetryStart   ( int sink, const char* path, double rate );
+void telemetryStop    ( );
+bool telemetryPush    ( const tagTelemetrySample* sample );
+long telemetryDropped ( );
+
+int  telemetryParseSink ( const char* name );
+
+#endif // SOLAR_TELEMETRY_H
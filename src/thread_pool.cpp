@@ -0,0 +1,301 @@
+/*
+#================================================================================
+# * Thread Pool             Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Persistent work-stealing thread pool
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "thread_pool.h"
+#include "profiler.h"
+#include <stdio.h>              // Header File for snprintf
+#include <stdlib.h>             // Header File for atexit
+#include <atomic>               // Header File for std::atomic
+#include <condition_variable>   // Header File for std::condition_variable
+#include <mutex>                // Header File for std::mutex
+#include <thread>               // Header File for std::thread
+#include <vector>               // Header File for std::vector
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define POOL_SPIN 4000   // polls of the job counter before a worker sleeps
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagWorkerQueue - the chunks a worker still has to do, packed as
+// (first << 32 | end) so both ends can be moved with a single compare and
+// swap. The owner takes from the front, thieves take from the back. Each
+// queue has a cache line to itself.
+struct alignas(64) tagWorkerQueue
+{
+  std::atomic<unsigned long long> range;
+};
+
+//#==============================================================================
+//# Globals
+//#==============================================================================
+// statics:
+static std::vector<std::thread> workers;
+static tagWorkerQueue*          queues       = nullptr;
+static int                      poolSize     = 1;
+static std::mutex               poolMutex;
+static std::condition_variable  poolWake;
+static std::atomic<unsigned>    generation(0);  // bumped for every job
+static std::atomic<bool>        quitting(false);
+static std::atomic<int>         remaining(0);   // chunks not yet finished
+static std::atomic<int>         busy(0);        // workers still in the job
+static thread_local int         poolWorker = 0; // this thread's index in the pool
+
+// the current job
+static ThreadTask jobTask    = nullptr;
+static void*      jobContext = nullptr;
+static int        jobCount   = 0;
+static int        jobGrain   = 1;
+
+//#==============================================================================
+//# * packRange / rangeFirst / rangeEnd
+//#------------------------------------------------------------------------------
+//# Queue encoding helpers
+//#==============================================================================
+static inline unsigned long long packRange(unsigned first, unsigned end)
+{
+  return (unsigned long long)first << 32 | end;
+}
+static inline unsigned rangeFirst(unsigned long long range) { return (unsigned)(range >> 32); }
+static inline unsigned rangeEnd  (unsigned long long range) { return (unsigned)range; }
+
+//#==============================================================================
+//# * popChunk
+//#------------------------------------------------------------------------------
+//# Takes the next chunk from the front of a worker's own queue
+//#==============================================================================
+static bool popChunk(int worker, unsigned* chunk)
+{
+  std::atomic<unsigned long long>& range = queues[worker].range;
+  unsigned long long current = range.load(std::memory_order_acquire);
+  while(rangeFirst(current) < rangeEnd(current))
+  {
+    unsigned long long next = packRange(rangeFirst(current) + 1, rangeEnd(current));
+    if(range.compare_exchange_weak(current, next, std::memory_order_acq_rel))
+    {
+      *chunk = rangeFirst(current);
+      return true;
+    }
+  }
+  return false;
+}
+
+//#==============================================================================
+//# * stealChunks
+//#------------------------------------------------------------------------------
+//# Takes the back half of some other worker's queue. The first stolen chunk
+//# is returned and the rest become the thief's own queue.
+//#==============================================================================
+static bool stealChunks(int thief, unsigned* chunk)
+{
+  for( int offset = 1; offset < poolSize; offset++)
+  {
+    std::atomic<unsigned long long>& range = queues[(thief + offset) % poolSize].range;
+    unsigned long long current = range.load(std::memory_order_acquire);
+    while(rangeFirst(current) < rangeEnd(current))
+    {
+      unsigned first = rangeFirst(current), end = rangeEnd(current);
+      unsigned take  = (end - first + 1) / 2;
+      if(range.compare_exchange_weak(current, packRange(first, end - take),
+                                     std::memory_order_acq_rel))
+      {
+        *chunk = end - take;
+        queues[thief].range.store(packRange(end - take + 1, end), std::memory_order_release);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+//#==============================================================================
+//# * runChunks
+//#------------------------------------------------------------------------------
+//# Works through the worker's own chunks, then steals until nothing is left
+//#==============================================================================
+static void runChunks(int worker)
+{
+  unsigned chunk;
+  while(remaining.load(std::memory_order_acquire) > 0)
+  {
+    if(popChunk(worker, &chunk) || stealChunks(worker, &chunk))
+    {
+      int begin = (int)chunk * jobGrain;
+      int end   = begin + jobGrain < jobCount ? begin + jobGrain : jobCount;
+      jobTask(jobContext, begin, end);
+      remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    else
+    {
+      std::this_thread::yield();   // the last chunks are still running
+    }
+  }
+}
+
+//#==============================================================================
+//# * workerMain
+//#------------------------------------------------------------------------------
+//# Body of each pool thread: wait for a job, help with it, repeat
+//#==============================================================================
+static void workerMain(int worker, unsigned seen)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "worker %d", worker);
+  profilerNameThread(name);
+  poolWorker = worker;
+
+  for(;;)
+  {
+    // spin briefly first: jobs often come back to back within a step
+    unsigned current = generation.load(std::memory_order_acquire);
+    for( int spin = 0; current == seen && spin < POOL_SPIN; spin++)
+    {
+      std::this_thread::yield();
+      current = generation.load(std::memory_order_acquire);
+    }
+    if(current == seen)
+    {
+      std::unique_lock<std::mutex> lock(poolMutex);
+      poolWake.wait(lock, [&]{ return quitting.load() ||
+                                      generation.load() != seen; });
+      current = generation.load(std::memory_order_acquire);
+    }
+    if(quitting.load()) return;
+    seen = current;
+
+    {
+      PROFILE_ZONE("pool work");
+      runChunks(worker);
+    }
+    busy.fetch_sub(1, std::memory_order_acq_rel);
+  }
+}
+
+//#==============================================================================
+//# * threadPoolStart
+//#------------------------------------------------------------------------------
+//# Starts the pool with "threads" threads in total (including the caller).
+//# Zero or less means one per hardware thread. The pool is stopped at exit,
+//# since GLUT programs usually leave through exit().
+//#==============================================================================
+void threadPoolStart(int threads)
+{
+  static bool registered = false;
+  if(!registered)
+  {
+    atexit(threadPoolStop);
+    registered = true;
+  }
+  threadPoolStop();
+  if(threads <= 0) threads = threadPoolHardwareThreads();
+
+  poolSize = threads;
+  queues   = new tagWorkerQueue[threads];
+  for( int w = 0; w < threads; w++) queues[w].range.store(0);
+  quitting.store(false);
+  for( int w = 1; w < threads; w++)
+  {
+    workers.push_back(std::thread(workerMain, w, generation.load()));
+  }
+}
+
+//#==============================================================================
+//# * threadPoolStop
+//#------------------------------------------------------------------------------
+//# Joins every worker thread
+//#==============================================================================
+void threadPoolStop()
+{
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    quitting.store(true);
+  }
+  poolWake.notify_all();
+  for( size_t w = 0; w < workers.size(); w++) workers[w].join();
+  workers.clear();
+  delete[] queues;
+  queues   = nullptr;
+  poolSize = 1;
+}
+
+//#==============================================================================
+//# * threadPoolSize / threadPoolHardwareThreads
+//#------------------------------------------------------------------------------
+//# Number of threads that run a parallel loop / the machine has
+//#==============================================================================
+int threadPoolSize()
+{
+  return poolSize;
+}
+
+int threadPoolHardwareThreads()
+{
+  unsigned threads = std::thread::hardware_concurrency();
+  return threads > 0 ? (int)threads : 1;
+}
+
+//#==============================================================================
+//# * threadPoolWorker
+//#------------------------------------------------------------------------------
+//# Index of the calling thread in the pool, from 0 to threadPoolSize() - 1.
+//# Any thread outside the pool counts as worker 0, like the caller of
+//# threadPoolFor, so a task can use it to pick per-thread scratch.
+//#==============================================================================
+int threadPoolWorker()
+{
+  return poolWorker;
+}
+
+//#==============================================================================
+//# * threadPoolFor
+//#------------------------------------------------------------------------------
+//# Runs task over [0, count) in chunks of "grain" items and returns once every
+//# chunk is done. Small loops (or a pool of one) just run on the caller.
+//#==============================================================================
+void threadPoolFor(int count, int grain, ThreadTask task, void* context)
+{
+  if(count <= 0) return;
+  if(grain < 1) grain = 1;
+  int chunks = (count + grain - 1) / grain;
+  if(chunks == 1 || poolSize == 1 || queues == nullptr)
+  {
+    task(context, 0, count);
+    return;
+  }
+
+  jobTask    = task;
+  jobContext = context;
+  jobCount   = count;
+  jobGrain   = grain;
+  for( int w = 0; w < poolSize; w++)
+  {
+    unsigned first = (unsigned)((long long)chunks * w / poolSize);
+    unsigned end   = (unsigned)((long long)chunks * (w + 1) / poolSize);
+    queues[w].range.store(packRange(first, end), std::memory_order_relaxed);
+  }
+  remaining.store(chunks, std::memory_order_relaxed);
+  busy.store(poolSize - 1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  poolWake.notify_all();
+
+  runChunks(0);
+  // every worker has to be out of the job before its queues can be reused
+  while(busy.load(std::memory_order_acquire) > 0)
+  {
+    std::this_thread::yield();
+  }
+}
@@ -0,0 +1,36 @@
+/*
+#================================================================================
+# * Thread Pool             Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Persistent worker threads for the physics. Work is handed out as chunks of
+# an index range; every thread starts with an even share of the chunks and,
+# once its own run out, steals half of what another thread has left. The
+# calling thread takes part as worker 0.
+#
+# The pool itself makes no promises about which thread runs which chunk, so
+# callers that want the same answer for any thread count must make sure that
+# chunks write to separate memory (see gravityAccelerations).
+#================================================================================
+*/
+#ifndef SOLAR_THREAD_POOL_H
+#define SOLAR_THREAD_POOL_H
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+// Runs items [begin, end) of a parallel loop
+typedef void (*ThreadTask)( void* context, int begin, int end );
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void threadPoolStart ( int threads );
+void threadPoolStop  ( );
+int  threadPoolSize  ( );
+int  threadPoolWorker ( );
+int  threadPoolHardwareThreads ( );
+void threadPoolFor   ( int count, int grain, ThreadTask task, void* context );
+
+#endif // SOLAR_THREAD_POOL_H
@@ -0,0 +1,509 @@
+/*
+#================================================================================
+# * Trajectory              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Chunked, quantized recordings of the bodies, written with stdio and read
+# back through a memory map
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "trajectory.h"
+#include <stdlib.h>       // Header File for realloc/free
+#include <string.h>       // Header File for memcpy/memset
+#include <math.h>         // Header File for the math library
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define TRAJECTORY_CHUNK_MAGIC 0x4B4E4843u   // "CHNK" read as little endian
+
+//#==============================================================================
+//# * floatToHalf / halfToFloat
+//#------------------------------------------------------------------------------
+//# IEEE 754 binary16 conversion, rounding to nearest even. Done by hand as
+//# F16C isn't available everywhere and this only runs once per value.
+//#==============================================================================
+static uint16_t floatToHalf(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign     = (bits >> 16) & 0x8000u;
+  int      exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFFu;
+
+  if(((bits >> 23) & 0xFF) == 0xFF)             // inf and nan
+    return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0));
+  if(exponent >= 31)                            // too big: inf
+    return (uint16_t)(sign | 0x7C00u);
+  if(exponent <= 0)                             // subnormal or zero
+  {
+    if(exponent < -10) return (uint16_t)sign;
+    mantissa |= 0x800000u;
+    int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t mid  = 1u << (shift - 1);
+    if(rest > mid || (rest == mid && (half & 1))) half++;
+    return (uint16_t)(sign | half);
+  }
+  uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1FFFu;
+  if(rest > 0x1000u || (rest == 0x1000u && (half & 1))) half++;  // may carry into inf
+  return (uint16_t)half;
+}
+
+static float halfToFloat(uint16_t half)
+{
+  uint32_t sign     = (uint32_t)(half & 0x8000u) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FFu;
+  uint32_t bits;
+
+  if(exponent == 0x1F)
+    bits = sign | 0x7F800000u | (mantissa << 13);
+  else if(exponent != 0)
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  else if(mantissa == 0)
+    bits = sign;
+  else                                          // subnormal: normalise it
+  {
+    exponent = 127 - 15 + 1;
+    while((mantissa & 0x400u) == 0)
+    {
+      mantissa <<= 1;
+      exponent--;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+//#==============================================================================
+//# * valueBytes / chunkBytes
+//#------------------------------------------------------------------------------
+//# Size of one stored value and of a whole chunk of "frames" frames, padded so
+//# the next chunk's doubles stay 8 byte aligned in the map
+//#==============================================================================
+static uint64_t valueBytes(uint32_t format)
+{
+  return format == TRAJECTORY_F16 ? 2 : 4;
+}
+
+static uint64_t chunkBytes(uint32_t format, uint64_t bodies, uint64_t frames)
+{
+  uint64_t values = TRAJECTORY_VALUES * bodies;
+  uint64_t bytes  = sizeof(tagTrajectoryChunk) + values * (sizeof(double) + sizeof(float))
+                  + frames * values * valueBytes(format);
+  return (bytes + 7) & ~(uint64_t)7;
+}
+
+//#==============================================================================
+//# * writeFrame
+//#------------------------------------------------------------------------------
+//# Copies the bodies into the next free frame of the chunk being built
+//#==============================================================================
+static void writeFrame(tagTrajectoryWriter* writer, const tagBodies* bodies)
+{
+  const int count = writer->count;
+  double* frame = writer->frames + (unsigned long)writer->buffered * TRAJECTORY_VALUES * count;
+  const double* values[TRAJECTORY_VALUES] = { bodies->x,  bodies->y,  bodies->z,
+                                              bodies->vx, bodies->vy, bodies->vz };
+  for( int v = 0; v < TRAJECTORY_VALUES; v++)
+  {
+    double* out = frame + (unsigned long)v * count;
+    if(writer->slots == NULL)
+      memcpy(out, values[v], sizeof(double) * count);
+    else
+      for( int s = 0; s < count; s++) out[s] = values[v][writer->slots[s]];
+  }
+  writer->buffered++;
+}
+
+//#==============================================================================
+//# * flushChunk
+//#------------------------------------------------------------------------------
+//# Quantizes the buffered frames against their own range and appends them to
+//# the file as one chunk
+//#==============================================================================
+static bool flushChunk(tagTrajectoryWriter* writer)
+{
+  if(writer->buffered == 0) return true;
+
+  const uint32_t format = writer->header.format;
+  const int      count  = writer->count;
+  const int      frames = writer->buffered;
+  const unsigned long values = (unsigned long)TRAJECTORY_VALUES * count;
+  uint64_t bytes = chunkBytes(format, count, frames);
+
+  unsigned char* chunk = writer->chunk;
+  memset(chunk, 0, bytes);
+  tagTrajectoryChunk head;
+  head.magic      = TRAJECTORY_CHUNK_MAGIC;
+  head.frames     = (uint32_t)frames;
+  head.firstFrame = writer->header.frameCount;
+  head.bytes      = bytes;
+  memcpy(chunk, &head, sizeof(head));
+
+  double*  base  = (double*)(chunk + sizeof(tagTrajectoryChunk));
+  float*   scale = (float*)(base + values);
+  float*   q32   = (float*)(scale + values);
+  uint16_t* q16  = (uint16_t*)(scale + values);
+
+  for( unsigned long k = 0; k < values; k++)
+  {
+    double lo = writer->frames[k], hi = lo;
+    for( int f = 1; f < frames; f++)
+    {
+      double value = writer->frames[f * values + k];
+      if(value < lo) lo = value;
+      if(value > hi) hi = value;
+    }
+    double range = (hi - lo) * 0.5;
+    base[k]  = lo + range;
+    scale[k] = range > 0 ? (float)range : 1.0f;
+
+    double inverse = 1.0 / scale[k];
+    for( int f = 0; f < frames; f++)
+    {
+      float q = (float)((writer->frames[f * values + k] - base[k]) * inverse);
+      if(format == TRAJECTORY_F16)
+        q16[f * values + k] = floatToHalf(q);
+      else
+        q32[f * values + k] = q;
+    }
+  }
+
+  if(fwrite(chunk, 1, bytes, writer->file) != bytes) return false;
+
+  if(writer->header.chunkCount == writer->indexCapacity)
+  {
+    writer->indexCapacity = writer->indexCapacity ? writer->indexCapacity * 2 : 64;
+    writer->index = (uint64_t*)growMemory(writer->index,
+                                          sizeof(uint64_t) * writer->indexCapacity);
+  }
+  writer->index[writer->header.chunkCount++] = writer->offset;
+  writer->offset += bytes;
+  writer->header.frameCount += frames;
+  writer->buffered = 0;
+  return true;
+}
+
+//#==============================================================================
+//# * trajectoryCreate
+//#------------------------------------------------------------------------------
+//# Starts a recording of "bodies" at "path", keeping one frame every
+//# "decimation" steps of dt seconds. The current state is the first frame.
+//#==============================================================================
+bool trajectoryCreate(tagTrajectoryWriter* writer, const char* path,
+                      int format, int decimation, double dt,
+                      double startTime, const tagBodies* bodies)
+{
+  memset(writer, 0, sizeof(*writer));
+  writer->file = fopen(path, "wb");
+  if(writer->file == NULL) return false;
+
+  tagTrajectoryHeader* header = &writer->header;
+  memcpy(header->magic, TRAJECTORY_MAGIC, sizeof(header->magic));
+  header->version        = TRAJECTORY_VERSION;
+  header->format         = format == TRAJECTORY_F16 ? TRAJECTORY_F16 : TRAJECTORY_F32;
+  header->bodies         = (uint32_t)bodies->count;
+  header->framesPerChunk = TRAJECTORY_CHUNK;
+  header->decimation     = decimation > 0 ? (uint32_t)decimation : 1;
+  header->interval       = dt * header->decimation;
+  header->startTime      = startTime;
+  writer->count = bodies->count;
+
+  // the header is written again with the totals once the file is closed
+  bool written = fwrite(header, sizeof(*header), 1, writer->file) == 1
+              && fwrite(bodies->radius, sizeof(double), bodies->count, writer->file)
+                 == (size_t)bodies->count;
+  writer->offset = sizeof(*header) + sizeof(double) * (uint64_t)bodies->count;
+
+  unsigned long values = (unsigned long)TRAJECTORY_VALUES * writer->count;
+  writer->frames = (double*)alignedAlloc(sizeof(double) * values * TRAJECTORY_CHUNK);
+  writer->chunk  = (unsigned char*)alignedAlloc(
+                     (unsigned long)chunkBytes(header->format, writer->count, TRAJECTORY_CHUNK));
+  if(!written)
+  {
+    trajectoryClose(writer);
+    return false;
+  }
+  writeFrame(writer, bodies);
+  return true;
+}
+
+//#==============================================================================
+//# * trajectoryRecord
+//#------------------------------------------------------------------------------
+//# Called after every physics step; keeps every decimation'th state
+//#==============================================================================
+void trajectoryRecord(tagTrajectoryWriter* writer, const tagBodies* bodies)
+{
+  if(writer->file == NULL) return;
+  if(writer->slots == NULL && bodies->count != writer->count) return;
+  if(++writer->steps < (long)writer->header.decimation) return;
+  writer->steps = 0;
+
+  writeFrame(writer, bodies);
+  if(writer->buffered == TRAJECTORY_CHUNK && !flushChunk(writer))
+  {
+    fprintf(stderr, "trajectory: write failed, recording stopped\n");
+    fclose(writer->file);
+    writer->file = NULL;
+  }
+}
+
+//#==============================================================================
+//# * trajectoryRemap
+//#------------------------------------------------------------------------------
+//# Called when bodies have merged and moved: remap[old index] is the new
+//# index of each body, or of the body that absorbed it
+//#==============================================================================
+void trajectoryRemap(tagTrajectoryWriter* writer, const int* remap)
+{
+  if(writer->file == NULL) return;
+  if(writer->slots == NULL)
+  {
+    writer->slots = (int*)growMemory(NULL, sizeof(int) * (unsigned long)writer->count);
+    for( int s = 0; s < writer->count; s++) writer->slots[s] = s;
+  }
+  for( int s = 0; s < writer->count; s++) writer->slots[s] = remap[writer->slots[s]];
+}
+
+//#==============================================================================
+//# * trajectoryClose
+//#------------------------------------------------------------------------------
+//# Writes out what's left, the chunk index and the final header. Returns
+//# false if any of it couldn't be written.
+//#==============================================================================
+bool trajectoryClose(tagTrajectoryWriter* writer)
+{
+  bool ok = writer->file != NULL;
+  if(ok)
+  {
+    ok = flushChunk(writer);
+    if(ok && writer->header.chunkCount > 0)
+    {
+      writer->header.indexOffset = writer->offset;
+      ok = fwrite(writer->index, sizeof(uint64_t), writer->header.chunkCount, writer->file)
+           == writer->header.chunkCount;
+    }
+    ok = ok && fseek(writer->file, 0, SEEK_SET) == 0
+            && fwrite(&writer->header, sizeof(writer->header), 1, writer->file) == 1;
+    ok = fclose(writer->file) == 0 && ok;
+    writer->file = NULL;
+  }
+  alignedFree(writer->frames);
+  alignedFree(writer->chunk);
+  free(writer->index);
+  free(writer->slots);
+  writer->frames = NULL;
+  writer->chunk  = NULL;
+  writer->index  = NULL;
+  writer->slots  = NULL;
+  return ok;
+}
+
+//#==============================================================================
+//# * chunkAt
+//#------------------------------------------------------------------------------
+//# The chunk header at "offset", or NULL if there isn't a whole, sane one
+//#==============================================================================
+static const tagTrajectoryChunk* chunkAt(const tagTrajectoryReader* reader, uint64_t offset)
+{
+  const tagTrajectoryHeader* header = reader->header;
+  if(offset % 8 != 0 || offset > reader->file.size ||
+     reader->file.size - offset < sizeof(tagTrajectoryChunk))
+    return NULL;
+  const tagTrajectoryChunk* chunk = (const tagTrajectoryChunk*)(reader->file.data + offset);
+  if(chunk->magic != TRAJECTORY_CHUNK_MAGIC || chunk->frames == 0 ||
+     chunk->frames > header->framesPerChunk ||
+     chunk->bytes != chunkBytes(header->format, header->bodies, chunk->frames) ||
+     chunk->bytes > reader->file.size - offset)
+    return NULL;
+  return chunk;
+}
+
+//#==============================================================================
+//# * trajectoryOpen
+//#------------------------------------------------------------------------------
+//# Maps a recording for replay. If it has no index (the recorder never got to
+//# close it) the chunks are walked once to build one, stopping at the first
+//# chunk that is cut short.
+//#==============================================================================
+bool trajectoryOpen(tagTrajectoryReader* reader, const char* path)
+{
+  memset(reader, 0, sizeof(*reader));
+  if(!mappedFileOpen(&reader->file, path))
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+
+  const tagTrajectoryHeader* header = (const tagTrajectoryHeader*)reader->file.data;
+  reader->header = header;
+  uint64_t size  = reader->file.size;
+  if(size < sizeof(*header) || memcmp(header->magic, TRAJECTORY_MAGIC, sizeof(header->magic)) != 0 ||
+     header->version != TRAJECTORY_VERSION || header->format > TRAJECTORY_F16 ||
+     header->bodies == 0 || header->framesPerChunk == 0 || !(header->interval > 0) ||
+     (size - sizeof(*header)) / sizeof(double) < header->bodies)
+  {
+    fprintf(stderr, "%s is not a trajectory this version can read\n", path);
+    trajectoryCloseReader(reader);
+    return false;
+  }
+  reader->radius = (const double*)(reader->file.data + sizeof(*header));
+
+  uint64_t indexOffset = header->indexOffset;
+  uint64_t chunks      = header->chunkCount;
+  if(indexOffset != 0 && indexOffset % 8 == 0 && indexOffset <= size &&
+     (size - indexOffset) / sizeof(uint64_t) >= chunks)
+  {
+    reader->index = (uint64_t*)growMemory(NULL, sizeof(uint64_t) * (chunks ? chunks : 1));
+    memcpy(reader->index, reader->file.data + indexOffset, sizeof(uint64_t) * chunks);
+    reader->chunkCount = (uint32_t)chunks;
+    reader->frameCount = 0;
+    for( uint32_t c = 0; c < reader->chunkCount; c++)
+    {
+      const tagTrajectoryChunk* chunk = chunkAt(reader, reader->index[c]);
+      if(chunk == NULL || chunk->firstFrame != (uint64_t)c * header->framesPerChunk)
+      {
+        free(reader->index);
+        reader->index = NULL;
+        break;
+      }
+      reader->frameCount += chunk->frames;
+    }
+    if(reader->index != NULL && reader->frameCount != header->frameCount)
+    {
+      free(reader->index);     // the header disagrees with its chunks: trust neither
+      reader->index = NULL;
+    }
+  }
+
+  if(reader->index == NULL)
+  {
+    uint32_t capacity = 0;
+    uint64_t offset   = sizeof(*header) + sizeof(double) * (uint64_t)header->bodies;
+    reader->chunkCount = 0;
+    reader->frameCount = 0;
+    const tagTrajectoryChunk* chunk;
+    while((chunk = chunkAt(reader, offset)) != NULL && chunk->firstFrame == reader->frameCount)
+    {
+      if(reader->chunkCount == capacity)
+      {
+        capacity = capacity ? capacity * 2 : 64;
+        reader->index = (uint64_t*)growMemory(reader->index, sizeof(uint64_t) * capacity);
+      }
+      reader->index[reader->chunkCount++] = offset;
+      reader->frameCount += chunk->frames;
+      offset += chunk->bytes;
+      if(chunk->frames != header->framesPerChunk) break;   // only the last may be short
+    }
+  }
+
+  if(reader->frameCount == 0)
+  {
+    fprintf(stderr, "%s holds no frames\n", path);
+    trajectoryCloseReader(reader);
+    return false;
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * trajectoryCloseReader
+//#==============================================================================
+void trajectoryCloseReader(tagTrajectoryReader* reader)
+{
+  free(reader->index);
+  mappedFileClose(&reader->file);
+  memset(reader, 0, sizeof(*reader));
+}
+
+//#==============================================================================
+//# * trajectoryFrameAt / trajectoryFrameTime
+//#------------------------------------------------------------------------------
+//# The last frame at or before "time" (clamped to the recording), and the
+//# simulated time of a frame
+//#==============================================================================
+long trajectoryFrameAt(const tagTrajectoryReader* reader, double time)
+{
+  double frame = floor((time - reader->header->startTime) / reader->header->interval);
+  if(!(frame > 0)) return 0;
+  if(frame >= (double)(reader->frameCount - 1)) return (long)(reader->frameCount - 1);
+  return (long)frame;
+}
+
+double trajectoryFrameTime(const tagTrajectoryReader* reader, long frame)
+{
+  return reader->header->startTime + frame * reader->header->interval;
+}
+
+//#==============================================================================
+//# * trajectoryReadFrame
+//#------------------------------------------------------------------------------
+//# Decodes one frame straight out of the map into whichever of the arrays are
+//# not NULL. Returns false for a frame that isn't in the file.
+//#==============================================================================
+bool trajectoryReadFrame(const tagTrajectoryReader* reader, long frame,
+                         double* x,  double* y,  double* z,
+                         double* vx, double* vy, double* vz)
+{
+  if(frame < 0 || (uint64_t)frame >= reader->frameCount) return false;
+  const tagTrajectoryHeader* header = reader->header;
+  uint64_t chunkIndex = (uint64_t)frame / header->framesPerChunk;
+  uint32_t local      = (uint32_t)((uint64_t)frame % header->framesPerChunk);
+  if(chunkIndex >= reader->chunkCount) return false;
+  const tagTrajectoryChunk* chunk = chunkAt(reader, reader->index[chunkIndex]);
+  if(chunk == NULL || local >= chunk->frames) return false;
+
+  const unsigned long count  = header->bodies;
+  const unsigned long values = TRAJECTORY_VALUES * count;
+  const double* base  = (const double*)(chunk + 1);
+  const float*  scale = (const float*)(base + values);
+  const float*    q32 = (const float*)(scale + values) + local * values;
+  const uint16_t* q16 = (const uint16_t*)(scale + values) + local * values;
+
+  double* outputs[TRAJECTORY_VALUES] = { x, y, z, vx, vy, vz };
+  for( int v = 0; v < TRAJECTORY_VALUES; v++)
+  {
+    double* out = outputs[v];
+    if(out == NULL) continue;
+    unsigned long first = v * count;
+    if(header->format == TRAJECTORY_F16)
+    {
+      for( unsigned long i = 0; i < count; i++)
+        out[i] = base[first + i] + (double)halfToFloat(q16[first + i]) * scale[first + i];
+    }
+    else
+    {
+      for( unsigned long i = 0; i < count; i++)
+        out[i] = base[first + i] + (double)q32[first + i] * scale[first + i];
+    }
+  }
+  return true;
+}
+
+//#==============================================================================
+//# * trajectoryFormatName / trajectoryParseFormat
+//#------------------------------------------------------------------------------
+//# Conversions between format ids and the names used on the command line.
+//# trajectoryParseFormat returns -1 for a name it doesn't know.
+//#==============================================================================
+const char* trajectoryFormatName(int format)
+{
+  return format == TRAJECTORY_F16 ? "f16" : "f32";
+}
+
+int trajectoryParseFormat(const char* name)
+{
+  if(strcmp(name, "f32") == 0) return TRAJECTORY_F32;
+  if(strcmp(name, "f16") == 0) return TRAJECTORY_F16;
+  return -1;
+}
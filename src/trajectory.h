@@ -0,0 +1,131 @@
+/*
+#================================================================================
+# * Trajectory              Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Recording of every body's position and velocity over time, and replay of
+# those recordings without running the physics.
+#
+# File layout (little endian):
+#   tagTrajectoryHeader
+#   radius of every body (double)
+#   chunks, each: tagTrajectoryChunk
+#                 base of every value (double, x y z vx vy vz x bodies)
+#                 scale of every value (float, same order)
+#                 frames (each 6 x bodies values, float or half)
+#   index: file offset of every chunk (uint64)
+#
+# A stored value q stands for base + q * scale. base is the middle of the
+# value's range over the chunk, so even half precision keeps three digits
+# of the motion within a chunk rather than of the distance from the sun.
+# Frames are evenly spaced in time and chunks hold the same number of frames
+# (bar the last), so finding the frame for a date and then its chunk takes
+# constant time. The index is written when the recording is closed; a file
+# cut short without one is still readable by walking the chunks once.
+#
+# The number of bodies is fixed for the whole file. When bodies merge, each
+# slot goes on recording whichever body its own was absorbed into.
+#================================================================================
+*/
+#ifndef SOLAR_TRAJECTORY_H
+#define SOLAR_TRAJECTORY_H
+
+#include "bodies.h"
+#include "mapped_file.h"
+#include <stdio.h>        // Header File for FILE
+#include <stdint.h>       // Header File for fixed width integers
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define TRAJECTORY_MAGIC   "SOLTRAJ"   // first 8 bytes of a file (with the \0)
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_CHUNK   64          // frames per chunk
+#define TRAJECTORY_VALUES  6           // x y z vx vy vz
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// Enumeration of value formats
+enum
+{
+  TRAJECTORY_F32 = 0,   // 4 bytes a value
+  TRAJECTORY_F16        // 2 bytes a value (IEEE half)
+};
+
+// tagTrajectoryHeader - start of the file
+typedef struct
+{
+  char     magic[8];         // TRAJECTORY_MAGIC
+  uint32_t version;          // TRAJECTORY_VERSION
+  uint32_t format;           // TRAJECTORY_F32 / TRAJECTORY_F16
+  uint32_t bodies;           // bodies in every frame
+  uint32_t framesPerChunk;   // frames in every chunk but the last
+  uint32_t decimation;       // physics steps per recorded frame
+  uint32_t chunkCount;       // chunks in the file (0 until closed)
+  uint64_t frameCount;       // frames in the file (0 until closed)
+  uint64_t indexOffset;      // where the chunk index starts (0 until closed)
+  double   interval;         // simulated seconds between frames
+  double   startTime;        // simulated time of the first frame
+}tagTrajectoryHeader;
+
+// tagTrajectoryChunk - start of every chunk
+typedef struct
+{
+  uint32_t magic;            // "CHNK"
+  uint32_t frames;           // frames in this chunk
+  uint64_t firstFrame;       // number of its first frame
+  uint64_t bytes;            // size of the whole chunk, header included
+}tagTrajectoryChunk;
+
+// tagTrajectoryWriter
+typedef struct
+{
+  FILE*     file;
+  tagTrajectoryHeader header;
+  int       count;           // bodies
+  long      steps;           // steps seen since the last frame
+  int       buffered;        // frames waiting in "frames"
+  double*   frames;          // a chunk's worth of frames at full precision
+  uint64_t* index;           // offset of every chunk written
+  uint32_t  indexCapacity;
+  uint64_t  offset;          // bytes written so far
+  unsigned char* chunk;      // a chunk being packed for writing
+  int*      slots;           // body recorded in each slot, once bodies have merged (else NULL)
+}tagTrajectoryWriter;
+
+// tagTrajectoryReader
+typedef struct
+{
+  tagMappedFile file;
+  const tagTrajectoryHeader* header;
+  const double* radius;      // radius of every body, in the file
+  uint64_t*     index;       // offset of every chunk
+  uint32_t      chunkCount;
+  uint64_t      frameCount;
+}tagTrajectoryReader;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+bool trajectoryCreate ( tagTrajectoryWriter* writer, const char* path,
+                        int format, int decimation, double dt,
+                        double startTime, const tagBodies* bodies );
+void trajectoryRecord ( tagTrajectoryWriter* writer, const tagBodies* bodies );
+void trajectoryRemap  ( tagTrajectoryWriter* writer, const int* remap );
+bool trajectoryClose  ( tagTrajectoryWriter* writer );
+
+bool   trajectoryOpen        ( tagTrajectoryReader* reader, const char* path );
+void   trajectoryCloseReader ( tagTrajectoryReader* reader );
+long   trajectoryFrameAt     ( const tagTrajectoryReader* reader, double time );
+double trajectoryFrameTime   ( const tagTrajectoryReader* reader, long frame );
+bool   trajectoryReadFrame   ( const tagTrajectoryReader* reader, long frame,
+                               double* x,  double* y,  double* z,
+                               double* vx, double* vy, double* vz );
+
+const char* trajectoryFormatName  ( int format );
+int         trajectoryParseFormat ( const char* name );
+
+#endif // SOLAR_TRAJECTORY_H
@@ -0,0 +1,54 @@
+/*
+#================================================================================
+# * Triple Buffer           Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Lock-free single writer / single reader state hand-off
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "triple_buffer.h"
+
+//#==============================================================================
+//# * tripleBufferInit
+//#------------------------------------------------------------------------------
+//# Writer starts on slot 0, the middle is slot 1 and the reader has slot 2
+//#==============================================================================
+void tripleBufferInit(tagTripleBuffer* buffer)
+{
+  buffer->write = 0;
+  buffer->middle.store(1);
+  buffer->read  = 2;
+}
+
+//#==============================================================================
+//# * tripleBufferPublish
+//#------------------------------------------------------------------------------
+//# Writer side: the slot in buffer->write is finished. It is swapped into the
+//# middle and the slot that was there is returned as the next one to fill.
+//#==============================================================================
+int tripleBufferPublish(tagTripleBuffer* buffer)
+{
+  int previous = buffer->middle.exchange(buffer->write | TRIPLE_BUFFER_FRESH,
+                                         std::memory_order_acq_rel);
+  buffer->write = previous & ~TRIPLE_BUFFER_FRESH;
+  return buffer->write;
+}
+
+//#==============================================================================
+//# * tripleBufferAcquire
+//#------------------------------------------------------------------------------
+//# Reader side: if a newer state has been published, swaps it into
+//# buffer->read and returns true. Otherwise buffer->read is left alone.
+//#==============================================================================
+bool tripleBufferAcquire(tagTripleBuffer* buffer)
+{
+  if((buffer->middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_FRESH) == 0)
+  {
+    return false;
+  }
+  int previous = buffer->middle.exchange(buffer->read, std::memory_order_acq_rel);
+  buffer->read = previous & ~TRIPLE_BUFFER_FRESH;
+  return true;
+}
@@ -0,0 +1,44 @@
+/*
+#================================================================================
+# * Triple Buffer           Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Lock-free hand-off of whole states from one writer thread to one reader
+# thread. There are three slots: the writer fills one, the reader holds one,
+# and the third sits in the middle holding the newest finished state. Neither
+# side ever waits for the other; the reader simply skips states it was too
+# slow to see.
+#================================================================================
+*/
+#ifndef SOLAR_TRIPLE_BUFFER_H
+#define SOLAR_TRIPLE_BUFFER_H
+
+#include <atomic>         // Header File for std::atomic
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define TRIPLE_BUFFER_FRESH 4   // set in "middle" when it holds an unread state
+
+//#==============================================================================
+//# Structures & Enumerations
+//#==============================================================================
+
+// tagTripleBuffer - holds slot indices only; the slots themselves belong to
+// whoever owns the buffer
+typedef struct
+{
+  std::atomic<int> middle;   // slot in the middle (| TRIPLE_BUFFER_FRESH)
+  int              write;    // slot the writer is filling
+  int              read;     // slot the reader is looking at
+}tagTripleBuffer;
+
+//#==============================================================================
+//# Prototypes
+//#==============================================================================
+
+void tripleBufferInit    ( tagTripleBuffer* buffer );
+int  tripleBufferPublish ( tagTripleBuffer* buffer );
+bool tripleBufferAcquire ( tagTripleBuffer* buffer );
+
+#endif // SOLAR_TRIPLE_BUFFER_H
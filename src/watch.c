@@ -0,0 +1,124 @@
+/*
+#================================================================================
+# * Watch                   Ver. 1.0.0
+#--------------------------------------------------------------------------------
+# Example consumer of --share, using nothing but shared_state.h and its reader
+# library. Every --interval seconds it reads the newest step in place and
+# prints where the first few bodies are, until the simulator stops (or dies).
+#
+#   SolarSystemWatch NAME [--interval S] [--bodies N]
+#================================================================================
+*/
+//#==============================================================================
+//# Header Files
+//#==============================================================================
+#include "shared_state.h"
+#include <stdio.h>        // Header File for the standard library
+#include <stdlib.h>       // Header File for strtol/strtod
+#include <string.h>       // Header File for strcmp
+#include <math.h>         // Header File for the math library
+#include <time.h>         // Header File for nanosleep
+
+//#==============================================================================
+//# Definitions
+//#==============================================================================
+
+#define WATCH_AU   1.495978707E11   // meters in an astronomical unit
+#define WATCH_DAY  86400.0          // seconds in a day
+#define WATCH_MAX  64               // bodies that can be printed
+
+//#==============================================================================
+//# * sleepSeconds
+//#==============================================================================
+static void sleepSeconds(double seconds)
+{
+  struct timespec wait;
+  wait.tv_sec  = (time_t)seconds;
+  wait.tv_nsec = (long)((seconds - (double)wait.tv_sec) * 1E9);
+  nanosleep(&wait, NULL);
+}
+
+//#==============================================================================
+//# * main
+//#==============================================================================
+int main(int argc, char** argv)
+{
+  const char* name = NULL;
+  double interval  = 1;
+  int    shown     = 4;
+  bool   usage     = false;
+  for( int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+      interval = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+      shown = (int)strtol(argv[++i], NULL, 10);
+    else if(argv[i][0] != '-' && name == NULL)
+      name = argv[i];
+    else
+      usage = true;
+  }
+  if(usage || name == NULL || !(interval > 0) || shown < 0 || shown > WATCH_MAX)
+  {
+    fprintf(stderr, "usage: %s NAME [--interval S] [--bodies N]\n"
+                    "  NAME           segment given to SolarSystem --share\n"
+                    "  --interval S   seconds between reads (default 1)\n"
+                    "  --bodies N     bodies to print, at most %d (default 4)\n",
+            argv[0], WATCH_MAX);
+    return 1;
+  }
+
+  tagSharedReader reader;
+  if(!sharedStateOpen(&reader, name))
+  {
+    fprintf(stderr, "can't open shared memory '%s' (is the simulator running with --share?)\n",
+            name);
+    return 1;
+  }
+  printf("%s: %u bodies at most, %u slots, steps of %g s, written by process %d\n",
+         name, reader.header->capacity, reader.header->slots, reader.header->dt,
+         (int)reader.header->writer);
+
+  uint64_t last = 0;
+  bool died = false;
+  for( ;; )
+  {
+    bool closed = sharedStateClosed(&reader);   // before the read, so the last step isn't missed
+    bool alive  = closed || sharedStateWriterAlive(&reader);
+    tagSharedView view;
+    if(sharedStateLatest(&reader, &view) && view.step != last)
+    {
+      // copy out what's printed, then make sure the writer didn't touch it meanwhile
+      double x[WATCH_MAX], y[WATCH_MAX], z[WATCH_MAX];
+      int count = view.count < shown ? view.count : shown;
+      for( int b = 0; b < count; b++)
+      {
+        x[b] = view.x[b];
+        y[b] = view.y[b];
+        z[b] = view.z[b];
+      }
+      if(!sharedStateValid(&reader, &view)) continue;
+
+      printf("step %llu, day %.1f, %d bodies\n", (unsigned long long)view.step,
+             view.time / WATCH_DAY, view.count);
+      for( int b = 0; b < count; b++)
+        printf("  %3d  %12.6f %12.6f %12.6f AU  (%.6f from the first)\n", b,
+               x[b] / WATCH_AU, y[b] / WATCH_AU, z[b] / WATCH_AU,
+               sqrt((x[b]-x[0])*(x[b]-x[0]) + (y[b]-y[0])*(y[b]-y[0]) +
+                    (z[b]-z[0])*(z[b]-z[0])) / WATCH_AU);
+      fflush(stdout);
+      last = view.step;
+    }
+    if(closed) break;
+    if(!alive)
+    {
+      died = true;
+      break;
+    }
+    sleepSeconds(interval);
+  }
+  printf("%s: %s after %llu steps\n", name, died ? "writer died" : "closed",
+         (unsigned long long)sharedStatePublished(&reader));
+  sharedStateClose(&reader);
+  return died ? 1 : 0;
+}